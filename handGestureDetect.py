@@ -3,7 +3,9 @@ import mediapipe as mp
 import math
 import struct 
 import serial
+import time
 
+# USB-serial adapter on the command UART (GPIO17 TX / GPIO16 RX), not the console port
 ser = serial.Serial('COM5',baudrate= 115200, timeout=1) 
 
 mp_hands = mp.solutions.hands
@@ -19,10 +21,29 @@ hands = mp_hands.Hands(
     min_tracking_confidence=0.7
 )
 
+# Each byte starts a jog that the firmware brakes after 250 ms without a
+# repeat (MOTION_JOG_TIMEOUT_MS), so only changes and a keepalive are sent
+KEEPALIVE_S = 0.1
+last_packet = None
+last_sent = 0.0
+
+# Gesture pair (1-2 base, 3-4 shoulder, 5-6 elbow, 7-8 wrist) to the joint
+# number JJ carries, which the firmware takes as its servo_id_t:
+# 0 forearm (elbow), 1 wrist, 2 arm (shoulder), 3 base
+GESTURE_JOINT = [3, 2, 0, 1]
+
 def uart_send_packet(gesture_id, intensity, ser):
-    gesture_type = gesture_id // 2
+    global last_packet, last_sent
+    # Legacy byte 00JJ LLLD as the firmware decodes it (main/uart_parser.h);
+    # odd gesture ids increase the joint angle
+    gesture_type = GESTURE_JOINT[(gesture_id - 1) // 2]
     gesture_direct = gesture_id % 2
-    packet = ((gesture_type & 0x03) << 4) | ((intensity & 0x0C) << 1) | (gesture_direct & 0x01)
+    intensity = max(0, min(intensity, 7))
+    packet = ((gesture_type & 0x03) << 4) | ((intensity & 0x07) << 1) | (gesture_direct & 0x01)
+    now = time.monotonic()
+    if packet == last_packet and now - last_sent < KEEPALIVE_S:
+        return
+    last_packet, last_sent = packet, now
     ser.write(bytes([packet]))
     print(f"Gửi byte: 0x{packet:02X} (gesture_type={gesture_type}, gesture_direct={gesture_direct}, intensity={intensity})")
 
@@ -0,0 +1,310 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "unity.h"
+#include "servo_controller.h"
+#include "servo_backend.h"
+#include "motion_engine.h"
+
+// Host test: the arm runs on the mock backend with the motion engine on the
+// simulated clock, and the duty trace the ticks commit is checked directly.
+
+#define TRACE_JOINTS    (4)
+#define TRACE_LENGTH    (8192)
+#define TRACE_STEP_US   (100000)    // Drained well before the mock log fills up
+#define SETTLE_US       (100000)    // Run on this long after the planned end
+
+static servo_mock_write_t trace[TRACE_LENGTH];
+static int trace_count = 0;
+
+// Duty count of angle under the default calibration, worked out here rather
+// than through the controller's duty map
+static uint32_t expected_duty(float angle_deg) {
+    const servo_calibration_t calib = DEFAULT_SERVO_CALIBRATION();
+    double pulse_us = calib.min_pulse_us + (calib.max_pulse_us - calib.min_pulse_us) * angle_deg / SERVO_MAX_ANGLE;
+    return (uint32_t)lround(pulse_us * SERVO_MOCK_PERIOD_TICKS * SERVO_FREQUENCY_HZ / 1000000.0);
+}
+
+// Run the engine for duration_us, appending every committed write to trace
+static void record(uint32_t duration_us) {
+    while (duration_us > 0) {
+        uint32_t step = (duration_us < TRACE_STEP_US) ? duration_us : TRACE_STEP_US;
+        motion_sim_advance(step);
+        duration_us -= step;
+        trace_count += servo_mock_read(&trace[trace_count], TRACE_LENGTH - trace_count);
+    }
+}
+
+// Control tick a write was committed in
+static uint32_t tick_of(int64_t time_us) {
+    return (uint32_t)(time_us / MOTION_TICK_PERIOD_US);
+}
+
+// Copy the writes to one output, in order, into out; returns how many
+static int writes_of(int output, servo_mock_write_t* out) {
+    int n = 0;
+    for (int k = 0; k < trace_count; k++) {
+        if (trace[k].output == output) {
+            out[n++] = trace[k];
+        }
+    }
+    return n;
+}
+
+void setUp(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, servo_set_backend(&servo_backend_mock));
+    TEST_ASSERT_EQUAL(ESP_OK, motion_set_sim_clock(true));
+    servo_mock_set_clock(motion_time_us);
+    TEST_ASSERT_EQUAL(ESP_OK, servo_init());
+    TEST_ASSERT_EQUAL(TRACE_JOINTS, servo_get_count());
+
+    // Drop the writes servo_init() made to park the outputs
+    while (servo_mock_read(trace, TRACE_LENGTH) > 0) {
+    }
+    trace_count = 0;
+}
+
+void tearDown(void) {
+    servo_deinit();
+    servo_mock_set_clock(NULL);
+    motion_set_sim_clock(false);
+}
+
+// A coordinated joint move starts every joint in the next tick and commits
+// all of them together on every tick until the planned end. Each duty rises
+// monotonically, keeps pace with the others and ends on the target's duty.
+static void test_coordinated_move_trace(void) {
+    float targets[SERVO_MAX_JOINTS] = { 60.0f, 120.0f, 30.0f, 90.0f };
+    float planned_s = 0.0f;
+    uint32_t start_tick = tick_of(motion_time_us());
+    TEST_ASSERT_EQUAL(ESP_OK, motion_move_joints(targets, 0.0f, 0.0f, &planned_s));
+    TEST_ASSERT_TRUE(planned_s > 0.0f);
+
+    record((uint32_t)(planned_s * 1000000.0f) + SETTLE_US);
+    int count = trace_count;
+    TEST_ASSERT_EQUAL_UINT32(0, servo_mock_dropped());
+    TEST_ASSERT_TRUE(count > 0 && count < TRACE_LENGTH);
+    for (int i = 0; i < TRACE_JOINTS; i++) {
+        TEST_ASSERT_FALSE(motion_is_busy((servo_id_t)i));
+    }
+
+    uint32_t first_tick[TRACE_JOINTS];
+    uint32_t settled_tick[TRACE_JOINTS] = { 0 };
+    uint32_t last_duty[TRACE_JOINTS];
+    uint32_t hpoint[TRACE_JOINTS];
+    for (int i = 0; i < TRACE_JOINTS; i++) {
+        first_tick[i] = UINT32_MAX;
+        last_duty[i] = expected_duty(0.0f);
+    }
+
+    for (int k = 0; k < count; k++) {
+        const servo_mock_write_t* write = &trace[k];
+        TEST_ASSERT_TRUE(write->output < TRACE_JOINTS);
+        // Commits land on the control tick grid of the simulated clock
+        TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)(write->time_us % MOTION_TICK_PERIOD_US));
+        // Every write of a tick belongs to one commit covering all the joints
+        if (k % TRACE_JOINTS == 0) {
+            TEST_ASSERT_TRUE(k + TRACE_JOINTS <= count);
+            for (int j = 1; j < TRACE_JOINTS; j++) {
+                TEST_ASSERT_EQUAL_UINT32(tick_of(write->time_us), tick_of(trace[k + j].time_us));
+            }
+        }
+
+        int i = write->output;
+        if (first_tick[i] == UINT32_MAX) {
+            first_tick[i] = tick_of(write->time_us);
+            hpoint[i] = write->hpoint;
+        }
+        TEST_ASSERT_EQUAL_UINT32(hpoint[i], write->hpoint);
+        TEST_ASSERT_TRUE(write->duty >= last_duty[i]);
+        if (write->duty != last_duty[i]) {
+            settled_tick[i] = tick_of(write->time_us);
+        }
+        last_duty[i] = write->duty;
+    }
+
+    for (int i = 0; i < TRACE_JOINTS; i++) {
+        TEST_ASSERT_EQUAL_UINT32(start_tick + 1, first_tick[i]);
+        TEST_ASSERT_UINT32_WITHIN(1, settled_tick[0], settled_tick[i]);
+        TEST_ASSERT_UINT32_WITHIN(1, expected_duty(targets[i]), last_duty[i]);
+        // Auto phases stagger the pulse starts
+        for (int j = 0; j < i; j++) {
+            TEST_ASSERT_NOT_EQUAL(hpoint[j], hpoint[i]);
+        }
+    }
+    // Every tick the joints are the same fraction of the way, to a duty count
+    for (int k = 0; k + TRACE_JOINTS <= count; k += TRACE_JOINTS) {
+        float progress[TRACE_JOINTS];
+        float travel[TRACE_JOINTS];
+        for (int j = 0; j < TRACE_JOINTS; j++) {
+            int i = trace[k + j].output;
+            travel[i] = (float)last_duty[i] - (float)expected_duty(0.0f);
+            progress[i] = ((float)trace[k + j].duty - (float)expected_duty(0.0f)) / travel[i];
+        }
+        for (int i = 1; i < TRACE_JOINTS; i++) {
+            TEST_ASSERT_FLOAT_WITHIN(1.0f / travel[0] + 1.0f / travel[i], progress[0], progress[i]);
+        }
+    }
+    // One commit on each tick of the planned move, none once it is over
+    uint32_t planned_ticks = (uint32_t)ceilf(planned_s * 1000000.0f / MOTION_TICK_PERIOD_US);
+    TEST_ASSERT_EQUAL(planned_ticks * TRACE_JOINTS, count);
+    TEST_ASSERT_EQUAL_UINT32(start_tick + planned_ticks, tick_of(trace[count - 1].time_us));
+}
+
+// Two queued poses with a corner blend: the second starts while the first is
+// still decelerating, so the joint passes the corner without coming to rest
+// and runs on to the second target.
+static void test_blended_poses_trace(void) {
+    motion_pose_t pose = { .max_speed = 0.0f, .duration = 0.0f, .blend = 10.0f, .start_us = 0 };
+    for (int i = 0; i < TRACE_JOINTS; i++) {
+        pose.target[i] = 60.0f;
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, motion_queue_pose(&pose));
+    for (int i = 0; i < TRACE_JOINTS; i++) {
+        pose.target[i] = 120.0f;
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, motion_queue_pose(&pose));
+
+    record(5000000);
+    TEST_ASSERT_EQUAL_UINT32(0, servo_mock_dropped());
+    TEST_ASSERT_TRUE(trace_count > 0 && trace_count < TRACE_LENGTH);
+
+    static servo_mock_write_t writes[TRACE_LENGTH];
+    for (int i = 0; i < TRACE_JOINTS; i++) {
+        TEST_ASSERT_FALSE(motion_is_busy((servo_id_t)i));
+        int n = writes_of(i, writes);
+        TEST_ASSERT_TRUE(n > 1);
+        TEST_ASSERT_UINT32_WITHIN(1, expected_duty(120.0f), writes[n - 1].duty);
+        for (int k = 1; k < n; k++) {
+            // One write per tick from start to finish, never backwards
+            TEST_ASSERT_EQUAL_UINT32(tick_of(writes[k - 1].time_us) + 1, tick_of(writes[k].time_us));
+            TEST_ASSERT_TRUE(writes[k].duty >= writes[k - 1].duty);
+            // Away from the two ends every tick moves: no stop at the corner
+            if (writes[k - 1].duty > expected_duty(10.0f) && writes[k].duty < expected_duty(110.0f)) {
+                TEST_ASSERT_TRUE(writes[k].duty > writes[k - 1].duty);
+            }
+        }
+    }
+}
+
+// A jog that is never refreshed brakes in the first tick at or after its
+// deadman time and comes to rest short of the soft limit.
+static void test_jog_deadman_trace(void) {
+    const uint32_t timeout_ms = 400;
+    const float speed = 30.0f;
+    int64_t deadman_us = motion_time_us() + (int64_t)timeout_ms * 1000;
+    uint32_t deadman_tick = (uint32_t)((deadman_us + MOTION_TICK_PERIOD_US - 1) / MOTION_TICK_PERIOD_US);
+    TEST_ASSERT_EQUAL(ESP_OK, motion_jog(SERVO_BASE, speed, timeout_ms));
+
+    record(timeout_ms * 1000 + 1000000);
+    TEST_ASSERT_EQUAL_UINT32(0, servo_mock_dropped());
+    TEST_ASSERT_FALSE(motion_is_busy(SERVO_BASE));
+
+    static servo_mock_write_t writes[TRACE_LENGTH];
+    int n = writes_of(SERVO_BASE, writes);
+    TEST_ASSERT_EQUAL(n, trace_count);      // No other joint moved
+    TEST_ASSERT_TRUE(n > 1);
+
+    // Cruising at the jog speed when the deadman fires, to a duty count
+    float counts_per_tick = (float)(expected_duty(speed) - expected_duty(0.0f)) * MOTION_TICK_PERIOD_US / 1000000.0f;
+    uint32_t cruise_step = 0;
+    uint32_t last_step = 0;
+    for (int k = 1; k < n; k++) {
+        TEST_ASSERT_EQUAL_UINT32(tick_of(writes[k - 1].time_us) + 1, tick_of(writes[k].time_us));
+        uint32_t step = writes[k].duty - writes[k - 1].duty;
+        if (tick_of(writes[k].time_us) < deadman_tick) {
+            cruise_step = step;
+        } else {
+            // Braking: the duty never speeds up again
+            TEST_ASSERT_TRUE(step <= last_step + 1);
+        }
+        last_step = step;
+    }
+    TEST_ASSERT_INT_WITHIN(1, (int)lroundf(counts_per_tick), (int)cruise_step);
+    // Stops within the time braking from the jog speed takes, well short of the limit
+    traj_limits_t limits;
+    TEST_ASSERT_EQUAL(ESP_OK, servo_get_limits(SERVO_BASE, &limits));
+    float brake_s = speed / limits.max_acc + limits.max_acc / limits.max_jerk;
+    uint32_t brake_ticks = (uint32_t)ceilf(brake_s * 1000000.0f / MOTION_TICK_PERIOD_US) + 1;
+    TEST_ASSERT_TRUE(tick_of(writes[n - 1].time_us) >= deadman_tick);
+    TEST_ASSERT_TRUE(tick_of(writes[n - 1].time_us) <= deadman_tick + brake_ticks);
+    TEST_ASSERT_TRUE(writes[n - 1].duty < expected_duty(SERVO_MAX_ANGLE));
+}
+
+// A timed batch due between two ticks is applied in the first tick after its
+// time, every joint of the batch in that one commit and none before it.
+static void test_timed_batch_trace(void) {
+    motion_batch_t batch = {
+        .mode = MOTION_BATCH_TARGET,
+        .mask = MOTION_JOINT_BIT(SERVO_WRIST) | MOTION_JOINT_BIT(SERVO_BASE),
+        .max_speed = 0.0f,
+        .at_us = motion_time_us() + 10 * MOTION_TICK_PERIOD_US + MOTION_TICK_PERIOD_US / 2
+    };
+    batch.value[SERVO_WRIST] = 45.0f;
+    batch.value[SERVO_BASE] = 135.0f;
+    uint32_t exec_tick = tick_of(batch.at_us) + 1;
+    TEST_ASSERT_EQUAL(ESP_OK, motion_batch(&batch));
+
+    record(3000000);
+    TEST_ASSERT_EQUAL_UINT32(0, servo_mock_dropped());
+    TEST_ASSERT_TRUE(trace_count >= 2);
+    for (int i = 0; i < TRACE_JOINTS; i++) {
+        TEST_ASSERT_FALSE(motion_is_busy((servo_id_t)i));
+    }
+
+    // The first commit is the exec tick and holds both joints, nothing else
+    TEST_ASSERT_EQUAL_UINT32(exec_tick, tick_of(trace[0].time_us));
+    TEST_ASSERT_EQUAL_UINT32(exec_tick, tick_of(trace[1].time_us));
+    TEST_ASSERT_NOT_EQUAL(trace[0].output, trace[1].output);
+    for (int k = 0; k < trace_count; k++) {
+        TEST_ASSERT_TRUE(batch.mask & MOTION_JOINT_BIT(trace[k].output));
+    }
+    static servo_mock_write_t writes[TRACE_LENGTH];
+    int n = writes_of(SERVO_BASE, writes);
+    TEST_ASSERT_TRUE(n > 1);
+    TEST_ASSERT_UINT32_WITHIN(1, expected_duty(135.0f), writes[n - 1].duty);
+    n = writes_of(SERVO_WRIST, writes);
+    TEST_ASSERT_UINT32_WITHIN(1, expected_duty(45.0f), writes[n - 1].duty);
+}
+
+// Host time per control tick with every joint on a path, printed for
+// comparison between changes. The engine has to beat real time by a margin
+// for the target to have any headroom.
+static void test_tick_throughput(void) {
+    const int moves = 20;
+    float targets[SERVO_MAX_JOINTS];
+    float planned_s = 0.0f;
+    uint32_t ticks = 0;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int m = 0; m < moves; m++) {
+        for (int i = 0; i < TRACE_JOINTS; i++) {
+            targets[i] = (m % 2 == 0) ? 150.0f - 10.0f * i : 30.0f + 10.0f * i;
+        }
+        TEST_ASSERT_EQUAL(ESP_OK, motion_move_joints(targets, 0.0f, 0.0f, &planned_s));
+        uint32_t duration_us = (uint32_t)(planned_s * 1000000.0f);
+        motion_sim_advance(duration_us);
+        ticks += duration_us / MOTION_TICK_PERIOD_US;
+        servo_mock_read(trace, TRACE_LENGTH);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed_us = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+    double per_tick_us = elapsed_us / ticks;
+    printf("%u ticks in %.0f us: %.2f us per tick, %.0fx real time\n",
+           (unsigned)ticks, elapsed_us, per_tick_us, MOTION_TICK_PERIOD_US / per_tick_us);
+    TEST_ASSERT_TRUE(ticks > 0);
+    TEST_ASSERT_TRUE(per_tick_us < MOTION_TICK_PERIOD_US / 10);
+}
+
+void app_main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_coordinated_move_trace);
+    RUN_TEST(test_blended_poses_trace);
+    RUN_TEST(test_jog_deadman_trace);
+    RUN_TEST(test_timed_batch_trace);
+    RUN_TEST(test_tick_throughput);
+    exit(UNITY_END());
+}
@@ -0,0 +1,8 @@
+import pytest
+from pytest_embedded_idf.dut import IdfDut
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+def test_motion_trace(dut: IdfDut) -> None:
+    dut.expect_exact('Tests 0 Failures 0 Ignored', timeout=30)
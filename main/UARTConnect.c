@@ -1,61 +1,208 @@
 #include    "UARTconnect.h"
 #include    "string.h"
 #include    "esp_log.h"
+#include    "freertos/task.h"
+#include    "esp_timer.h"
+#include    "motion_engine.h"
 
 
 static const char* TAG = "UART_CONNECT";
 
+// Ring between the two tasks: uart_rx_task is the only writer of the head,
+// uart_processing_task the only writer of the tail. Both indexes run freely
+// and are masked on access, so head - tail is always the fill level.
+#define UART_RING_MASK      (UART_RX_BUF_SIZE - 1)
+#define UART_RX_RETRY_MS    (10)        // Poll period while the ring is full
 
-static uint8_t rx_buffer[UART_RX_BUF_SIZE];  // buffer cố định
-static size_t rx_index = 0;                  // con trỏ cuối buffer
-static QueueHandle_t signal_queue = NULL;    // queue báo có dữ liệu
+// Acks of commands that move joints wait for the control tick that first
+// puts them on the outputs, so they can report its commit time
+#define UART_ACK_QUEUE_SIZE     (16)
+#define UART_TICK_HISTORY       (16)        // Commit times kept, power of two
+
+_Static_assert((UART_RX_BUF_SIZE & UART_RING_MASK) == 0, "UART_RX_BUF_SIZE must be a power of two");
+
+static uint8_t uart_ring[UART_RX_BUF_SIZE];
+static uint32_t uart_ring_head = 0;
+static uint32_t uart_ring_tail = 0;
+static uint32_t uart_resync_at = 0;         // Ring position where the stream restarts
+static bool uart_resync_pending = false;
+static uint32_t uart_ring_rx_us = 0;        // Device time the head last moved
+static portMUX_TYPE uart_ring_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t uart_frame_rx_us = 0;       // uart_ring_rx_us of the span being parsed
+
+typedef struct {
+    proto_msg_ack_t ack;
+    uint32_t tick;              // Control tick count when the command returned
+} uart_pending_ack_t;
+
+static uart_pending_ack_t uart_acks[UART_ACK_QUEUE_SIZE];
+static int uart_ack_count = 0;
+static uint32_t uart_tick_commit_us[UART_TICK_HISTORY];
+static uint32_t uart_last_tick = 0;
+static portMUX_TYPE uart_ack_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint8_t uart_tx_seq = 0;             // Header seq of unsolicited frames
+static portMUX_TYPE uart_tx_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Link rate state, changed only by the processing task
+typedef enum {
+    UART_LINK_BASE = 0,         // Base rate, always safe
+    UART_LINK_TRIAL,            // Switched, waiting for a good frame
+    UART_LINK_FAST              // Switched and confirmed
+} uart_link_state_t;
+
+typedef struct {
+    uart_link_config_t config;
+    uart_link_state_t state;
+    uint32_t pending_baud;      // Accepted by a link request, applied after its ack
+    int64_t deadline_us;        // End of the confirm window
+    uint32_t errors_at_good;    // Error total at the last good frame
+} uart_link_t;
+
+static uart_link_t uart_link = {
+    .config = DEFAULT_UART_LINK_CONFIG()
+};
+
+static QueueHandle_t uart_event_queue = NULL;  // Driver events
+static TaskHandle_t uart_proc_handle = NULL;
+static TaskHandle_t uart_telemetry_handle = NULL;
+static esp_timer_handle_t uart_telemetry_timer = NULL;   // Paces uart_telemetry_task
+static uart_parser_t uart_parser;
+static uart_rx_stats_t uart_stats;
+
+// Private function prototypes
+static bool uart_rx_drain(void);
+static size_t uart_rx_pull(size_t length);
+static void uart_rx_mark_resync(void);
+static void uart_rx_consume(void);
+static void uart_dispatch_frame(const uart_frame_t* frame, void* arg);
+static void uart_decode_legacy(uint8_t byte, uart_packet_t* packet);
+static proto_status_t uart_handle_command(const uart_frame_t* frame);
+static proto_status_t uart_handle_pose(const proto_msg_pose_t* msg, size_t length);
+static proto_status_t uart_handle_segment(const proto_msg_segment_t* msg, size_t length);
+static proto_status_t uart_handle_batch(const proto_msg_batch_t* msg, size_t length);
+static proto_status_t uart_handle_setpoint(const proto_msg_setpoint_t* msg, size_t length);
+static proto_status_t uart_handle_query(const uart_frame_t* frame);
+static proto_status_t uart_handle_calibration(const uart_frame_t* frame);
+static proto_status_t uart_status_from_err(esp_err_t err);
+static int64_t uart_device_time(uint32_t time_us);
+static bool uart_is_valid_joint(uint8_t joint);
+static void uart_link_switch(uint32_t baud);
+static void uart_link_good_frame(void);
+static void uart_link_check(void);
+static uint32_t uart_link_errors(void);
+static uint8_t uart_next_tx_seq(void);
+static bool uart_drives_outputs(const uart_frame_t* frame);
+static uint8_t uart_credit(int space);
+static bool uart_defer_ack(const proto_msg_ack_t* ack);
+static void uart_flush_acks(void);
+static void uart_tick_hook(uint32_t tick, int64_t commit_us, void* arg);
+static void uart_telemetry_tick(void* arg);
+static void uart_send_telemetry(void);
 
 
 esp_err_t uart_manager_init(void) {
+    uart_link_config_t default_config = DEFAULT_UART_LINK_CONFIG();
+    return uart_manager_init_with_config(&default_config);
+}
+
+esp_err_t uart_manager_init_with_config(const uart_link_config_t *config) {
+    if (config == NULL || config->base_baud == 0 || config->max_baud < config->base_baud) {
+        ESP_LOGE(TAG, "Invalid UART link configuration");
+        return ESP_ERR_INVALID_ARG;
+    }
+    uart_link.config = *config;
+    uart_link.state = UART_LINK_BASE;
+    uart_port_t port = config->port;
+
     uart_config_t uart_config = {
-        .baud_rate = UART_BAUD_RATE,
+        .baud_rate = (int)config->base_baud,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .flow_ctrl = config->flow_control ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = UART_RTS_THRESHOLD,
+        .source_clk = UART_SCLK_DEFAULT,
     };
-    esp_err_t ret = uart_param_config(UART_PORT, &uart_config);
-    ret= uart_driver_install(UART_PORT, UART_BUF_SIZE, UART_BUF_SIZE, 0, NULL, 0);
-
+    esp_err_t ret = uart_driver_install(port, UART_BUF_SIZE, UART_BUF_SIZE,
+                                        UART_EVENT_QUEUE_SIZE, &uart_event_queue, 0);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to install UART driver: %s", esp_err_to_name(ret));
         return ret;
     }
-    ret = uart_param_config(UART_PORT, &uart_config);
+    ret = uart_param_config(port, &uart_config);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to configure UART parameters: %s", esp_err_to_name(ret));
         return ret;
     }
-    ret= uart_set_pin(UART_PORT, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    ret = uart_set_pin(port, config->tx_pin, config->rx_pin,
+                       config->flow_control ? config->rts_pin : UART_PIN_NO_CHANGE,
+                       config->flow_control ? config->cts_pin : UART_PIN_NO_CHANGE);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set UART pins: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    // Create signal queue
-        signal_queue = xQueueCreate(UART_SIGNAL_QUEUE_SIZE, sizeof(uint8_t));
-    if (signal_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create signal queue");
-        return ESP_FAIL;
+    // Wake on a FIFO level or one idle character, whichever comes first
+    ret = uart_set_rx_full_threshold(port, UART_RX_FULL_THRESHOLD);
+    if (ret == ESP_OK) {
+        ret = uart_set_rx_timeout(port, UART_RX_TIMEOUT_CHARS);
+    }
+    // Resync marker; the idle gap before it keeps in-frame 0xFF runs from matching.
+    // Timings are in bit times, so they follow any later rate change.
+    if (ret == ESP_OK) {
+        ret = uart_enable_pattern_det_baud_intr(port, UART_RESYNC_CHAR, UART_RESYNC_COUNT,
+                                                9, 0, UART_RESYNC_IDLE_CHARS * 10);
+    }
+    if (ret == ESP_OK) {
+        ret = uart_pattern_queue_reset(port, UART_PATTERN_QUEUE_SIZE);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure UART RX interrupts: %s", esp_err_to_name(ret));
+        return ret;
     }
 
-    xTaskCreate(uart_rx_task, "uart_rx_task", 2048, NULL, 10, NULL);
-    xTaskCreate(uart_processing_task, "uart_proc_task", 4096, NULL, 9, NULL);
+    uart_parser_init(&uart_parser, uart_dispatch_frame, NULL);
+    uart_parser_set_legacy(&uart_parser, config->legacy_mode);
+    memset(&uart_stats, 0, sizeof(uart_stats));
+    uart_stats.baud = config->base_baud;
+    motion_set_tick_hook(uart_tick_hook, NULL);
 
+    // Consumer first so the producer always has someone to notify
+    if (xTaskCreate(uart_processing_task, "uart_proc_task", 4096, NULL, 9, &uart_proc_handle) != pdPASS ||
+        xTaskCreate(uart_rx_task, "uart_rx_task", 2048, NULL, 10, NULL) != pdPASS ||
+        xTaskCreate(uart_telemetry_task, "uart_telem_task", 3072, NULL, 8, &uart_telemetry_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create UART tasks");
+        return ESP_FAIL;
+    }
 
-    ESP_LOGI(TAG, "UART manager initialized on port %d with baud rate %d", UART_PORT, UART_BAUD_RATE);
+    // The FreeRTOS tick is too coarse for 200 Hz, so a timer paces the stream
+    const esp_timer_create_args_t timer_args = {
+        .callback = uart_telemetry_tick,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "uart_telemetry",
+        .skip_unhandled_events = true
+    };
+    ret = esp_timer_create(&timer_args, &uart_telemetry_timer);
+    if (ret == ESP_OK) {
+        ret = uart_set_telemetry_rate(config->telemetry_hz);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start telemetry: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "UART link on port %d (TX %d, RX %d%s) at %lu baud, up to %lu",
+             port, config->tx_pin, config->rx_pin, config->flow_control ? ", RTS/CTS" : "",
+             (unsigned long)config->base_baud, (unsigned long)config->max_baud);
     return ESP_OK;
 }
 
 esp_err_t uart_check_signals(void) {
     // Check the status of the UART signals
     // uart_signal_inv_t inv;
-    // esp_err_t ret = uart_get_signal_inv(UART_PORT, &inv);
+    // esp_err_t ret = uart_get_signal_inv(uart_link.config.port, &inv);
     // if (ret != ESP_OK) {
     //     ESP_LOGE(TAG, "Failed to get UART signal inversion: %s", esp_err_to_name(ret));
     //     return ret;
@@ -64,67 +211,821 @@ esp_err_t uart_check_signals(void) {
     return ESP_OK;
 }
 
+// Moves bytes from the driver into the ring as driver events arrive
+void uart_rx_task(void *param) {
+    uart_event_t event;
+    bool backlog = false;       // Driver still holds bytes the ring had no room for
+
+    while (1) {
+        TickType_t wait = backlog ? pdMS_TO_TICKS(UART_RX_RETRY_MS) : portMAX_DELAY;
+        if (!xQueueReceive(uart_event_queue, &event, wait)) {
+            backlog = uart_rx_drain();
+            xTaskNotifyGive(uart_proc_handle);
+            continue;
+        }
 
+        switch (event.type) {
+            case UART_DATA:
+            case UART_PATTERN_DET:
+                backlog = uart_rx_drain();
+                break;
 
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                // Bytes are already lost; start over from a clean stream
+                ESP_LOGW(TAG, "RX overflow, flushing input");
+                uart_flush_input(uart_link.config.port);
+                xQueueReset(uart_event_queue);
+                uart_stats.overflows++;
+                uart_rx_mark_resync();
+                backlog = false;
+                break;
 
-esp_err_t uart_read_packet(uart_packet_t *packet, TickType_t timeout) { 
-    uint8_t data[sizeof(uart_packet_t)];
-    int length = uart_read_bytes(UART_PORT, data, sizeof(data), timeout);
+            case UART_BREAK:
+            case UART_FRAME_ERR:
+            case UART_PARITY_ERR:
+                backlog = uart_rx_drain();
+                uart_rx_mark_resync();
+                taskENTER_CRITICAL(&uart_ring_lock);
+                uart_stats.line_errors++;
+                taskEXIT_CRITICAL(&uart_ring_lock);
+                break;
 
-    if(length < sizeof(uart_packet_t)) {
-        ESP_LOGE(TAG, "Failed to read UART data: %s", esp_err_to_name(length));
-        return ESP_FAIL;
+            default:
+                break;
+        }
+        xTaskNotifyGive(uart_proc_handle);
     }
+}
 
-    packet->servo_id = (data[0]>>4) &0x03;
-    packet->step_delay_ms = data[0] & 0x0f;
-    return ESP_OK;
+// Parses the ring in place and dispatches complete frames
+void uart_processing_task(void *param) {
+    while (1) {
+        // A trial rate needs a wake-up at the end of its confirm window
+        TickType_t wait = uart_link.state == UART_LINK_TRIAL ? pdMS_TO_TICKS(UART_LINK_CONFIRM_MS)
+                                                              : portMAX_DELAY;
+        ulTaskNotifyTake(pdTRUE, wait);
+        uart_rx_consume();
+        uart_flush_acks();
+        uart_link_check();
+    }
 }
 
-void uart_rx_task(void *param) {
-    uint8_t data[UART_PACKET_MAX_SIZE];
+// Sends one telemetry frame per timer tick
+void uart_telemetry_task(void *param) {
     while (1) {
-        int length = uart_read_bytes(UART_PORT, data, sizeof(data), portMAX_DELAY);
-        if (length > 0) {
-            xQueueSend(signal_queue, &data, portMAX_DELAY);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uart_send_telemetry();
+    }
+}
+
+void uart_manager_log_packet(const uart_packet_t *packet) {
+ ESP_LOGI(TAG, "Decoded Packet -> Servo ID: %d, Step Delay: %d",
+            (int) packet->servo_id, (int) packet->step_delay_ms);
+}
+
+esp_err_t uart_send_frame(uint8_t type, uint8_t seq, const void *payload, size_t length) {
+    uint8_t frame[PROTO_MAX_FRAME];
+    size_t size = uart_frame_encode(frame, type, seq, payload, length);
+    if (size == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // One write per frame: the driver never interleaves two writes
+    return uart_write_bytes(uart_link.config.port, frame, size) == (int)size ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t uart_set_telemetry_rate(uint16_t rate_hz) {
+    if (rate_hz > UART_TELEMETRY_MAX_HZ) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (uart_telemetry_timer == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Fails harmlessly when the stream is already off
+    esp_timer_stop(uart_telemetry_timer);
+    if (rate_hz == 0) {
+        return ESP_OK;
+    }
+    return esp_timer_start_periodic(uart_telemetry_timer, 1000000 / rate_hz);
+}
+
+void uart_get_rx_stats(uart_rx_stats_t *stats) {
+    taskENTER_CRITICAL(&uart_ring_lock);
+    *stats = uart_stats;
+    taskEXIT_CRITICAL(&uart_ring_lock);
+    stats->frames = uart_parser.frames + uart_parser.legacy;
+    stats->dropped = uart_parser.dropped;
+    stats->crc_errors = uart_parser.crc_errors;
+}
+
+// Private function implementations
+
+// Empties the driver buffer into the ring, splitting the stream at resync
+// markers. Returns true if bytes had to stay behind because the ring is full.
+static bool uart_rx_drain(void) {
+    while (1) {
+        size_t buffered = 0;
+        uart_get_buffered_data_len(uart_link.config.port, &buffered);
+
+        int marker = uart_pattern_get_pos(uart_link.config.port);
+        if (marker < 0) {
+            return uart_rx_pull(buffered) < buffered;
+        }
+
+        // Bytes ahead of the marker belong to the old stream
+        if (uart_rx_pull((size_t)marker) < (size_t)marker) {
+            return true;
         }
+        // Pop before reading the marker, the read shifts the queued positions
+        uart_pattern_pop_pos(uart_link.config.port);
+        uint8_t discard[UART_RESYNC_COUNT];
+        uart_read_bytes(uart_link.config.port, discard, sizeof(discard), 0);
+        uart_rx_mark_resync();
     }
 }
 
-void uart_processing_task(void *param) {
+// Reads up to length bytes straight into the free part of the ring
+static size_t uart_rx_pull(size_t length) {
+    size_t total = 0;
+
+    while (total < length) {
+        taskENTER_CRITICAL(&uart_ring_lock);
+        uint32_t head = uart_ring_head;
+        uint32_t used = head - uart_ring_tail;
+        taskEXIT_CRITICAL(&uart_ring_lock);
+
+        size_t offset = head & UART_RING_MASK;
+        size_t chunk = length - total;
+        if (chunk > UART_RX_BUF_SIZE - used) {
+            chunk = UART_RX_BUF_SIZE - used;
+        }
+        if (chunk > UART_RX_BUF_SIZE - offset) {
+            chunk = UART_RX_BUF_SIZE - offset;      // Up to the wrap, the rest next pass
+        }
+        if (chunk == 0) {
+            break;
+        }
+
+        int got = uart_read_bytes(uart_link.config.port, &uart_ring[offset], chunk, 0);
+        if (got <= 0) {
+            break;
+        }
+
+        taskENTER_CRITICAL(&uart_ring_lock);
+        uart_ring_head = head + (uint32_t)got;
+        uart_ring_rx_us = (uint32_t)esp_timer_get_time();
+        uart_stats.bytes += (uint32_t)got;
+        if (used + (uint32_t)got > uart_stats.ring_max) {
+            uart_stats.ring_max = used + (uint32_t)got;
+        }
+        taskEXIT_CRITICAL(&uart_ring_lock);
+        total += (size_t)got;
+    }
+    return total;
+}
+
+// The parser drops its partial frame once it reaches the current head
+static void uart_rx_mark_resync(void) {
+    taskENTER_CRITICAL(&uart_ring_lock);
+    uart_resync_at = uart_ring_head;
+    uart_resync_pending = true;
+    uart_stats.resyncs++;
+    taskEXIT_CRITICAL(&uart_ring_lock);
+}
+
+static void uart_rx_consume(void) {
     while (1) {
-        uint8_t signal;
-        if (xQueueReceive(signal_queue, &signal, portMAX_DELAY)) {
-            ESP_LOGI(TAG, "Signal received - processing UART buffer");
+        taskENTER_CRITICAL(&uart_ring_lock);
+        uint32_t head = uart_ring_head;
+        uint32_t tail = uart_ring_tail;
+        bool resync = uart_resync_pending;
+        uint32_t resync_at = uart_resync_at;
+        if (resync && resync_at == tail) {
+            uart_resync_pending = false;
+        }
+        // Every byte up to head was in the ring by then
+        uart_frame_rx_us = uart_ring_rx_us;
+        taskEXIT_CRITICAL(&uart_ring_lock);
 
-            size_t index = 0;
-            while (index + sizeof(uart_packet_t) <= rx_index) {
-                uart_packet_t pkt;
-                memcpy(&pkt, &rx_buffer[index], sizeof(uart_packet_t));
-                index += sizeof(uart_packet_t);
+        uint32_t end = head;
+        if (resync) {
+            if (resync_at == tail) {
+                uart_parser_reset(&uart_parser);
+                continue;
+            }
+            end = resync_at;    // Finish the old stream first
+        }
+        if (end == tail) {
+            return;
+        }
 
-                // In log packet
-                ESP_LOGI(TAG, "Decoded Packet -> Servo ID: %d, Step Delay: %d",
-                         pkt.servo_id, pkt.step_delay_ms);
+        // One contiguous span per pass, parsed where it lies
+        size_t offset = tail & UART_RING_MASK;
+        size_t span = end - tail;
+        if (span > UART_RX_BUF_SIZE - offset) {
+            span = UART_RX_BUF_SIZE - offset;
+        }
+        uart_parser_feed(&uart_parser, &uart_ring[offset], span);
+
+        taskENTER_CRITICAL(&uart_ring_lock);
+        uart_ring_tail = tail + (uint32_t)span;
+        taskEXIT_CRITICAL(&uart_ring_lock);
+    }
+}
+
+static void uart_dispatch_frame(const uart_frame_t* frame, void* arg) {
+    if (frame->type == UART_FRAME_LEGACY) {
+        if (uart_link.state == UART_LINK_TRIAL) {
+            return;
+        }
+        uart_packet_t packet;
+        uart_decode_legacy(frame->payload[0], &packet);
+        ESP_LOGD(TAG, "Decoded Packet -> Servo ID: %d, Step Delay: %d, Direct: %d",
+                 (int)packet.servo_id, (int)packet.step_delay_ms, (int)packet.direct);
+        esp_err_t ret = servo_uart_controller(packet.servo_id, packet.step_delay_ms, packet.direct);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Gesture command 0x%02X rejected: %s", frame->payload[0], esp_err_to_name(ret));
+        }
+        return;
+    }
+
+    uint32_t parse_us = (uint32_t)esp_timer_get_time();
+    ESP_LOGD(TAG, "Frame type 0x%02X seq %u, %u bytes",
+             frame->type, frame->seq, (unsigned)frame->length);
+    uart_link_good_frame();
+    bool has_reply = frame->type == PROTO_MSG_QUERY || frame->type == PROTO_MSG_CALIBRATION;
+    proto_status_t status = frame->type == PROTO_MSG_QUERY ? uart_handle_query(frame)
+                          : frame->type == PROTO_MSG_CALIBRATION ? uart_handle_calibration(frame)
+                                                                 : uart_handle_command(frame);
+    // A query or calibration that was answered needs no ack
+    if (has_reply && status == PROTO_STATUS_OK) {
+        return;
+    }
+    // Every command starts with its stamp; echo it even from a malformed one
+    uint32_t host_us = 0;
+    if (frame->length >= sizeof(host_us)) {
+        memcpy(&host_us, frame->payload, sizeof(host_us));
+    }
+    proto_msg_ack_t ack = {
+        .cmd_seq = frame->seq,
+        .status = (uint8_t)status,
+        .host_us = host_us,
+        .rx_us = uart_frame_rx_us,
+        .parse_us = parse_us,
+        .pwm_us = 0,
+        // Room left once this command took its share, for the host's credit count
+        .queue_free = uart_credit(motion_queue_space()),
+        .spline_free = uart_credit(motion_spline_space()),
+        .playout_free = uart_credit(motion_playout_space()),
+        .batch_free = uart_credit(motion_batch_space())
+    };
+    if (status != PROTO_STATUS_OK || !uart_drives_outputs(frame) || !uart_defer_ack(&ack)) {
+        uart_send_frame(PROTO_MSG_ACK, uart_next_tx_seq(), &ack, sizeof(ack));
+    }
+
+    if (uart_link.pending_baud != 0) {
+        uart_link_switch(uart_link.pending_baud);
+        uart_link.pending_baud = 0;
+    }
+}
+
+static void uart_decode_legacy(uint8_t byte, uart_packet_t* packet) {
+    packet->servo_id = (servo_id_t)((byte >> 4) & 0x03);
+    packet->step_delay_ms = UART_LEGACY_STEP_MS((byte >> 1) & 0x07);
+    packet->direct = byte & 0x01;
+}
+
+static proto_status_t uart_handle_command(const uart_frame_t* frame) {
+    esp_err_t ret;
+
+    switch (frame->type) {
+        case PROTO_MSG_JOINT_TARGET: {
+            if (frame->length != PROTO_JOINT_TARGET_SIZE) {
+                return PROTO_STATUS_BAD_LENGTH;
+            }
+            const proto_msg_joint_target_t* msg = (const proto_msg_joint_target_t*)frame->payload;
+            if (!uart_is_valid_joint(msg->joint)) {
+                return PROTO_STATUS_INVALID_ARG;
             }
+            ret = motion_set_target((servo_id_t)msg->joint, SERVO_MDEG_TO_DEG(msg->target_mdeg),
+                                    SERVO_MDEG_TO_DEG(msg->speed_mdeg_s));
+            return uart_status_from_err(ret);
+        }
 
-            // Dồn phần còn lại về đầu buffer
-            if (index < rx_index) {
-                memmove(rx_buffer, rx_buffer + index, rx_index - index);
+        case PROTO_MSG_JOG: {
+            if (frame->length != PROTO_JOG_SIZE) {
+                return PROTO_STATUS_BAD_LENGTH;
+            }
+            const proto_msg_jog_t* msg = (const proto_msg_jog_t*)frame->payload;
+            if (!uart_is_valid_joint(msg->joint)) {
+                return PROTO_STATUS_INVALID_ARG;
+            }
+            // The host resends the jog as a keepalive; silence brakes the joint
+            ret = motion_jog((servo_id_t)msg->joint, SERVO_MDEG_TO_DEG(msg->velocity_mdeg_s), msg->timeout_ms);
+            return uart_status_from_err(ret);
+        }
+
+        case PROTO_MSG_POSE:
+            if (frame->length < PROTO_POSE_SIZE(0)) {
+                return PROTO_STATUS_BAD_LENGTH;
+            }
+            return uart_handle_pose((const proto_msg_pose_t*)frame->payload, frame->length);
+
+        case PROTO_MSG_SEGMENT:
+            if (frame->length < PROTO_SEGMENT_SIZE(0)) {
+                return PROTO_STATUS_BAD_LENGTH;
+            }
+            return uart_handle_segment((const proto_msg_segment_t*)frame->payload, frame->length);
+
+        case PROTO_MSG_BATCH:
+            if (frame->length < PROTO_BATCH_SIZE(0)) {
+                return PROTO_STATUS_BAD_LENGTH;
+            }
+            return uart_handle_batch((const proto_msg_batch_t*)frame->payload, frame->length);
+
+        case PROTO_MSG_SETPOINT:
+            if (frame->length < PROTO_SETPOINT_SIZE(0)) {
+                return PROTO_STATUS_BAD_LENGTH;
+            }
+            return uart_handle_setpoint((const proto_msg_setpoint_t*)frame->payload, frame->length);
+
+        case PROTO_MSG_LINK: {
+            if (frame->length != PROTO_LINK_SIZE) {
+                return PROTO_STATUS_BAD_LENGTH;
+            }
+            const proto_msg_link_t* msg = (const proto_msg_link_t*)frame->payload;
+            if (msg->baud < uart_link.config.base_baud || msg->baud > uart_link.config.max_baud) {
+                return PROTO_STATUS_INVALID_ARG;
+            }
+            // Switched by the dispatcher once the ack is on its way. A
+            // request for the current rate is the host's confirmation.
+            if (msg->baud != uart_stats.baud) {
+                uart_link.pending_baud = msg->baud;
             }
-            rx_index -= index;
+            return PROTO_STATUS_OK;
         }
+
+        case PROTO_MSG_TELEMETRY_RATE: {
+            if (frame->length != PROTO_TELEMETRY_RATE_SIZE) {
+                return PROTO_STATUS_BAD_LENGTH;
+            }
+            const proto_msg_telemetry_rate_t* msg = (const proto_msg_telemetry_rate_t*)frame->payload;
+            return uart_status_from_err(uart_set_telemetry_rate(msg->rate_hz));
+        }
+
+        case PROTO_MSG_STOP: {
+            if (frame->length != PROTO_STOP_SIZE) {
+                return PROTO_STATUS_BAD_LENGTH;
+            }
+            const proto_msg_stop_t* msg = (const proto_msg_stop_t*)frame->payload;
+            uint32_t all = (1UL << servo_get_count()) - 1;
+            if ((msg->joint_mask & all) == all) {
+                motion_stop_all();      // Also drops queued poses and the spline stream
+                return PROTO_STATUS_OK;
+            }
+            // A queued pose takes every joint over again when it starts, so
+            // leaving it would restart the joints just stopped
+            if (msg->joint_mask & all) {
+                motion_queue_flush();
+            }
+            for (int i = 0; i < servo_get_count(); i++) {
+                if (msg->joint_mask & (1U << i)) {
+                    motion_stop((servo_id_t)i);
+                }
+            }
+            return PROTO_STATUS_OK;
+        }
+
+        default:
+            return PROTO_STATUS_UNKNOWN_TYPE;
+    }
+}
+
+// Joints past count keep their current target. A queued or timed pose runs
+// after the moves ahead of it, when that target is stale, so it needs them all.
+static proto_status_t uart_handle_pose(const proto_msg_pose_t* msg, size_t length) {
+    if (length != PROTO_POSE_SIZE(msg->count)) {
+        return PROTO_STATUS_BAD_LENGTH;
+    }
+    if (msg->count == 0 || msg->count > servo_get_count()) {
+        return PROTO_STATUS_INVALID_ARG;
+    }
+    if ((msg->flags & (PROTO_FLAG_QUEUE | PROTO_FLAG_TIMED)) && msg->count != servo_get_count()) {
+        return PROTO_STATUS_INVALID_ARG;
     }
+
+    motion_pose_t pose = {
+        .max_speed = (float)msg->max_speed_deg_s,
+        .duration = msg->duration_ms / 1000.0f,
+        .blend = SERVO_MDEG_TO_DEG(msg->blend_mdeg),
+        .start_us = 0
+    };
+    for (int i = 0; i < servo_get_count(); i++) {
+        pose.target[i] = i < msg->count ? SERVO_MDEG_TO_DEG(msg->target_mdeg[i])
+                                        : motion_get_target((servo_id_t)i);
+    }
+
+    esp_err_t ret;
+    if (msg->flags & PROTO_FLAG_TIMED) {
+        // Timed poses go through the queue, which holds them until they are due
+        pose.start_us = uart_device_time(msg->exec_us);
+        ret = motion_queue_pose(&pose);
+    } else if (msg->flags & PROTO_FLAG_QUEUE) {
+        ret = motion_queue_pose(&pose);
+    } else {
+        ret = motion_move_joints(pose.target, pose.duration, pose.max_speed, NULL);
+    }
+    return uart_status_from_err(ret);
 }
 
+static proto_status_t uart_handle_segment(const proto_msg_segment_t* msg, size_t length) {
+    if (length != PROTO_SEGMENT_SIZE(msg->count)) {
+        return PROTO_STATUS_BAD_LENGTH;
+    }
+    // Waypoints play after the ones buffered ahead, so every joint is given
+    if (msg->count != servo_get_count()) {
+        return PROTO_STATUS_INVALID_ARG;
+    }
 
+    motion_waypoint_t waypoint = {
+        .t_ms = msg->t_ms
+    };
+    for (int i = 0; i < servo_get_count(); i++) {
+        waypoint.pos[i] = SERVO_MDEG_TO_DEG(msg->pos_mdeg[i]);
+    }
 
+    esp_err_t ret = motion_spline_push(&waypoint);
+    if (ret == ESP_OK && (msg->flags & PROTO_FLAG_END)) {
+        motion_spline_end();
+    }
+    return uart_status_from_err(ret);
+}
 
-void uart_manager_log_packet(const uart_packet_t *packet) {
- ESP_LOGI(TAG, "Decoded Packet -> Servo ID: %d, Step Delay: %d",
-            (int) packet->servo_id, (int) packet->step_delay_ms);
+// Values are packed in mask order, lowest joint first
+static proto_status_t uart_handle_batch(const proto_msg_batch_t* msg, size_t length) {
+    if (length != PROTO_BATCH_SIZE(msg->count)) {
+        return PROTO_STATUS_BAD_LENGTH;
+    }
+    uint32_t all = (1UL << servo_get_count()) - 1;
+    if (msg->joint_mask == 0 || (msg->joint_mask & ~all) ||
+        msg->count != __builtin_popcount(msg->joint_mask)) {
+        return PROTO_STATUS_INVALID_ARG;
+    }
+
+    motion_batch_t batch = {
+        .mode = (msg->flags & PROTO_FLAG_VELOCITY) ? MOTION_BATCH_VELOCITY : MOTION_BATCH_TARGET,
+        .mask = msg->joint_mask,
+        .max_speed = (float)msg->max_speed_deg_s,
+        .at_us = 0
+    };
+    int k = 0;
+    for (int i = 0; i < servo_get_count(); i++) {
+        if (msg->joint_mask & (1U << i)) {
+            batch.value[i] = SERVO_MDEG_TO_DEG(msg->value[k++]);
+        }
+    }
+    if (msg->flags & PROTO_FLAG_TIMED) {
+        batch.at_us = uart_device_time(msg->exec_us);
+    }
+
+    return uart_status_from_err(motion_batch(&batch));
+}
+
+static proto_status_t uart_handle_setpoint(const proto_msg_setpoint_t* msg, size_t length) {
+    if (length != PROTO_SETPOINT_SIZE(msg->count)) {
+        return PROTO_STATUS_BAD_LENGTH;
+    }
+    // Setpoints play out after the ones buffered ahead, so every joint is given
+    if (msg->count != servo_get_count()) {
+        return PROTO_STATUS_INVALID_ARG;
+    }
+
+    motion_setpoint_t setpoint = {
+        .t_us = msg->t_us
+    };
+    for (int i = 0; i < servo_get_count(); i++) {
+        setpoint.pos[i] = SERVO_MDEG_TO_DEG(msg->pos_mdeg[i]);
+    }
+
+    esp_err_t ret = motion_playout_push(&setpoint);
+    if (ret == ESP_OK && (msg->flags & PROTO_FLAG_END)) {
+        motion_playout_end();
+    }
+    return uart_status_from_err(ret);
+}
+
+// Replies carry the query's seq so the host can match them up
+static proto_status_t uart_handle_query(const uart_frame_t* frame) {
+    if (frame->length != PROTO_QUERY_SIZE) {
+        return PROTO_STATUS_BAD_LENGTH;
+    }
+    const proto_msg_query_t* msg = (const proto_msg_query_t*)frame->payload;
+
+    switch (msg->what) {
+        case PROTO_QUERY_INFO: {
+            proto_msg_info_t info = {
+                .version = PROTO_VERSION,
+                .joint_count = (uint8_t)servo_get_count(),
+                .max_payload = PROTO_MAX_PAYLOAD,
+                .queue_length = MOTION_QUEUE_LENGTH,
+                .spline_length = MOTION_SPLINE_LENGTH,
+                .playout_length = MOTION_PLAYOUT_LENGTH,
+                .batch_length = MOTION_BATCH_LENGTH,
+                .rx_window = UART_RX_WINDOW,
+                .max_baud = uart_link.config.max_baud
+            };
+            uart_send_frame(PROTO_MSG_INFO, frame->seq, &info, sizeof(info));
+            return PROTO_STATUS_OK;
+        }
+
+        case PROTO_QUERY_STATE: {
+            uint8_t buffer[PROTO_STATE_SIZE(SERVO_MAX_JOINTS)];
+            proto_msg_state_t* state = (proto_msg_state_t*)buffer;
+            int count = servo_get_count();
+
+            state->busy_mask = 0;
+            state->time_us = (uint32_t)esp_timer_get_time();
+            state->count = (uint8_t)count;
+            for (int i = 0; i < count; i++) {
+                if (motion_is_busy((servo_id_t)i)) {
+                    state->busy_mask |= (uint16_t)(1U << i);
+                }
+                state->position_mdeg[i] = SERVO_DEG_TO_MDEG(motion_get_position((servo_id_t)i));
+            }
+            uart_send_frame(PROTO_MSG_STATE, frame->seq, buffer, PROTO_STATE_SIZE(count));
+            return PROTO_STATUS_OK;
+        }
+
+        case PROTO_QUERY_CLOCK: {
+            // One NTP exchange: the host keeps the offset of the fastest ones
+            proto_msg_clock_t clock = {
+                .host_us = msg->host_us,
+                .rx_us = uart_frame_rx_us
+            };
+            clock.tx_us = (uint32_t)esp_timer_get_time();
+            uart_send_frame(PROTO_MSG_CLOCK, frame->seq, &clock, sizeof(clock));
+            return PROTO_STATUS_OK;
+        }
+
+        default:
+            return PROTO_STATUS_INVALID_ARG;
+    }
 }
 
+static proto_status_t uart_handle_calibration(const uart_frame_t* frame) {
+    if (frame->length != PROTO_CALIBRATION_SIZE) {
+        return PROTO_STATUS_BAD_LENGTH;
+    }
+    const proto_msg_calibration_t* msg = (const proto_msg_calibration_t*)frame->payload;
+    if (!uart_is_valid_joint(msg->joint)) {
+        return PROTO_STATUS_INVALID_ARG;
+    }
+    servo_id_t joint = (servo_id_t)msg->joint;
+    esp_err_t ret;
+
+    if (msg->flags & PROTO_CALIB_SET) {
+        servo_calibration_t calib = {
+            .min_pulse_us = msg->min_pulse_us,
+            .max_pulse_us = msg->max_pulse_us,
+            .offset_mdeg = msg->offset_mdeg,
+            .inverted = msg->inverted,
+            .soft_min = msg->soft_min_mdeg,
+            .soft_max = msg->soft_max_mdeg
+        };
+        ret = servo_set_calibration(joint, &calib);
+        if (ret != ESP_OK) {
+            return uart_status_from_err(ret);
+        }
+    }
+    if (msg->flags & PROTO_CALIB_SAVE) {
+        ret = servo_save_calibration();
+        if (ret != ESP_OK) {
+            return uart_status_from_err(ret);
+        }
+    }
+
+    servo_calibration_t calib;
+    servo_get_calibration(joint, &calib);
+    proto_msg_calibration_reply_t reply = {
+        .joint = msg->joint,
+        .min_pulse_us = calib.min_pulse_us,
+        .max_pulse_us = calib.max_pulse_us,
+        .offset_mdeg = calib.offset_mdeg,
+        .inverted = calib.inverted,
+        .soft_min_mdeg = calib.soft_min,
+        .soft_max_mdeg = calib.soft_max
+    };
+    uart_send_frame(PROTO_MSG_CALIBRATION_REPLY, frame->seq, &reply, sizeof(reply));
+    return PROTO_STATUS_OK;
+}
+
+// exec_us style times are the low half of the device clock: the wrapped
+// difference places one within 35 minutes either side of now, and a late one runs now
+static int64_t uart_device_time(uint32_t time_us) {
+    int64_t now_us = esp_timer_get_time();
+    return now_us + (int32_t)(time_us - (uint32_t)now_us);
+}
+
+static proto_status_t uart_status_from_err(esp_err_t err) {
+    switch (err) {
+        case ESP_OK:
+            return PROTO_STATUS_OK;
+        case ESP_ERR_INVALID_ARG:
+            return PROTO_STATUS_INVALID_ARG;
+        case ESP_ERR_NO_MEM:
+            return PROTO_STATUS_BUSY;
+        default:
+            return PROTO_STATUS_REJECTED;
+    }
+}
 
+static bool uart_is_valid_joint(uint8_t joint) {
+    return joint < servo_get_count();
+}
+
+// Change the rate once the last ack has left at the old one
+static void uart_link_switch(uint32_t baud) {
+    uart_port_t port = uart_link.config.port;
+    uart_wait_tx_done(port, pdMS_TO_TICKS(UART_LINK_TX_DRAIN_MS));
+    esp_err_t ret = uart_set_baudrate(port, baud);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set %lu baud: %s", (unsigned long)baud, esp_err_to_name(ret));
+        return;
+    }
+    // Whatever is half received was sent at the old rate
+    uart_rx_mark_resync();
 
+    uart_link.errors_at_good = uart_link_errors();
+    if (baud == uart_link.config.base_baud) {
+        uart_link.state = UART_LINK_BASE;
+    } else {
+        uart_link.state = UART_LINK_TRIAL;
+        uart_link.deadline_us = esp_timer_get_time() + (int64_t)UART_LINK_CONFIRM_MS * 1000;
+    }
+    taskENTER_CRITICAL(&uart_ring_lock);
+    uart_stats.baud = baud;
+    taskEXIT_CRITICAL(&uart_ring_lock);
+    ESP_LOGI(TAG, "Link switched to %lu baud", (unsigned long)baud);
+}
 
+static void uart_link_good_frame(void) {
+    uart_link.errors_at_good = uart_link_errors();
+    if (uart_link.state == UART_LINK_TRIAL) {
+        uart_link.state = UART_LINK_FAST;
+        ESP_LOGI(TAG, "Link confirmed at %lu baud", (unsigned long)uart_stats.baud);
+    }
+}
+
+// Fall back to the base rate if the new one never worked or stopped working
+static void uart_link_check(void) {
+    if (uart_link.state == UART_LINK_BASE) {
+        return;
+    }
+    bool expired = uart_link.state == UART_LINK_TRIAL && esp_timer_get_time() >= uart_link.deadline_us;
+    uint32_t errors = uart_link_errors() - uart_link.errors_at_good;
+    if (!expired && errors < UART_LINK_MAX_ERRORS) {
+        return;
+    }
+
+    ESP_LOGW(TAG, "Link at %lu baud %s, back to %lu", (unsigned long)uart_stats.baud,
+             expired ? "not confirmed" : "failing", (unsigned long)uart_link.config.base_baud);
+    uart_link_switch(uart_link.config.base_baud);
+    taskENTER_CRITICAL(&uart_ring_lock);
+    uart_stats.fallbacks++;
+    taskEXIT_CRITICAL(&uart_ring_lock);
+}
+
+static uint32_t uart_link_errors(void) {
+    taskENTER_CRITICAL(&uart_ring_lock);
+    uint32_t line_errors = uart_stats.line_errors;
+    taskEXIT_CRITICAL(&uart_ring_lock);
+    return uart_parser.crc_errors + line_errors;
+}
+
+static uint8_t uart_next_tx_seq(void) {
+    taskENTER_CRITICAL(&uart_tx_lock);
+    uint8_t seq = uart_tx_seq++;
+    taskEXIT_CRITICAL(&uart_tx_lock);
+    return seq;
+}
+
+// Timer callback: the frame is built and written by the telemetry task
+static void uart_telemetry_tick(void* arg) {
+    xTaskNotifyGive(uart_telemetry_handle);
+}
+
+static void uart_send_telemetry(void) {
+    uint8_t buffer[PROTO_TELEMETRY_SIZE(3 * SERVO_MAX_JOINTS)];
+    _Static_assert(sizeof(buffer) <= PROTO_MAX_PAYLOAD, "Telemetry for every joint must fit one frame");
+    proto_msg_telemetry_t* msg = (proto_msg_telemetry_t*)buffer;
+    motion_snapshot_t snapshot;
+    motion_tick_stats_t ticks;
+    motion_playout_stats_t playout;
+    uart_rx_stats_t link;
+
+    motion_get_snapshot(&snapshot);
+    motion_get_playout_stats(&playout);
+    motion_get_tick_stats(&ticks);
+    motion_reset_tick_stats();
+    uart_get_rx_stats(&link);
+
+    int count = servo_get_count();
+    msg->time_us = (uint32_t)snapshot.time_us;
+    msg->busy_mask = (uint16_t)snapshot.busy_mask;
+    msg->queue_depth = (uint8_t)snapshot.queue_depth;
+    msg->spline_depth = (uint8_t)snapshot.spline_depth;
+    msg->jitter_max_us = (uint16_t)(ticks.max_jitter_us > UINT16_MAX ? UINT16_MAX : ticks.max_jitter_us);
+    msg->late_ticks = (uint16_t)ticks.late_ticks;
+    msg->crc_errors = (uint16_t)link.crc_errors;
+    msg->overflows = (uint16_t)link.overflows;
+    msg->line_errors = (uint16_t)link.line_errors;
+    msg->playout_depth = (uint8_t)playout.depth;
+    msg->playout_delay_ms = (uint8_t)(playout.delay_us / 1000);
+    msg->underruns = (uint16_t)playout.underruns;
+    msg->overruns = (uint16_t)playout.overruns;
+    msg->count = (uint8_t)(3 * count);
+    for (int i = 0; i < count; i++) {
+        msg->joint[3 * i] = SERVO_DEG_TO_MDEG(snapshot.target[i]);
+        msg->joint[3 * i + 1] = SERVO_DEG_TO_MDEG(snapshot.position[i]);
+        msg->joint[3 * i + 2] = SERVO_DEG_TO_MDEG(snapshot.velocity[i]);
+    }
+    uart_send_frame(PROTO_MSG_TELEMETRY, uart_next_tx_seq(), buffer, PROTO_TELEMETRY_SIZE(3 * count));
+}
+
+// Commands the next control tick puts on the outputs. Queued, timed and
+// buffered ones start later, so their ack goes out at once with no pwm_us.
+static bool uart_drives_outputs(const uart_frame_t* frame) {
+    switch (frame->type) {
+        case PROTO_MSG_JOINT_TARGET:
+        case PROTO_MSG_JOG:
+        case PROTO_MSG_STOP:
+            return true;
+        case PROTO_MSG_POSE:
+            return !(((const proto_msg_pose_t*)frame->payload)->flags & (PROTO_FLAG_QUEUE | PROTO_FLAG_TIMED));
+        case PROTO_MSG_BATCH:
+            return !(((const proto_msg_batch_t*)frame->payload)->flags & PROTO_FLAG_TIMED);
+        default:
+            return false;
+    }
+}
+
+static uint8_t uart_credit(int space) {
+    return (uint8_t)(space < 0 ? 0 : (space > UINT8_MAX ? UINT8_MAX : space));
+}
+
+// Hold the ack until the next control tick has committed; false when full
+static bool uart_defer_ack(const proto_msg_ack_t* ack) {
+    motion_tick_stats_t ticks;
+    motion_get_tick_stats(&ticks);
+
+    taskENTER_CRITICAL(&uart_ack_lock);
+    bool queued = uart_ack_count < UART_ACK_QUEUE_SIZE;
+    if (queued) {
+        uart_acks[uart_ack_count].ack = *ack;
+        uart_acks[uart_ack_count].tick = ticks.ticks;
+        uart_ack_count++;
+    }
+    taskEXIT_CRITICAL(&uart_ack_lock);
+    return queued;
+}
+
+// Send the held acks whose command has reached the outputs
+static void uart_flush_acks(void) {
+    proto_msg_ack_t ready[UART_ACK_QUEUE_SIZE];
+    int count = 0;
+    int kept = 0;
+
+    taskENTER_CRITICAL(&uart_ack_lock);
+    for (int k = 0; k < uart_ack_count; k++) {
+        const uart_pending_ack_t* pending = &uart_acks[k];
+        uint32_t first = pending->tick + 1;
+        if ((int32_t)(uart_last_tick - first) < 0) {
+            uart_acks[kept++] = *pending;
+            continue;
+        }
+        ready[count] = pending->ack;
+        // 0 if the task fell so far behind that the commit time is gone
+        ready[count].pwm_us = (uart_last_tick - first < UART_TICK_HISTORY)
+                              ? uart_tick_commit_us[first & (UART_TICK_HISTORY - 1)] : 0;
+        count++;
+    }
+    uart_ack_count = kept;
+    taskEXIT_CRITICAL(&uart_ack_lock);
+
+    for (int k = 0; k < count; k++) {
+        uart_send_frame(PROTO_MSG_ACK, uart_next_tx_seq(), &ready[k], sizeof(ready[k]));
+    }
+}
+
+// Motion tick hook (esp_timer task): record the commit, wake the processing task if acks wait on it
+static void uart_tick_hook(uint32_t tick, int64_t commit_us, void* arg) {
+    taskENTER_CRITICAL(&uart_ack_lock);
+    uart_tick_commit_us[tick & (UART_TICK_HISTORY - 1)] = (uint32_t)commit_us;
+    uart_last_tick = tick;
+    bool waiting = uart_ack_count > 0;
+    taskEXIT_CRITICAL(&uart_ack_lock);
+
+    if (waiting && uart_proc_handle != NULL) {
+        xTaskNotifyGive(uart_proc_handle);
+    }
+}
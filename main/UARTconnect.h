@@ -5,15 +5,84 @@
 #include "stdbool.h"
 #include "driver/uart.h"
 #include "servo_controller.h"
+#include "uart_parser.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 
-#define UART_PORT UART_NUM_0
-#define UART_BAUD_RATE 115200
-#define UART_BUF_SIZE 1024
-#define UART_RX_BUF_SIZE 1024
-#define UART_PACKET_MAX_SIZE 64
-#define UART_SIGNAL_QUEUE_SIZE 10
+// Command link on its own UART; the console keeps UART0 so log output
+// never lands in the host's byte stream
+#define UART_PORT UART_NUM_1
+#define UART_TX_PIN 17
+#define UART_RX_PIN 16
+#define UART_BAUD_RATE 115200           // Rate at boot and after a fallback
+#define UART_MAX_BAUD_RATE 3000000
+#define UART_RTS_THRESHOLD 100          // RX FIFO level that deasserts RTS (FIFO is 128)
+#define UART_BUF_SIZE 1024              // Driver RX/TX buffers
+#define UART_RX_BUF_SIZE 1024           // Parser ring, power of two
+// Credit window advertised to the host: bytes it may have sent past its last
+// acked frame. A full ring never overflows, the driver buffer behind it
+// absorbs whatever the host sends while the acks are on their way.
+#define UART_RX_WINDOW UART_RX_BUF_SIZE
+#define UART_EVENT_QUEUE_SIZE 20
+
+// RX interrupt triggers: FIFO level, and idle time after the last byte in
+// character times. One character of idle hands a lone gesture byte to the
+// parser right away instead of waiting for the FIFO to fill.
+#define UART_RX_FULL_THRESHOLD 64
+#define UART_RX_TIMEOUT_CHARS 1
+
+// Resync marker: UART_RESYNC_COUNT x UART_RESYNC_CHAR after at least
+// UART_RESYNC_IDLE_CHARS of line idle. Detected by the UART itself; the
+// parser drops any partial frame at that point of the stream.
+#define UART_RESYNC_CHAR 0xFF
+#define UART_RESYNC_COUNT 3
+#define UART_RESYNC_IDLE_CHARS 2
+#define UART_PATTERN_QUEUE_SIZE 8
+
+// Legacy gesture intensity (0-7) to the step delay of servo_uart_controller():
+// the wider the host's finger spread, the faster the joint jogs
+#define UART_LEGACY_STEP_MS(level) ((8 - (level)) * 4)
+
+// Baud rate switch (PROTO_MSG_LINK). The ack goes out at the old rate, then
+// the device changes over and waits UART_LINK_CONFIRM_MS for a good frame.
+// Without one, or after UART_LINK_MAX_ERRORS bad frames or line errors with
+// no good frame in between, it returns to the base rate. Legacy bytes are
+// ignored until the new rate is confirmed: at a mismatched rate noise would
+// decode as gestures.
+#define UART_LINK_CONFIRM_MS 500
+#define UART_LINK_MAX_ERRORS 8
+#define UART_LINK_TX_DRAIN_MS 20
+
+// Telemetry stream (PROTO_MSG_TELEMETRY). Off until the host sets a rate,
+// unless the link config starts it; never faster than the control tick.
+#define UART_TELEMETRY_HZ 0
+#define UART_TELEMETRY_MAX_HZ 200
+
+typedef struct {
+    uart_port_t port;
+    int tx_pin;
+    int rx_pin;
+    int rts_pin;                // UART_PIN_NO_CHANGE when unused
+    int cts_pin;
+    bool flow_control;          // RTS/CTS hardware flow control
+    uint32_t base_baud;         // Rate at boot and after a fallback
+    uint32_t max_baud;          // Highest rate a link request may ask for
+    uint16_t telemetry_hz;      // Telemetry rate at start, 0 = off
+    uart_legacy_mode_t legacy_mode;     // Gesture bytes: until the first v2 frame, always or never
+} uart_link_config_t;
+
+#define DEFAULT_UART_LINK_CONFIG() { \
+    .port = UART_PORT, \
+    .tx_pin = UART_TX_PIN, \
+    .rx_pin = UART_RX_PIN, \
+    .rts_pin = UART_PIN_NO_CHANGE, \
+    .cts_pin = UART_PIN_NO_CHANGE, \
+    .flow_control = false, \
+    .base_baud = UART_BAUD_RATE, \
+    .max_baud = UART_MAX_BAUD_RATE, \
+    .telemetry_hz = UART_TELEMETRY_HZ, \
+    .legacy_mode = UART_LEGACY_AUTO \
+}
 
 
 typedef struct {
@@ -22,13 +91,32 @@ typedef struct {
     int8_t direct;
 } uart_packet_t;
 
+typedef struct {
+    uint32_t bytes;             // Bytes moved from the driver into the ring
+    uint32_t frames;            // Frames dispatched
+    uint32_t dropped;           // Bytes the parser discarded
+    uint32_t crc_errors;        // v2 frames that failed the CRC
+    uint32_t resyncs;           // Resync markers and overflow recoveries
+    uint32_t overflows;         // FIFO / driver buffer overflows (data lost)
+    uint32_t ring_max;          // Ring high-water mark
+    uint32_t line_errors;       // Framing / parity errors and breaks
+    uint32_t baud;              // Current link rate
+    uint32_t fallbacks;         // Returns to the base rate
+} uart_rx_stats_t;
+
 
-esp_err_t uart_manager_init(void);  
+esp_err_t uart_manager_init(void);
+esp_err_t uart_manager_init_with_config(const uart_link_config_t *config);
 esp_err_t uart_check_signals(void);
-esp_err_t uart_read_packet(uart_packet_t *packet, TickType_t timeout);
 void uart_rx_task(void *param);
 void uart_processing_task(void *param);
+void uart_telemetry_task(void *param);
 void uart_manager_log_packet(const uart_packet_t *packet);
+void uart_get_rx_stats(uart_rx_stats_t *stats);
+// Send one v2 frame (protocol_v2.h) to the host
+esp_err_t uart_send_frame(uint8_t type, uint8_t seq, const void *payload, size_t length);
+// 0 stops the stream; ESP_ERR_INVALID_ARG above UART_TELEMETRY_MAX_HZ
+esp_err_t uart_set_telemetry_rate(uint16_t rate_hz);
 
 
 #endif // UARTCONNECT_H
\ No newline at end of file
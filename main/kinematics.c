@@ -0,0 +1,81 @@
+#include "kinematics.h"
+#include <math.h>
+
+#define KIN_DEG_TO_RAD  (0.017453292519943295f)
+#define KIN_RAD_TO_DEG  (57.29577951308232f)
+
+// Private function prototypes
+static float kin_to_joint(const kin_joint_map_t* map, float servo_deg);
+static float kin_to_servo(const kin_joint_map_t* map, float joint_deg);
+
+void kin_forward(const kin_config_t* cfg, const kin_joints_t* joints, kin_pose_t* pose) {
+    float yaw = kin_to_joint(&cfg->base, joints->base) * KIN_DEG_TO_RAD;
+    float a1 = kin_to_joint(&cfg->shoulder, joints->shoulder);
+    float a2 = a1 + kin_to_joint(&cfg->elbow, joints->elbow);
+    float a3 = a2 + kin_to_joint(&cfg->wrist, joints->wrist);
+
+    float r = cfg->upper_arm * cosf(a1 * KIN_DEG_TO_RAD) +
+              cfg->forearm * cosf(a2 * KIN_DEG_TO_RAD) +
+              cfg->tool * cosf(a3 * KIN_DEG_TO_RAD);
+
+    pose->x = r * cosf(yaw);
+    pose->y = r * sinf(yaw);
+    pose->z = cfg->base_height +
+              cfg->upper_arm * sinf(a1 * KIN_DEG_TO_RAD) +
+              cfg->forearm * sinf(a2 * KIN_DEG_TO_RAD) +
+              cfg->tool * sinf(a3 * KIN_DEG_TO_RAD);
+    pose->pitch = a3;
+}
+
+bool kin_inverse(const kin_config_t* cfg, const kin_pose_t* pose,
+                 float min_deg, float max_deg, kin_joints_t* joints) {
+    float l1 = cfg->upper_arm;
+    float l2 = cfg->forearm;
+    float pitch = pose->pitch * KIN_DEG_TO_RAD;
+
+    // Solve the planar 2-link problem for the wrist axis
+    float r = sqrtf(pose->x * pose->x + pose->y * pose->y);
+    float rw = r - cfg->tool * cosf(pitch);
+    float zw = pose->z - cfg->base_height - cfg->tool * sinf(pitch);
+
+    float c2 = (rw * rw + zw * zw - l1 * l1 - l2 * l2) / (2.0f * l1 * l2);
+    if (c2 < -1.0f || c2 > 1.0f) {
+        return false;
+    }
+    float s2 = sqrtf(1.0f - c2 * c2);
+    if (cfg->elbow_up) {
+        s2 = -s2;
+    }
+
+    float a1 = atan2f(zw, rw) - atan2f(l2 * s2, l1 + l2 * c2);
+    float a2 = atan2f(s2, c2);
+    float a3 = remainderf(pitch - a1 - a2, 2.0f * (float)M_PI);
+    // Yaw is undefined with the tip on the base axis, use the kinematic zero
+    float yaw = (r > 1e-3f) ? atan2f(pose->y, pose->x) : 0.0f;
+
+    kin_joints_t out = {
+        .base = kin_to_servo(&cfg->base, yaw * KIN_RAD_TO_DEG),
+        .shoulder = kin_to_servo(&cfg->shoulder, a1 * KIN_RAD_TO_DEG),
+        .elbow = kin_to_servo(&cfg->elbow, a2 * KIN_RAD_TO_DEG),
+        .wrist = kin_to_servo(&cfg->wrist, a3 * KIN_RAD_TO_DEG)
+    };
+
+    if (out.base < min_deg || out.base > max_deg ||
+        out.shoulder < min_deg || out.shoulder > max_deg ||
+        out.elbow < min_deg || out.elbow > max_deg ||
+        out.wrist < min_deg || out.wrist > max_deg) {
+        return false;
+    }
+
+    *joints = out;
+    return true;
+}
+
+// Private function implementations
+static float kin_to_joint(const kin_joint_map_t* map, float servo_deg) {
+    return map->sign * (servo_deg - map->zero);
+}
+
+static float kin_to_servo(const kin_joint_map_t* map, float joint_deg) {
+    return map->zero + map->sign * joint_deg;
+}
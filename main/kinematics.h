@@ -0,0 +1,69 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include "stdbool.h"
+
+// Base yaw + shoulder/elbow/wrist pitch arm. Plain C with no IDF
+// dependencies so it also builds on the host (see tools/bench/ik_bench.c).
+//
+// Frame: origin on the base axis at floor level, z up, x along the arm when
+// the base is at its kinematic zero. Lengths in mm, angles in degrees.
+
+// Tool pose: tip position plus tool pitch above horizontal
+typedef struct {
+    float x;
+    float y;
+    float z;
+    float pitch;
+} kin_pose_t;
+
+// Joint positions as servo angles (the values the servo API takes)
+typedef struct {
+    float base;
+    float shoulder;
+    float elbow;
+    float wrist;
+} kin_joints_t;
+
+// Mapping of one servo onto its kinematic angle: joint = sign * (servo - zero)
+typedef struct {
+    float zero;     // Servo angle at the kinematic zero
+    float sign;     // +1 or -1
+} kin_joint_map_t;
+
+// Arm geometry. Kinematic angles: base yaw from +x, shoulder above
+// horizontal, elbow relative to the upper arm, wrist relative to the forearm.
+typedef struct {
+    float base_height;          // Floor to shoulder axis
+    float upper_arm;            // Shoulder axis to elbow axis
+    float forearm;              // Elbow axis to wrist axis
+    float tool;                 // Wrist axis to tool tip
+    kin_joint_map_t base;
+    kin_joint_map_t shoulder;
+    kin_joint_map_t elbow;
+    kin_joint_map_t wrist;
+    bool elbow_up;              // IK branch
+} kin_config_t;
+
+// Default geometry: servo 90 puts the base forward, the upper arm vertical,
+// the forearm horizontal and the wrist in line with the forearm
+#define DEFAULT_KIN_CONFIG() { \
+    .base_height = 65.0f, \
+    .upper_arm = 80.0f, \
+    .forearm = 80.0f, \
+    .tool = 55.0f, \
+    .base = { .zero = 90.0f, .sign = 1.0f }, \
+    .shoulder = { .zero = 0.0f, .sign = 1.0f }, \
+    .elbow = { .zero = 180.0f, .sign = 1.0f }, \
+    .wrist = { .zero = 90.0f, .sign = 1.0f }, \
+    .elbow_up = true \
+}
+
+void kin_forward(const kin_config_t* cfg, const kin_joints_t* joints, kin_pose_t* pose);
+
+// Returns false if the pose is out of reach or a joint would leave
+// [min_deg, max_deg]; joints is left untouched in that case.
+bool kin_inverse(const kin_config_t* cfg, const kin_pose_t* pose,
+                 float min_deg, float max_deg, kin_joints_t* joints);
+
+#endif // KINEMATICS_H
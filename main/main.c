@@ -5,21 +5,32 @@
 #include "esp_system.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "sdkconfig.h"
 #include <inttypes.h>
 
 // Application modules
 #include "servo_controller.h"
+#include "motion_engine.h"
+#ifndef CONFIG_IDF_TARGET_LINUX
 #include "gpio_manager.h"
+#include "UARTconnect.h"
+#endif
 
 static const char* TAG = "MAIN";
 
-// Demo sequences
+// Demo sequences. The host link owns the arm, so the demo only runs on
+// request: one sequence per button double click (continuously on linux,
+// which has neither buttons nor a host link).
+static TaskHandle_t demo_task_handle = NULL;
+static void demo_task(void* arg);
 static void demo_sequence_basic(void);
 static void demo_sequence_smooth(void);
 static void demo_sequence_coordinated(void);
 
-// Button event handler
+// Button event handler (no buttons on the linux host build)
+#ifndef CONFIG_IDF_TARGET_LINUX
 static void button_event_handler(button_event_t* event);
+#endif
 
 // System initialization
 static esp_err_t system_init(void);
@@ -35,35 +46,11 @@ void app_main(void) {
         return;
     }
     
-    ESP_LOGI(TAG, "System ready - Starting main application loop");
-    
-    // Main application loop
-    uint32_t loop_count = 0;
-    while (1) {
-        ESP_LOGI(TAG, "=== Loop #%lu ===", ++loop_count);
-        
-        // Run different demo sequences
-        switch (loop_count % 3) {
-            case 0:
-                ESP_LOGI(TAG, "Running basic demo sequence");
-                demo_sequence_basic();
-                break;
-                
-            case 1:
-                ESP_LOGI(TAG, "Running smooth movement demo");
-                demo_sequence_smooth();
-                break;
-                
-            case 2:
-                ESP_LOGI(TAG, "Running coordinated movement demo");
-                demo_sequence_coordinated();
-                break;
-        }
-        
-        // Wait before next cycle
-        ESP_LOGI(TAG, "Demo complete, waiting for next cycle...");
-        vTaskDelay(pdMS_TO_TICKS(5000));
+    if (xTaskCreate(demo_task, "demo_task", 4096, NULL, 5, &demo_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create demo task");
+        return;
     }
+    ESP_LOGI(TAG, "System ready - waiting for host commands (double click runs a demo)");
 }
 
 static esp_err_t system_init(void) {
@@ -82,6 +69,7 @@ static esp_err_t system_init(void) {
     }
     ESP_LOGI(TAG, "✓ NVS initialized");
     
+#ifndef CONFIG_IDF_TARGET_LINUX
     // Initialize GPIO manager (handles reset button)
     ret = gpio_manager_init();
     if (ret != ESP_OK) {
@@ -97,6 +85,7 @@ static esp_err_t system_init(void) {
         return ret;
     }
     ESP_LOGI(TAG, "✓ Button callback registered");
+#endif
     
     // Initialize servo controller
     ret = servo_init();
@@ -106,6 +95,16 @@ static esp_err_t system_init(void) {
     }
     ESP_LOGI(TAG, "✓ Servo controller initialized");
     
+#ifndef CONFIG_IDF_TARGET_LINUX
+    // Host command link (needs the servos for dispatch)
+    ret = uart_manager_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize UART link: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(TAG, "✓ UART command link initialized");
+#endif
+    
     // System info
     ESP_LOGI(TAG, "System Information:");
     ESP_LOGI(TAG, "  - Free heap: %lu bytes", esp_get_free_heap_size());
@@ -115,19 +114,53 @@ static esp_err_t system_init(void) {
     return ESP_OK;
 }
 
+static void demo_task(void* arg) {
+    uint32_t run_count = 0;
+    while (1) {
+#ifndef CONFIG_IDF_TARGET_LINUX
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#endif
+        ESP_LOGI(TAG, "=== Demo #%lu ===", ++run_count);
+
+        // Each request runs the next demo sequence in turn
+        switch (run_count % 3) {
+            case 0:
+                ESP_LOGI(TAG, "Running basic demo sequence");
+                demo_sequence_basic();
+                break;
+
+            case 1:
+                ESP_LOGI(TAG, "Running smooth movement demo");
+                demo_sequence_smooth();
+                break;
+
+            case 2:
+                ESP_LOGI(TAG, "Running coordinated movement demo");
+                demo_sequence_coordinated();
+                break;
+        }
+        ESP_LOGI(TAG, "Demo complete");
+#ifdef CONFIG_IDF_TARGET_LINUX
+        vTaskDelay(pdMS_TO_TICKS(5000));
+#endif
+    }
+}
+
 static void demo_sequence_basic(void) {
     ESP_LOGI(TAG, "Starting basic movement sequence");
     
-    // Move each servo individually
+    // Move each servo individually with an S-curve profile
     const int angles[] = {0, 45, 90, 135, 180, 135, 90, 45, 0};
     const int num_angles = sizeof(angles) / sizeof(angles[0]);
     
-    for (int servo = 0; servo < SERVO_COUNT; servo++) {
+    for (int servo = 0; servo < servo_get_count(); servo++) {
         ESP_LOGI(TAG, "Moving %s servo", servo_get_name((servo_id_t)servo));
         
         for (int i = 0; i < num_angles; i++) {
-            servo_set_angle((servo_id_t)servo, angles[i]);
-            vTaskDelay(pdMS_TO_TICKS(800));
+            float duration_s = 0.0f;
+            motion_move_profiled((servo_id_t)servo, angles[i], TRAJ_PROFILE_SCURVE, &duration_s);
+            // Planned duration plus a short dwell instead of a guessed delay
+            vTaskDelay(pdMS_TO_TICKS((uint32_t)(duration_s * 1000.0f)) + pdMS_TO_TICKS(200));
         }
         
         // Small pause between servos
@@ -159,31 +192,27 @@ static void demo_sequence_coordinated(void) {
     ESP_LOGI(TAG, "Starting coordinated movement sequence");
     
     // Define some coordinated positions
-    int position1[] = {45, 90, 135, 90};     // Position 1
-    int position2[] = {90, 45, 90, 135};     // Position 2
-    int position3[] = {135, 135, 45, 45};    // Position 3
-    int home[] = {0, 0, 0, 0};               // Home position
-    
-    // Move through positions
-    ESP_LOGI(TAG, "Moving to position 1");
-    servo_set_all_angles(position1);
-    vTaskDelay(pdMS_TO_TICKS(2000));
-    
-    ESP_LOGI(TAG, "Moving to position 2");
-    servo_set_all_angles(position2);
-    vTaskDelay(pdMS_TO_TICKS(2000));
-    
-    ESP_LOGI(TAG, "Moving to position 3");
-    servo_set_all_angles(position3);
-    vTaskDelay(pdMS_TO_TICKS(2000));
-    
-    ESP_LOGI(TAG, "Returning to home position");
-    servo_set_all_angles(home);
-    vTaskDelay(pdMS_TO_TICKS(1000));
+    // Joints past the arm (gripper) stay at 0
+    const float position1[SERVO_MAX_JOINTS] = {45, 90, 135, 90};     // Position 1
+    const float position2[SERVO_MAX_JOINTS] = {90, 45, 90, 135};     // Position 2
+    const float position3[SERVO_MAX_JOINTS] = {135, 135, 45, 45};    // Position 3
+    const float home[SERVO_MAX_JOINTS] = {0, 0, 0, 0};               // Home position
+    const float* poses[] = {position1, position2, position3, home};
+    const char* pose_names[] = {"position 1", "position 2", "position 3", "home position"};
+    
+    // All joints start and arrive together; wait for the move, then dwell briefly
+    for (int i = 0; i < 4; i++) {
+        float duration_s = 0.0f;
+        motion_move_joints(poses[i], 0.0f, 0.0f, &duration_s);
+        ESP_LOGI(TAG, "Moving to %s (%.2f s)", pose_names[i], duration_s);
+        motion_wait_idle(MOTION_ALL_JOINTS, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(300));
+    }
     
     ESP_LOGI(TAG, "Coordinated sequence completed");
 }
 
+#ifndef CONFIG_IDF_TARGET_LINUX
 static void button_event_handler(button_event_t* event) {
     // This function is called from the GPIO task context
     ESP_LOGI(TAG, "Custom button handler: %s", gpio_get_event_name(event->event_type));
@@ -200,11 +229,14 @@ static void button_event_handler(button_event_t* event) {
             
         case BUTTON_EVENT_DOUBLE_CLICK:
             ESP_LOGI(TAG, "User requested demo mode via double click");
-            // Could trigger special demo mode
+            if (demo_task_handle != NULL) {
+                xTaskNotifyGive(demo_task_handle);
+            }
             break;
             
         default:
             // Other events are handled by the default GPIO task
             break;
     }
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,1779 @@
+#include "motion_engine.h"
+#include "trajectory.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/event_groups.h"
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+static const char* TAG = "MOTION";
+
+// Joints driven by the Cartesian moves
+#define MOTION_KIN_MASK     ((1UL << SERVO_KIN_JOINTS) - 1)
+
+// Per-joint motion state, shared between callers and the control tick
+typedef struct {
+    float position;      // Commanded position (degrees)
+    float velocity;      // Commanded velocity (degrees/s)
+    float acceleration;  // Commanded acceleration (degrees/s^2)
+    float target;        // Final position of the current move
+    traj_segment_t seg;  // Active trajectory segment
+    float elapsed;       // Time spent in seg (seconds)
+    bool active;         // Joint is following seg
+    bool tracking;       // Joint is chasing target with the online generator
+    bool external;       // Output driven by hardware (LEDC fade), seg only mirrors it
+    traj_limits_t limits;  // Limits used while tracking
+    int64_t start_us;    // Tracking starts part way into the current tick, 0 = none
+    int64_t deadman_us;  // Jog brakes at this time unless refreshed, 0 = not jogging
+    bool dirty;          // Position changed, output needs to be written
+} motion_joint_t;
+
+// Joint-space segment being executed. Every joint follows the same
+// normalised 0..1 profile so they all start and arrive together.
+typedef struct {
+    traj_segment_t seg;
+    float delta[SERVO_MAX_JOINTS];
+    float elapsed;
+    float blend;         // Blend radius at the end of this segment (degrees)
+} motion_path_seg_t;
+
+// Segment queue plus up to two overlapping active segments. While blending,
+// the tail of active[0] and the head of active[1] are summed so the arm
+// rounds the corner instead of stopping on it.
+typedef struct {
+    motion_path_seg_t active[2];
+    int active_count;
+    float base[SERVO_MAX_JOINTS];     // Start position of active[0]
+    float end[SERVO_MAX_JOINTS];      // End position of the last activated segment
+    uint32_t mask;               // Joints driven by the path
+    motion_pose_t queue[MOTION_QUEUE_LENGTH];
+    int queue_head;
+    int queue_count;
+} motion_path_t;
+
+// Buffered waypoint on the device time base
+typedef struct {
+    int64_t at_us;
+    float pos[SERVO_MAX_JOINTS];
+} motion_spline_point_t;
+
+// Waypoint stream. points[head] and points[head + 1] bound the cubic being
+// played; the tangent at its end is carried into the next cubic so velocity
+// stays continuous even if a later waypoint arrives too late to shape it.
+typedef struct {
+    motion_spline_point_t points[MOTION_SPLINE_LENGTH];
+    int head;
+    int count;
+    traj_cubic_t cubic[SERVO_MAX_JOINTS];
+    float end_slope[SERVO_MAX_JOINTS];
+    int64_t t0_us;               // Device time of stream time 0
+    bool cubic_valid;
+    bool playing;
+    bool ended;
+} motion_spline_t;
+
+// Arrival lateness is measured against the fastest transit (arrival minus
+// stream time) seen recently. The reference creeps up by MOTION_PLAYOUT_DRIFT
+// so clock drift between host and device cannot pin it, and the peak
+// lateness decays with MOTION_PLAYOUT_DECAY_US so the delay shrinks again
+// after a rough patch.
+#define MOTION_PLAYOUT_DRIFT        (1000)      // 1 us per ms, 1000 ppm
+#define MOTION_PLAYOUT_DECAY_US     (3000000.0f)
+#define MOTION_PLAYOUT_STEER_US     (1000000.0f)    // Delay error that gives full skew, x MAX_SKEW
+
+// Dense setpoint stream. points[].at_us is on the sender's stream time, and
+// play_us is the stream time being played, advanced every tick.
+typedef struct {
+    motion_spline_point_t points[MOTION_PLAYOUT_LENGTH];
+    int head;
+    int count;
+    int64_t play_us;
+    int64_t last_arrival_us;
+    int64_t transit_min_us;
+    float peak_us;               // Decaying peak of the arrival lateness
+    float interval_us;           // Stream time between setpoints
+    float delay_est_us;          // Smoothed delay the setpoints actually get
+    uint32_t delay_us;           // Delay being steered to
+    uint32_t underruns;
+    uint32_t overruns;
+    bool playing;
+    bool ended;
+    bool starved;
+} motion_playout_t;
+
+// Straight-line tool move. The tip follows start + s * delta with s from a
+// normalised profile, and IK turns every sample into joint positions.
+typedef struct {
+    traj_segment_t seg;
+    kin_pose_t start;
+    kin_pose_t delta;
+    float elapsed;
+    bool active;
+} motion_linear_t;
+
+static motion_joint_t joints[SERVO_MAX_JOINTS];
+static int joint_count = 0;         // Joints in the servo table, fixed while running
+static uint32_t joint_mask = 0;
+static motion_path_t path;
+static motion_spline_t spline;
+static motion_linear_t linear;
+static motion_playout_t playout;
+static motion_batch_t batches[MOTION_BATCH_LENGTH];    // Waiting batches in start order
+static int batch_count = 0;
+static kin_config_t kin_config = DEFAULT_KIN_CONFIG();
+static portMUX_TYPE motion_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t motion_timer = NULL;
+static EventGroupHandle_t idle_events = NULL;
+static int64_t last_tick_us = 0;
+static motion_tick_stats_t tick_stats;
+static motion_tick_hook_t tick_hook = NULL;
+static void* tick_hook_arg = NULL;
+static bool motion_running = false;
+static bool sim_clock = false;          // Host tests: ticks come from motion_sim_advance()
+static int64_t sim_now_us = 0;
+
+// Private function prototypes
+static void motion_tick(void* arg);
+static bool motion_is_valid_id(servo_id_t servo_id);
+static esp_err_t motion_start(servo_id_t servo_id, float target_deg,
+                              const traj_limits_t* limits, traj_profile_t profile,
+                              float* duration_s);
+static esp_err_t motion_plan_path_seg(motion_path_seg_t* out, const float start[SERVO_MAX_JOINTS],
+                                      const motion_pose_t* pose);
+static void motion_path_activate(int64_t now_us, float dt);
+static bool motion_path_can_blend(const motion_path_seg_t* cur);
+static void motion_path_tick(int64_t now_us, float dt, uint32_t* finished);
+static void motion_path_clear(void);
+static void motion_joints_to_kin(const float pos[SERVO_MAX_JOINTS], kin_joints_t* kin);
+static void motion_kin_to_joints(const kin_joints_t* kin, float pos[SERVO_MAX_JOINTS]);
+static void motion_linear_tick(float dt, uint32_t* finished);
+static motion_spline_point_t* motion_spline_at(int index);
+static void motion_spline_tick(int64_t now_us, uint32_t* finished);
+static motion_spline_point_t* motion_playout_at(int index);
+static void motion_playout_tick(int64_t period_us, uint32_t* finished);
+static void motion_jog_brake(servo_id_t servo_id);
+static void motion_batch_apply(const motion_batch_t* batch, int64_t start_us);
+static void motion_batch_tick(int64_t now_us);
+static void motion_batch_drop(uint32_t mask);
+static uint32_t motion_batch_pending(void);
+
+esp_err_t motion_engine_init(void) {
+    if (motion_running) {
+        ESP_LOGW(TAG, "Motion engine already running");
+        return ESP_OK;
+    }
+
+    idle_events = xEventGroupCreate();
+    if (idle_events == NULL) {
+        ESP_LOGE(TAG, "Failed to create idle event group");
+        return ESP_ERR_NO_MEM;
+    }
+
+    joint_count = servo_get_count();
+    joint_mask = (1UL << joint_count) - 1;
+
+    // Start from the positions the servo controller already holds
+    for (int i = 0; i < joint_count; i++) {
+        float angle = SERVO_MDEG_TO_DEG(servo_get_current_angle_mdeg((servo_id_t)i));
+        joints[i] = (motion_joint_t){
+            .position = angle,
+            .velocity = 0.0f,
+            .acceleration = 0.0f,
+            .target = angle,
+            .elapsed = 0.0f,
+            .active = false,
+            .tracking = false,
+            .external = false,
+            .dirty = false
+        };
+    }
+    memset(&path, 0, sizeof(path));
+    memset(&spline, 0, sizeof(spline));
+    memset(&linear, 0, sizeof(linear));
+    memset(&playout, 0, sizeof(playout));
+    batch_count = 0;
+    memset(&tick_stats, 0, sizeof(tick_stats));
+    xEventGroupSetBits(idle_events, MOTION_ALL_JOINTS);
+
+    if (sim_clock) {
+        last_tick_us = motion_time_us();
+        motion_running = true;
+        ESP_LOGI(TAG, "Motion engine started on the simulated clock (tick %d us)", MOTION_TICK_PERIOD_US);
+        return ESP_OK;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = motion_tick,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "motion_tick",
+        .skip_unhandled_events = true
+    };
+
+    esp_err_t ret = esp_timer_create(&timer_args, &motion_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create motion timer: %s", esp_err_to_name(ret));
+        goto cleanup;
+    }
+
+    last_tick_us = motion_time_us();
+    ret = esp_timer_start_periodic(motion_timer, MOTION_TICK_PERIOD_US);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start motion timer: %s", esp_err_to_name(ret));
+        goto cleanup;
+    }
+
+    motion_running = true;
+    ESP_LOGI(TAG, "Motion engine started (tick %d us)", MOTION_TICK_PERIOD_US);
+    return ESP_OK;
+
+cleanup:
+    if (motion_timer != NULL) {
+        esp_timer_delete(motion_timer);
+        motion_timer = NULL;
+    }
+    vEventGroupDelete(idle_events);
+    idle_events = NULL;
+    return ret;
+}
+
+void motion_engine_deinit(void) {
+    if (!motion_running) {
+        return;
+    }
+
+    if (motion_timer != NULL) {
+        esp_timer_stop(motion_timer);
+        esp_timer_delete(motion_timer);
+        motion_timer = NULL;
+    }
+    motion_running = false;
+
+    // Release anyone still waiting for a move to finish
+    xEventGroupSetBits(idle_events, MOTION_ALL_JOINTS);
+    vEventGroupDelete(idle_events);
+    idle_events = NULL;
+
+    ESP_LOGI(TAG, "Motion engine stopped");
+}
+
+bool motion_engine_is_running(void) {
+    return motion_running;
+}
+
+esp_err_t motion_set_target(servo_id_t servo_id, float target_deg, float speed_deg_s) {
+    if (speed_deg_s <= 0.0f) {
+        speed_deg_s = MOTION_DEFAULT_SPEED_DEG_S;
+    }
+
+    // Constant speed ramp, same shape as the legacy 1 degree per step move
+    traj_limits_t limits = { .max_vel = speed_deg_s };
+    return motion_start(servo_id, target_deg, &limits, TRAJ_PROFILE_LINEAR, NULL);
+}
+
+esp_err_t motion_move_profiled(servo_id_t servo_id, float target_deg,
+                               traj_profile_t profile, float* duration_s) {
+    traj_limits_t limits;
+    esp_err_t ret = servo_get_limits(servo_id, &limits);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return motion_start(servo_id, target_deg, &limits, profile, duration_s);
+}
+
+esp_err_t motion_nudge(servo_id_t servo_id, float delta_deg, float speed_deg_s) {
+    if (!motion_is_valid_id(servo_id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Relative to the pending target so that repeated nudges accumulate
+    return motion_set_target(servo_id, motion_get_target(servo_id) + delta_deg, speed_deg_s);
+}
+
+esp_err_t motion_track(servo_id_t servo_id, float target_deg, float max_speed_deg_s) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    traj_limits_t limits;
+    esp_err_t ret = servo_get_limits(servo_id, &limits);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (max_speed_deg_s > 0.0f && max_speed_deg_s < limits.max_vel) {
+        limits.max_vel = max_speed_deg_s;
+    }
+    target_deg = servo_clamp_angle(servo_id, target_deg);
+
+    xEventGroupClearBits(idle_events, MOTION_JOINT_BIT(servo_id));
+
+    // Only the setpoint changes: position, velocity and acceleration carry
+    // over, including from a profiled move or path the joint was following
+    taskENTER_CRITICAL(&motion_lock);
+    motion_joint_t* joint = &joints[servo_id];
+    joint->target = target_deg;
+    joint->limits = limits;
+    joint->active = false;
+    joint->tracking = true;
+    joint->external = false;
+    joint->deadman_us = 0;
+    path.mask &= ~MOTION_JOINT_BIT(servo_id);
+    taskEXIT_CRITICAL(&motion_lock);
+    return ESP_OK;
+}
+
+esp_err_t motion_jog(servo_id_t servo_id, float velocity_deg_s, uint32_t timeout_ms) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    traj_limits_t limits;
+    esp_err_t ret = servo_get_limits(servo_id, &limits);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (velocity_deg_s != 0.0f && fabsf(velocity_deg_s) < limits.max_vel) {
+        limits.max_vel = fabsf(velocity_deg_s);
+    }
+    if (timeout_ms == 0) {
+        timeout_ms = MOTION_JOG_TIMEOUT_MS;
+    }
+    float limit = servo_clamp_angle(servo_id, velocity_deg_s > 0.0f ? SERVO_MAX_ANGLE : SERVO_MIN_ANGLE);
+
+    xEventGroupClearBits(idle_events, MOTION_JOINT_BIT(servo_id));
+
+    // Tracked like motion_track(), so a new velocity blends from the old one
+    taskENTER_CRITICAL(&motion_lock);
+    motion_joint_t* joint = &joints[servo_id];
+    joint->limits = limits;
+    joint->active = false;
+    joint->tracking = true;
+    joint->external = false;
+    path.mask &= ~MOTION_JOINT_BIT(servo_id);
+    if (velocity_deg_s == 0.0f) {
+        motion_jog_brake(servo_id);
+    } else {
+        joint->target = limit;
+        joint->deadman_us = motion_time_us() + (int64_t)timeout_ms * 1000;
+    }
+    taskEXIT_CRITICAL(&motion_lock);
+    return ESP_OK;
+}
+
+esp_err_t motion_jump(servo_id_t servo_id, float angle_deg) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!motion_is_valid_id(servo_id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    angle_deg = servo_clamp_angle(servo_id, angle_deg);
+
+    taskENTER_CRITICAL(&motion_lock);
+    motion_joint_t* joint = &joints[servo_id];
+    joint->position = angle_deg;
+    joint->velocity = 0.0f;
+    joint->acceleration = 0.0f;
+    joint->target = angle_deg;
+    joint->active = false;
+    joint->tracking = false;
+    joint->external = false;
+    joint->dirty = true;
+    path.mask &= ~MOTION_JOINT_BIT(servo_id);
+    taskEXIT_CRITICAL(&motion_lock);
+
+    xEventGroupSetBits(idle_events, MOTION_JOINT_BIT(servo_id));
+    return ESP_OK;
+}
+
+esp_err_t motion_stop(servo_id_t servo_id) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!motion_is_valid_id(servo_id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL(&motion_lock);
+    joints[servo_id].target = joints[servo_id].position;
+    joints[servo_id].velocity = 0.0f;
+    joints[servo_id].acceleration = 0.0f;
+    joints[servo_id].active = false;
+    joints[servo_id].tracking = false;
+    joints[servo_id].external = false;
+    path.mask &= ~MOTION_JOINT_BIT(servo_id);
+    motion_batch_drop(MOTION_JOINT_BIT(servo_id));
+    taskEXIT_CRITICAL(&motion_lock);
+
+    xEventGroupSetBits(idle_events, MOTION_JOINT_BIT(servo_id));
+    return ESP_OK;
+}
+
+esp_err_t motion_jump_all(const float angles[SERVO_MAX_JOINTS]) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (angles == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // One critical section, so every joint is written by the same tick
+    taskENTER_CRITICAL(&motion_lock);
+    for (int i = 0; i < joint_count; i++) {
+        motion_joint_t* joint = &joints[i];
+        joint->position = servo_clamp_angle((servo_id_t)i, angles[i]);
+        joint->velocity = 0.0f;
+        joint->acceleration = 0.0f;
+        joint->target = joint->position;
+        joint->active = false;
+        joint->tracking = false;
+        joint->external = false;
+        joint->dirty = true;
+    }
+    motion_path_clear();
+    taskEXIT_CRITICAL(&motion_lock);
+
+    xEventGroupSetBits(idle_events, joint_mask);
+    return ESP_OK;
+}
+
+esp_err_t motion_move_joints(const float targets[SERVO_MAX_JOINTS], float duration_s,
+                             float max_speed_deg_s, float* planned_s) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (targets == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    motion_pose_t pose = {
+        .max_speed = max_speed_deg_s,
+        .duration = duration_s,
+        .blend = 0.0f
+    };
+    memcpy(pose.target, targets, joint_count * sizeof(float));
+
+    xEventGroupClearBits(idle_events, joint_mask);
+
+    // Replaces whatever the path was doing, starting from the current position
+    taskENTER_CRITICAL(&motion_lock);
+    motion_path_clear();
+    for (int i = 0; i < joint_count; i++) {
+        path.base[i] = joints[i].position;
+        joints[i].active = false;
+        joints[i].tracking = false;
+        joints[i].external = false;
+    }
+    esp_err_t ret = motion_plan_path_seg(&path.active[0], path.base, &pose);
+    if (ret == ESP_OK && path.active[0].seg.duration > 0.0f) {
+        for (int i = 0; i < joint_count; i++) {
+            path.end[i] = path.base[i] + path.active[0].delta[i];
+            joints[i].target = path.end[i];
+        }
+        path.active_count = 1;
+        path.mask = joint_mask;
+    }
+    bool active = (path.active_count > 0);
+    float duration = active ? path.active[0].seg.duration : 0.0f;
+    taskEXIT_CRITICAL(&motion_lock);
+
+    if (!active) {
+        xEventGroupSetBits(idle_events, joint_mask);
+    }
+    if (ret == ESP_OK && planned_s != NULL) {
+        *planned_s = duration;
+    }
+    return ret;
+}
+
+esp_err_t motion_queue_pose(const motion_pose_t* pose) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (pose == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pose->start_us - motion_time_us() > (int64_t)MOTION_POSE_MAX_LEAD_MS * 1000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xEventGroupClearBits(idle_events, joint_mask);
+
+    esp_err_t ret = ESP_OK;
+    taskENTER_CRITICAL(&motion_lock);
+    if (spline.playing || playout.playing || linear.active) {
+        // The path and the streams would fight over the joints
+        ret = ESP_ERR_INVALID_STATE;
+    } else if (path.queue_count >= MOTION_QUEUE_LENGTH) {
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        int slot = (path.queue_head + path.queue_count) % MOTION_QUEUE_LENGTH;
+        path.queue[slot] = *pose;
+        path.queue_count++;
+    }
+    bool idle = (path.active_count == 0 && path.queue_count == 0);
+    taskEXIT_CRITICAL(&motion_lock);
+
+    if (idle) {
+        xEventGroupSetBits(idle_events, joint_mask);
+    }
+    return ret;
+}
+
+int motion_queue_space(void) {
+    taskENTER_CRITICAL(&motion_lock);
+    int space = MOTION_QUEUE_LENGTH - path.queue_count;
+    taskEXIT_CRITICAL(&motion_lock);
+    return space;
+}
+
+void motion_queue_flush(void) {
+    taskENTER_CRITICAL(&motion_lock);
+    path.queue_count = 0;
+    taskEXIT_CRITICAL(&motion_lock);
+}
+
+esp_err_t motion_spline_push(const motion_waypoint_t* waypoint) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (waypoint == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    float pos[SERVO_MAX_JOINTS] = {0};
+    for (int i = 0; i < joint_count; i++) {
+        pos[i] = servo_clamp_angle((servo_id_t)i, waypoint->pos[i]);
+    }
+
+    xEventGroupClearBits(idle_events, joint_mask);
+
+    int64_t now_us = motion_time_us();
+    int64_t lead_us = (int64_t)MOTION_SPLINE_LEAD_MS * 1000;
+    esp_err_t ret = ESP_OK;
+
+    taskENTER_CRITICAL(&motion_lock);
+    if (!spline.playing) {
+        // New stream: take over every joint and start from where it is now
+        motion_path_clear();
+        motion_spline_point_t* start = &spline.points[0];
+        start->at_us = now_us;
+        for (int i = 0; i < joint_count; i++) {
+            start->pos[i] = joints[i].position;
+            spline.end_slope[i] = 0.0f;
+            joints[i].active = false;
+            joints[i].tracking = false;
+            joints[i].external = false;
+        }
+        spline.head = 0;
+        spline.count = 1;
+        spline.t0_us = now_us + lead_us - (int64_t)waypoint->t_ms * 1000;
+        spline.cubic_valid = false;
+        spline.playing = true;
+        spline.ended = false;
+        path.mask = joint_mask;
+    }
+
+    int64_t at_us = spline.t0_us + (int64_t)waypoint->t_ms * 1000;
+    motion_spline_point_t* last = motion_spline_at(spline.count - 1);
+    if (spline.count == 1 && last->at_us < now_us) {
+        // Stream ran dry and the arm is holding: move on from here, and
+        // re-anchor a waypoint that is already due instead of jumping to it
+        last->at_us = now_us;
+        if (at_us < now_us + lead_us) {
+            spline.t0_us += now_us + lead_us - at_us;
+            at_us = now_us + lead_us;
+        }
+    }
+
+    if (spline.count >= MOTION_SPLINE_LENGTH) {
+        ret = ESP_ERR_NO_MEM;
+    } else if (at_us <= last->at_us) {
+        ret = ESP_ERR_INVALID_ARG;
+    } else {
+        motion_spline_point_t* point = motion_spline_at(spline.count);
+        point->at_us = at_us;
+        memcpy(point->pos, pos, sizeof(point->pos));
+        spline.count++;
+        spline.ended = false;
+        for (int i = 0; i < joint_count; i++) {
+            joints[i].target = pos[i];
+        }
+    }
+    taskEXIT_CRITICAL(&motion_lock);
+    return ret;
+}
+
+void motion_spline_end(void) {
+    taskENTER_CRITICAL(&motion_lock);
+    spline.ended = true;
+    taskEXIT_CRITICAL(&motion_lock);
+}
+
+int motion_spline_space(void) {
+    taskENTER_CRITICAL(&motion_lock);
+    int space = MOTION_SPLINE_LENGTH - (spline.playing ? spline.count : 0);
+    taskEXIT_CRITICAL(&motion_lock);
+    return space;
+}
+
+esp_err_t motion_playout_push(const motion_setpoint_t* setpoint) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (setpoint == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    float pos[SERVO_MAX_JOINTS] = {0};
+    for (int i = 0; i < joint_count; i++) {
+        pos[i] = servo_clamp_angle((servo_id_t)i, setpoint->pos[i]);
+    }
+
+    xEventGroupClearBits(idle_events, joint_mask);
+
+    int64_t now_us = motion_time_us();
+    esp_err_t ret = ESP_OK;
+
+    taskENTER_CRITICAL(&motion_lock);
+    int64_t t_us;
+    if (!playout.playing) {
+        // New stream: take over every joint and glide from where it is now
+        int64_t start_us = (int64_t)MOTION_PLAYOUT_START_DELAY_MS * 1000;
+        motion_path_clear();
+        t_us = setpoint->t_us;
+        motion_spline_point_t* start = &playout.points[0];
+        start->at_us = t_us - start_us;
+        for (int i = 0; i < joint_count; i++) {
+            start->pos[i] = joints[i].position;
+            joints[i].active = false;
+            joints[i].tracking = false;
+            joints[i].external = false;
+        }
+        playout.head = 0;
+        playout.count = 1;
+        playout.play_us = start->at_us;
+        playout.last_arrival_us = now_us;
+        playout.transit_min_us = now_us - t_us;
+        playout.peak_us = 0.0f;
+        playout.interval_us = 0.0f;
+        playout.delay_est_us = (float)start_us;
+        playout.delay_us = (uint32_t)start_us;
+        playout.playing = true;
+        playout.ended = false;
+        playout.starved = false;
+        path.mask = joint_mask;
+    } else {
+        // Unwrap the sender's 32-bit time against the newest setpoint
+        int64_t newest_us = motion_playout_at(playout.count - 1)->at_us;
+        t_us = newest_us + (int32_t)(setpoint->t_us - (uint32_t)newest_us);
+    }
+
+    // Lateness against the fastest recent transit, even for a refused setpoint
+    int64_t since_us = now_us - playout.last_arrival_us;
+    int64_t transit_us = now_us - t_us;
+    playout.transit_min_us += since_us / MOTION_PLAYOUT_DRIFT;
+    if (transit_us < playout.transit_min_us) {
+        playout.transit_min_us = transit_us;
+    }
+    float lateness = (float)(transit_us - playout.transit_min_us);
+    playout.peak_us -= playout.peak_us * fminf(1.0f, (float)since_us / MOTION_PLAYOUT_DECAY_US);
+    playout.peak_us = fmaxf(playout.peak_us, lateness);
+    playout.last_arrival_us = now_us;
+
+    // Playing up to a setpoint needs the one after it too, so cover the
+    // setpoint interval and the worst lateness, plus a tick for sampling on
+    // the tick grid and one for the steering, which only approaches its target
+    motion_spline_point_t* last = motion_playout_at(playout.count - 1);
+    if (playout.count >= 2 && t_us > last->at_us) {
+        playout.interval_us = (float)(t_us - last->at_us);
+    }
+    float delay = playout.peak_us + playout.interval_us + 2 * MOTION_TICK_PERIOD_US;
+    delay = fminf(fmaxf(delay, MOTION_PLAYOUT_MIN_DELAY_MS * 1000.0f), MOTION_PLAYOUT_MAX_DELAY_MS * 1000.0f);
+    playout.delay_us = (uint32_t)delay;
+    // What this setpoint would have been ahead of playout had it been on time
+    float got = (float)(t_us - playout.play_us) + lateness;
+    playout.delay_est_us += (got - playout.delay_est_us) / 16.0f;
+
+    if (t_us <= last->at_us) {
+        ret = ESP_ERR_INVALID_ARG;
+    } else if (playout.count >= MOTION_PLAYOUT_LENGTH) {
+        playout.overruns++;
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        motion_spline_point_t* point = motion_playout_at(playout.count);
+        point->at_us = t_us;
+        memcpy(point->pos, pos, sizeof(point->pos));
+        playout.count++;
+        playout.ended = false;
+        playout.starved = false;
+        for (int i = 0; i < joint_count; i++) {
+            joints[i].target = pos[i];
+        }
+    }
+    taskEXIT_CRITICAL(&motion_lock);
+    return ret;
+}
+
+void motion_playout_end(void) {
+    taskENTER_CRITICAL(&motion_lock);
+    playout.ended = true;
+    taskEXIT_CRITICAL(&motion_lock);
+}
+
+int motion_playout_space(void) {
+    taskENTER_CRITICAL(&motion_lock);
+    // A new stream keeps a slot for the pose it starts from
+    int space = MOTION_PLAYOUT_LENGTH - (playout.playing ? playout.count : 1);
+    taskEXIT_CRITICAL(&motion_lock);
+    return space;
+}
+
+void motion_get_playout_stats(motion_playout_stats_t* stats) {
+    taskENTER_CRITICAL(&motion_lock);
+    stats->depth = playout.playing ? playout.count : 0;
+    stats->delay_us = playout.delay_us;
+    stats->jitter_us = (uint32_t)playout.peak_us;
+    stats->underruns = playout.underruns;
+    stats->overruns = playout.overruns;
+    taskEXIT_CRITICAL(&motion_lock);
+}
+
+esp_err_t motion_batch(const motion_batch_t* batch) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (batch == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t mask = batch->mask & joint_mask;
+    int64_t now_us = motion_time_us();
+    if (mask == 0 || batch->at_us - now_us > (int64_t)MOTION_BATCH_MAX_LEAD_MS * 1000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xEventGroupClearBits(idle_events, mask);
+
+    esp_err_t ret = ESP_OK;
+    uint32_t finished = 0;
+    taskENTER_CRITICAL(&motion_lock);
+    if (batch->at_us <= now_us) {
+        // Due now: the next tick sees every joint of the batch retargeted
+        motion_batch_apply(batch, 0);
+    } else if (batch_count >= MOTION_BATCH_LENGTH) {
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        // Insert after the batches starting at the same time or earlier
+        int slot = batch_count;
+        while (slot > 0 && batches[slot - 1].at_us > batch->at_us) {
+            batches[slot] = batches[slot - 1];
+            slot--;
+        }
+        batches[slot] = *batch;
+        batches[slot].mask = mask;
+        batch_count++;
+    }
+    uint32_t pending = motion_batch_pending();
+    if (ret != ESP_OK) {
+        // Refused: the joints keep doing whatever they were doing
+        for (int i = 0; i < joint_count; i++) {
+            const motion_joint_t* joint = &joints[i];
+            if ((mask & MOTION_JOINT_BIT(i)) && !joint->active && !joint->tracking &&
+                !(path.mask & MOTION_JOINT_BIT(i))) {
+                finished |= MOTION_JOINT_BIT(i);
+            }
+        }
+    }
+    taskEXIT_CRITICAL(&motion_lock);
+
+    finished &= ~pending;
+    if (finished) {
+        xEventGroupSetBits(idle_events, finished);
+    }
+    return ret;
+}
+
+int motion_batch_space(void) {
+    taskENTER_CRITICAL(&motion_lock);
+    int space = MOTION_BATCH_LENGTH - batch_count;
+    taskEXIT_CRITICAL(&motion_lock);
+    return space;
+}
+
+void motion_stop_all(void) {
+    taskENTER_CRITICAL(&motion_lock);
+    motion_path_clear();
+    taskEXIT_CRITICAL(&motion_lock);
+
+    for (int i = 0; i < joint_count; i++) {
+        motion_stop((servo_id_t)i);
+    }
+}
+
+esp_err_t motion_set_kinematics(const kin_config_t* cfg) {
+    if (cfg == NULL || cfg->upper_arm <= 0.0f || cfg->forearm <= 0.0f || cfg->tool < 0.0f) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    taskENTER_CRITICAL(&motion_lock);
+    kin_config = *cfg;
+    taskEXIT_CRITICAL(&motion_lock);
+    return ESP_OK;
+}
+
+void motion_get_kinematics(kin_config_t* cfg) {
+    taskENTER_CRITICAL(&motion_lock);
+    *cfg = kin_config;
+    taskEXIT_CRITICAL(&motion_lock);
+}
+
+void motion_get_pose(kin_pose_t* pose) {
+    float pos[SERVO_MAX_JOINTS];
+    kin_config_t cfg;
+    kin_joints_t kin;
+
+    taskENTER_CRITICAL(&motion_lock);
+    for (int i = 0; i < joint_count; i++) {
+        pos[i] = joints[i].position;
+    }
+    cfg = kin_config;
+    taskEXIT_CRITICAL(&motion_lock);
+
+    motion_joints_to_kin(pos, &kin);
+    kin_forward(&cfg, &kin, pose);
+}
+
+esp_err_t motion_move_linear(const kin_pose_t* target, float speed_mm_s, float* planned_s) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (target == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (joint_count < SERVO_KIN_JOINTS) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (speed_mm_s <= 0.0f) {
+        speed_mm_s = MOTION_LINEAR_SPEED_MM_S;
+    }
+
+    xEventGroupClearBits(idle_events, MOTION_KIN_MASK);
+
+    esp_err_t ret = ESP_OK;
+    taskENTER_CRITICAL(&motion_lock);
+    kin_joints_t goal;
+    if (!kin_inverse(&kin_config, target, SERVO_MIN_ANGLE, SERVO_MAX_ANGLE, &goal)) {
+        ret = ESP_ERR_INVALID_ARG;
+    } else {
+        // Start from the pose the joints are at now
+        float pos[SERVO_MAX_JOINTS];
+        kin_joints_t kin;
+        motion_path_clear();
+        for (int i = 0; i < SERVO_KIN_JOINTS; i++) {
+            pos[i] = joints[i].position;
+            joints[i].active = false;
+            joints[i].tracking = false;
+            joints[i].external = false;
+        }
+        motion_joints_to_kin(pos, &kin);
+        kin_forward(&kin_config, &kin, &linear.start);
+
+        linear.delta = (kin_pose_t){
+            .x = target->x - linear.start.x,
+            .y = target->y - linear.start.y,
+            .z = target->z - linear.start.z,
+            .pitch = target->pitch - linear.start.pitch
+        };
+        float dist = sqrtf(linear.delta.x * linear.delta.x + linear.delta.y * linear.delta.y +
+                           linear.delta.z * linear.delta.z);
+        float turn = fabsf(linear.delta.pitch);
+
+        // Normalised limits, pitch gets the same time constants as the tip
+        float pitch_speed = MOTION_LINEAR_PITCH_DEG_S;
+        float scale = speed_mm_s / MOTION_LINEAR_SPEED_MM_S;
+        traj_limits_t unit = { .max_vel = INFINITY, .max_acc = INFINITY, .max_jerk = INFINITY };
+        if (dist > 0.0f) {
+            unit.max_vel = speed_mm_s / dist;
+            unit.max_acc = MOTION_LINEAR_ACC_MM_S2 * scale / dist;
+            unit.max_jerk = MOTION_LINEAR_JERK_MM_S3 * scale / dist;
+        }
+        if (turn > 0.0f) {
+            float k = pitch_speed / MOTION_LINEAR_SPEED_MM_S;
+            unit.max_vel = fminf(unit.max_vel, pitch_speed / turn);
+            unit.max_acc = fminf(unit.max_acc, MOTION_LINEAR_ACC_MM_S2 * k / turn);
+            unit.max_jerk = fminf(unit.max_jerk, MOTION_LINEAR_JERK_MM_S3 * k / turn);
+        }
+
+        if (isfinite(unit.max_vel)) {
+            ret = traj_plan(&linear.seg, 0.0f, 1.0f, &unit, TRAJ_PROFILE_SCURVE) ? ESP_OK : ESP_ERR_INVALID_ARG;
+        } else {
+            memset(&linear.seg, 0, sizeof(linear.seg));
+        }
+        if (ret == ESP_OK && linear.seg.duration > 0.0f) {
+            float end[SERVO_MAX_JOINTS];
+            motion_kin_to_joints(&goal, end);
+            for (int i = 0; i < SERVO_KIN_JOINTS; i++) {
+                joints[i].target = end[i];
+            }
+            linear.elapsed = 0.0f;
+            linear.active = true;
+            // Extra joints (gripper) are left to their own commands
+            path.mask = MOTION_KIN_MASK;
+        }
+    }
+    bool active = linear.active;
+    float duration = active ? linear.seg.duration : 0.0f;
+    taskEXIT_CRITICAL(&motion_lock);
+
+    if (!active) {
+        xEventGroupSetBits(idle_events, MOTION_KIN_MASK);
+    }
+    if (ret == ESP_OK && planned_s != NULL) {
+        *planned_s = duration;
+    }
+    return ret;
+}
+
+esp_err_t motion_external_begin(servo_id_t servo_id, float target_deg, float duration_s) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!motion_is_valid_id(servo_id) || duration_s <= 0.0f) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xEventGroupClearBits(idle_events, MOTION_JOINT_BIT(servo_id));
+
+    taskENTER_CRITICAL(&motion_lock);
+    motion_joint_t* joint = &joints[servo_id];
+    // Linear segment of the same length so position queries follow the ramp
+    traj_limits_t limits = { .max_vel = fmaxf(fabsf(target_deg - joint->position) / duration_s, 1e-3f) };
+    esp_err_t ret = traj_plan(&joint->seg, joint->position, target_deg, &limits, TRAJ_PROFILE_LINEAR)
+                  ? ESP_OK : ESP_ERR_INVALID_ARG;
+    if (ret == ESP_OK) {
+        joint->seg.duration = duration_s;
+        joint->target = target_deg;
+        joint->elapsed = 0.0f;
+        joint->active = true;
+        joint->tracking = false;
+        joint->external = true;
+        joint->dirty = false;
+        path.mask &= ~MOTION_JOINT_BIT(servo_id);
+    }
+    taskEXIT_CRITICAL(&motion_lock);
+
+    if (ret != ESP_OK) {
+        xEventGroupSetBits(idle_events, MOTION_JOINT_BIT(servo_id));
+    }
+    return ret;
+}
+
+bool motion_external_done_from_isr(servo_id_t servo_id) {
+    if (!motion_is_valid_id(servo_id)) {
+        return false;
+    }
+
+    taskENTER_CRITICAL_ISR(&motion_lock);
+    motion_joint_t* joint = &joints[servo_id];
+    // Stale if another command took the joint over in the meantime
+    bool done = joint->external;
+    if (done) {
+        joint->position = joint->target;
+        joint->velocity = 0.0f;
+        joint->acceleration = 0.0f;
+        joint->active = false;
+        joint->external = false;
+    }
+    taskEXIT_CRITICAL_ISR(&motion_lock);
+
+    BaseType_t woken = pdFALSE;
+    if (done && idle_events != NULL) {
+        xEventGroupSetBitsFromISR(idle_events, MOTION_JOINT_BIT(servo_id), &woken);
+    }
+    return woken == pdTRUE;
+}
+
+bool motion_is_external(servo_id_t servo_id) {
+    if (!motion_is_valid_id(servo_id)) {
+        return false;
+    }
+    taskENTER_CRITICAL(&motion_lock);
+    bool external = joints[servo_id].external;
+    taskEXIT_CRITICAL(&motion_lock);
+    return external;
+}
+
+bool motion_is_busy(servo_id_t servo_id) {
+    if (!motion_running || !motion_is_valid_id(servo_id)) {
+        return false;
+    }
+    taskENTER_CRITICAL(&motion_lock);
+    bool busy = joints[servo_id].active || joints[servo_id].tracking ||
+                (path.mask & MOTION_JOINT_BIT(servo_id)) ||
+                (path.queue_count > 0) ||
+                (motion_batch_pending() & MOTION_JOINT_BIT(servo_id));
+    taskEXIT_CRITICAL(&motion_lock);
+    return busy;
+}
+
+float motion_get_position(servo_id_t servo_id) {
+    if (!motion_is_valid_id(servo_id)) {
+        return 0.0f;
+    }
+    taskENTER_CRITICAL(&motion_lock);
+    float position = joints[servo_id].position;
+    taskEXIT_CRITICAL(&motion_lock);
+    return position;
+}
+
+float motion_get_target(servo_id_t servo_id) {
+    if (!motion_is_valid_id(servo_id)) {
+        return 0.0f;
+    }
+    taskENTER_CRITICAL(&motion_lock);
+    float target = joints[servo_id].target;
+    taskEXIT_CRITICAL(&motion_lock);
+    return target;
+}
+
+float motion_get_remaining_time(servo_id_t servo_id) {
+    if (!motion_is_valid_id(servo_id)) {
+        return 0.0f;
+    }
+    taskENTER_CRITICAL(&motion_lock);
+    const motion_joint_t* joint = &joints[servo_id];
+    float remaining = 0.0f;
+    if (joint->active) {
+        remaining = joint->seg.duration - joint->elapsed;
+    } else if ((path.mask & MOTION_JOINT_BIT(servo_id)) && path.active_count > 0) {
+        // Queued segments are planned on activation, so only the active ones count
+        const motion_path_seg_t* last = &path.active[path.active_count - 1];
+        remaining = last->seg.duration - last->elapsed;
+    } else if ((path.mask & MOTION_JOINT_BIT(servo_id)) && linear.active) {
+        remaining = linear.seg.duration - linear.elapsed;
+    } else if ((path.mask & MOTION_JOINT_BIT(servo_id)) && spline.playing) {
+        int64_t end_us = motion_spline_at(spline.count - 1)->at_us;
+        remaining = (float)(end_us - motion_time_us()) / 1000000.0f;
+    } else if ((path.mask & MOTION_JOINT_BIT(servo_id)) && playout.playing) {
+        remaining = (float)(motion_playout_at(playout.count - 1)->at_us - playout.play_us) / 1000000.0f;
+    }
+    taskEXIT_CRITICAL(&motion_lock);
+    return (remaining > 0.0f) ? remaining : 0.0f;
+}
+
+void motion_get_snapshot(motion_snapshot_t* snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    taskENTER_CRITICAL(&motion_lock);
+    snapshot->time_us = last_tick_us;
+    for (int i = 0; i < joint_count; i++) {
+        const motion_joint_t* joint = &joints[i];
+        snapshot->target[i] = joint->target;
+        snapshot->position[i] = joint->position;
+        snapshot->velocity[i] = joint->velocity;
+        if (joint->active || joint->tracking || (path.mask & MOTION_JOINT_BIT(i))) {
+            snapshot->busy_mask |= MOTION_JOINT_BIT(i);
+        }
+    }
+    snapshot->busy_mask |= motion_batch_pending();
+    if (path.queue_count > 0) {
+        snapshot->busy_mask |= joint_mask;
+    }
+    snapshot->queue_depth = path.queue_count;
+    snapshot->spline_depth = spline.playing ? spline.count : 0;
+    taskEXIT_CRITICAL(&motion_lock);
+}
+
+void motion_get_tick_stats(motion_tick_stats_t* stats) {
+    taskENTER_CRITICAL(&motion_lock);
+    *stats = tick_stats;
+    taskEXIT_CRITICAL(&motion_lock);
+}
+
+void motion_set_tick_hook(motion_tick_hook_t hook, void* arg) {
+    taskENTER_CRITICAL(&motion_lock);
+    tick_hook = hook;
+    tick_hook_arg = arg;
+    taskEXIT_CRITICAL(&motion_lock);
+}
+
+void motion_reset_tick_stats(void) {
+    taskENTER_CRITICAL(&motion_lock);
+    tick_stats.max_jitter_us = 0;
+    taskEXIT_CRITICAL(&motion_lock);
+}
+
+esp_err_t motion_wait_idle(uint32_t joint_bits, TickType_t timeout) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    joint_bits &= MOTION_ALL_JOINTS;
+    EventBits_t bits = xEventGroupWaitBits(idle_events, joint_bits, pdFALSE, pdTRUE, timeout);
+    return ((bits & joint_bits) == joint_bits) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t motion_set_sim_clock(bool enable) {
+    if (motion_running) {
+        ESP_LOGE(TAG, "Simulated clock must be set before servo_init()");
+        return ESP_ERR_INVALID_STATE;
+    }
+    sim_clock = enable;
+    sim_now_us = 0;
+    return ESP_OK;
+}
+
+void motion_sim_advance(uint32_t duration_us) {
+    if (!sim_clock || !motion_running) {
+        return;
+    }
+    // Every tick runs at its exact time, so the trace is the same on every run
+    int64_t end_us = sim_now_us + duration_us;
+    while (last_tick_us + MOTION_TICK_PERIOD_US <= end_us) {
+        sim_now_us = last_tick_us + MOTION_TICK_PERIOD_US;
+        motion_tick(NULL);
+    }
+    sim_now_us = end_us;
+}
+
+int64_t motion_time_us(void) {
+    return sim_clock ? sim_now_us : esp_timer_get_time();
+}
+
+// Private function implementations
+static void motion_tick(void* arg) {
+    int64_t now_us = motion_time_us();
+    int64_t period_us = now_us - last_tick_us;
+    float dt = (float)period_us / 1000000.0f;
+
+    float outputs[SERVO_MAX_JOINTS];
+    uint32_t write_mask = 0;
+    uint32_t finished = 0;
+
+    // Advance every joint in the same tick, outputs are written outside the lock
+    taskENTER_CRITICAL(&motion_lock);
+    last_tick_us = now_us;
+    uint32_t jitter_us = (uint32_t)llabs(period_us - MOTION_TICK_PERIOD_US);
+    tick_stats.ticks++;
+    tick_stats.last_jitter_us = jitter_us;
+    if (jitter_us > tick_stats.max_jitter_us) {
+        tick_stats.max_jitter_us = jitter_us;
+    }
+    if (period_us > MOTION_TICK_PERIOD_US * 3 / 2) {
+        tick_stats.late_ticks++;
+    }
+    motion_batch_tick(now_us);
+    motion_path_tick(now_us, dt, &finished);
+    motion_spline_tick(now_us, &finished);
+    motion_playout_tick(period_us, &finished);
+    motion_linear_tick(dt, &finished);
+
+    for (int i = 0; i < joint_count; i++) {
+        motion_joint_t* joint = &joints[i];
+
+        if (joint->active) {
+            traj_state_t state;
+            joint->elapsed += dt;
+            traj_sample(&joint->seg, joint->elapsed, &state);
+            joint->position = state.pos;
+            joint->velocity = state.vel;
+            joint->acceleration = state.acc;
+
+            if (joint->elapsed >= joint->seg.duration) {
+                joint->position = joint->target;
+                joint->velocity = 0.0f;
+                joint->acceleration = 0.0f;
+                // A hardware move finishes when the peripheral says so
+                if (!joint->external) {
+                    joint->active = false;
+                    finished |= MOTION_JOINT_BIT(i);
+                }
+            }
+            joint->dirty = !joint->external;
+        } else if (joint->tracking) {
+            // No jog since the deadline: the host is gone, brake
+            if (joint->deadman_us != 0 && now_us >= joint->deadman_us) {
+                motion_jog_brake((servo_id_t)i);
+            }
+            traj_state_t state = {
+                .pos = joint->position,
+                .vel = joint->velocity,
+                .acc = joint->acceleration
+            };
+            // A scheduled start only gets the part of the period after it
+            float step = dt;
+            if (joint->start_us != 0) {
+                step = fminf(dt, (float)(now_us - joint->start_us) / 1000000.0f);
+            }
+            if (step > 0.0f && traj_otg_step(&state, joint->target, &joint->limits, step)) {
+                joint->tracking = false;
+                finished |= MOTION_JOINT_BIT(i);
+            }
+            joint->position = state.pos;
+            joint->velocity = state.vel;
+            joint->acceleration = state.acc;
+            joint->dirty = true;
+        }
+        joint->start_us = 0;
+
+        if (joint->dirty) {
+            outputs[i] = joint->position;
+            write_mask |= MOTION_JOINT_BIT(i);
+            joint->dirty = false;
+        }
+    }
+    // A joint with a batch still to come is not idle yet
+    finished &= ~motion_batch_pending();
+    uint32_t tick = tick_stats.ticks;
+    motion_tick_hook_t hook = tick_hook;
+    void* hook_arg = tick_hook_arg;
+    taskEXIT_CRITICAL(&motion_lock);
+
+    // Stage every duty first, then latch them back to back in the same PWM frame
+    for (int i = 0; i < joint_count; i++) {
+        if (write_mask & MOTION_JOINT_BIT(i)) {
+            servo_output_stage((servo_id_t)i, outputs[i]);
+        }
+    }
+    if (write_mask) {
+        servo_output_commit(write_mask);
+    }
+    if (hook != NULL) {
+        hook(tick, motion_time_us(), hook_arg);
+    }
+
+    if (finished) {
+        xEventGroupSetBits(idle_events, finished);
+    }
+}
+
+static bool motion_is_valid_id(servo_id_t servo_id) {
+    return (servo_id >= 0 && servo_id < joint_count);
+}
+
+static esp_err_t motion_start(servo_id_t servo_id, float target_deg,
+                              const traj_limits_t* limits, traj_profile_t profile,
+                              float* duration_s) {
+    if (!motion_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!motion_is_valid_id(servo_id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    target_deg = servo_clamp_angle(servo_id, target_deg);
+
+    // Clear the idle bit first so a tick finishing in between cannot be lost
+    xEventGroupClearBits(idle_events, MOTION_JOINT_BIT(servo_id));
+
+    // Planned under the lock so the start point is the position the tick left
+    taskENTER_CRITICAL(&motion_lock);
+    motion_joint_t* joint = &joints[servo_id];
+    esp_err_t ret = traj_plan(&joint->seg, joint->position, target_deg, limits, profile)
+                  ? ESP_OK : ESP_ERR_INVALID_ARG;
+    if (ret == ESP_OK) {
+        joint->target = target_deg;
+        joint->elapsed = 0.0f;
+        joint->active = (joint->seg.duration > 0.0f);
+        joint->tracking = false;
+        joint->external = false;
+        // A single-joint command takes the joint out of any coordinated move
+        path.mask &= ~MOTION_JOINT_BIT(servo_id);
+    }
+    bool active = joint->active;
+    float duration = joint->seg.duration;
+    taskEXIT_CRITICAL(&motion_lock);
+
+    if (!active) {
+        xEventGroupSetBits(idle_events, MOTION_JOINT_BIT(servo_id));
+    }
+    if (ret == ESP_OK && duration_s != NULL) {
+        *duration_s = duration;
+    }
+    return ret;
+}
+
+static esp_err_t motion_plan_path_seg(motion_path_seg_t* out, const float start[SERVO_MAX_JOINTS],
+                                      const motion_pose_t* pose) {
+    // The normalised profile is limited by the joint that saturates first
+    traj_limits_t unit = { .max_vel = INFINITY, .max_acc = INFINITY, .max_jerk = INFINITY };
+
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < joint_count; i++) {
+        traj_limits_t limits;
+        servo_get_limits((servo_id_t)i, &limits);
+        if (pose->max_speed > 0.0f && pose->max_speed < limits.max_vel) {
+            limits.max_vel = pose->max_speed;
+        }
+
+        out->delta[i] = servo_clamp_angle((servo_id_t)i, pose->target[i]) - start[i];
+        float d = fabsf(out->delta[i]);
+        if (d > 0.0f) {
+            unit.max_vel = fminf(unit.max_vel, limits.max_vel / d);
+            unit.max_acc = fminf(unit.max_acc, limits.max_acc / d);
+            unit.max_jerk = fminf(unit.max_jerk, limits.max_jerk / d);
+        }
+    }
+    out->blend = pose->blend;
+
+    if (!isfinite(unit.max_vel)) {
+        // Already there, nothing to move
+        return ESP_OK;
+    }
+
+    bool planned = traj_plan(&out->seg, 0.0f, 1.0f, &unit, TRAJ_PROFILE_SCURVE);
+    if (planned && pose->duration > out->seg.duration) {
+        planned = traj_stretch(&out->seg, pose->duration);
+    }
+    return planned ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+// Pop the next queued pose into the active set (caller holds motion_lock).
+// dt is the time the caller still advances the path by in this tick.
+static void motion_path_activate(int64_t now_us, float dt) {
+    while (path.queue_count > 0 && path.active_count < 2) {
+        const motion_pose_t* pose = &path.queue[path.queue_head];
+        motion_path_seg_t* slot = &path.active[path.active_count];
+
+        if (pose->start_us != 0 && (path.active_count > 0 || now_us < pose->start_us)) {
+            // Timed pose: hold until it is due
+            return;
+        }
+        int64_t start_us = pose->start_us;
+
+        if (path.active_count == 0) {
+            // Starting from rest: take over every joint at its current position
+            for (int i = 0; i < joint_count; i++) {
+                path.base[i] = joints[i].position;
+                path.end[i] = joints[i].position;
+                joints[i].active = false;
+                joints[i].tracking = false;
+                joints[i].external = false;
+            }
+            path.mask = joint_mask;
+        }
+
+        esp_err_t ret = motion_plan_path_seg(slot, path.end, pose);
+        path.queue_head = (path.queue_head + 1) % MOTION_QUEUE_LENGTH;
+        path.queue_count--;
+
+        if (ret != ESP_OK || slot->seg.duration <= 0.0f) {
+            // Zero-length or unplannable segment, skip it
+            continue;
+        }
+        if (start_us != 0) {
+            // Sample from start_us, or from now if the previous segment ran late
+            slot->elapsed = fminf(dt, (float)(now_us - start_us) / 1000000.0f) - dt;
+        }
+
+        for (int i = 0; i < joint_count; i++) {
+            path.end[i] += slot->delta[i];
+            if (path.mask & MOTION_JOINT_BIT(i)) {
+                joints[i].target = path.end[i];
+            }
+        }
+        path.active_count++;
+        return;
+    }
+}
+
+// Start the next segment once the current one is decelerating inside its blend radius
+static bool motion_path_can_blend(const motion_path_seg_t* cur) {
+    if (cur->blend <= 0.0f) {
+        return false;
+    }
+
+    float remaining_t = cur->seg.duration - cur->elapsed;
+    float decel_t = cur->seg.t_a / cur->seg.time_scale;
+    if (remaining_t > decel_t) {
+        return false;
+    }
+
+    traj_state_t s;
+    traj_sample(&cur->seg, cur->elapsed, &s);
+    float max_delta = 0.0f;
+    for (int i = 0; i < joint_count; i++) {
+        max_delta = fmaxf(max_delta, fabsf(cur->delta[i]));
+    }
+    return (1.0f - s.pos) * max_delta <= cur->blend;
+}
+
+// Advance the path by dt (caller holds motion_lock)
+static void motion_path_tick(int64_t now_us, float dt, uint32_t* finished) {
+    if (path.active_count == 0) {
+        motion_path_activate(now_us, dt);
+    } else if (path.active_count == 1 && path.queue_count > 0 &&
+               motion_path_can_blend(&path.active[0])) {
+        motion_path_activate(now_us, dt);
+    }
+    if (path.active_count == 0) {
+        return;
+    }
+
+    // Sum the contributions of every active segment on top of base
+    float pos[SERVO_MAX_JOINTS];
+    float vel[SERVO_MAX_JOINTS] = {0};
+    float acc[SERVO_MAX_JOINTS] = {0};
+    memcpy(pos, path.base, sizeof(pos));
+
+    for (int k = 0; k < path.active_count; k++) {
+        motion_path_seg_t* seg = &path.active[k];
+        traj_state_t s;
+        seg->elapsed += dt;
+        traj_sample(&seg->seg, seg->elapsed, &s);
+        for (int i = 0; i < joint_count; i++) {
+            pos[i] += s.pos * seg->delta[i];
+            vel[i] += s.vel * seg->delta[i];
+            acc[i] += s.acc * seg->delta[i];
+        }
+    }
+
+    for (int i = 0; i < joint_count; i++) {
+        if (path.mask & MOTION_JOINT_BIT(i)) {
+            joints[i].position = pos[i];
+            joints[i].velocity = vel[i];
+            joints[i].acceleration = acc[i];
+            joints[i].dirty = true;
+        }
+    }
+
+    // Retire the oldest segment once it has fully played out
+    if (path.active[0].elapsed >= path.active[0].seg.duration) {
+        for (int i = 0; i < joint_count; i++) {
+            path.base[i] += path.active[0].delta[i];
+        }
+        path.active[0] = path.active[1];
+        path.active_count--;
+
+        if (path.active_count == 0) {
+            motion_path_activate(now_us, 0.0f);
+        }
+        if (path.active_count == 0) {
+            for (int i = 0; i < joint_count; i++) {
+                if (path.mask & MOTION_JOINT_BIT(i)) {
+                    joints[i].position = path.end[i];
+                    joints[i].velocity = 0.0f;
+                    joints[i].acceleration = 0.0f;
+                }
+            }
+            // A timed pose still waiting keeps the joints on the path
+            if (path.queue_count == 0) {
+                *finished |= path.mask;
+                path.mask = 0;
+            }
+        }
+    }
+}
+
+// Drop active and queued segments and any spline stream (caller holds motion_lock)
+static void motion_path_clear(void) {
+    path.active_count = 0;
+    path.queue_count = 0;
+    path.mask = 0;
+    spline.playing = false;
+    spline.count = 0;
+    playout.playing = false;
+    playout.count = 0;
+    linear.active = false;
+}
+
+static void motion_joints_to_kin(const float pos[SERVO_MAX_JOINTS], kin_joints_t* kin) {
+    kin->base = pos[SERVO_BASE];
+    kin->shoulder = pos[SERVO_ARM];
+    kin->elbow = pos[SERVO_FOREARM];
+    kin->wrist = pos[SERVO_WRIST];
+}
+
+static void motion_kin_to_joints(const kin_joints_t* kin, float pos[SERVO_MAX_JOINTS]) {
+    pos[SERVO_BASE] = kin->base;
+    pos[SERVO_ARM] = kin->shoulder;
+    pos[SERVO_FOREARM] = kin->elbow;
+    pos[SERVO_WRIST] = kin->wrist;
+}
+
+// Advance the Cartesian move and re-solve IK for the new tip pose (caller holds motion_lock)
+static void motion_linear_tick(float dt, uint32_t* finished) {
+    if (!linear.active) {
+        return;
+    }
+
+    traj_state_t s;
+    linear.elapsed += dt;
+    traj_sample(&linear.seg, linear.elapsed, &s);
+
+    kin_pose_t pose = {
+        .x = linear.start.x + s.pos * linear.delta.x,
+        .y = linear.start.y + s.pos * linear.delta.y,
+        .z = linear.start.z + s.pos * linear.delta.z,
+        .pitch = linear.start.pitch + s.pos * linear.delta.pitch
+    };
+
+    kin_joints_t kin;
+    bool done = (linear.elapsed >= linear.seg.duration);
+    if (kin_inverse(&kin_config, &pose, SERVO_MIN_ANGLE, SERVO_MAX_ANGLE, &kin)) {
+        float pos[SERVO_MAX_JOINTS];
+        motion_kin_to_joints(&kin, pos);
+        for (int i = 0; i < SERVO_KIN_JOINTS; i++) {
+            if (path.mask & MOTION_JOINT_BIT(i)) {
+                joints[i].velocity = done ? 0.0f : (pos[i] - joints[i].position) / dt;
+                joints[i].acceleration = 0.0f;
+                joints[i].position = servo_clamp_angle((servo_id_t)i, pos[i]);
+                joints[i].dirty = true;
+            }
+        }
+    } else {
+        // Line left the workspace, hold the last reachable point
+        for (int i = 0; i < SERVO_KIN_JOINTS; i++) {
+            joints[i].target = joints[i].position;
+            joints[i].velocity = 0.0f;
+            joints[i].acceleration = 0.0f;
+        }
+        done = true;
+    }
+
+    if (done) {
+        linear.active = false;
+        *finished |= path.mask;
+        path.mask = 0;
+    }
+}
+
+static motion_spline_point_t* motion_spline_at(int index) {
+    return &spline.points[(spline.head + index) % MOTION_SPLINE_LENGTH];
+}
+
+// Play the waypoint stream at device time now_us (caller holds motion_lock)
+static void motion_spline_tick(int64_t now_us, uint32_t* finished) {
+    if (!spline.playing) {
+        return;
+    }
+
+    while (spline.count >= 2) {
+        const motion_spline_point_t* p1 = motion_spline_at(0);
+        const motion_spline_point_t* p2 = motion_spline_at(1);
+
+        if (!spline.cubic_valid) {
+            // Catmull-Rom tangent at p2 if the waypoint after it is known,
+            // otherwise come to rest on p2
+            const motion_spline_point_t* p3 = (spline.count >= 3) ? motion_spline_at(2) : NULL;
+            float h = (float)(p2->at_us - p1->at_us) / 1000000.0f;
+            for (int i = 0; i < joint_count; i++) {
+                float m2 = 0.0f;
+                if (p3 != NULL) {
+                    m2 = (p3->pos[i] - p1->pos[i]) * 1000000.0f / (float)(p3->at_us - p1->at_us);
+                }
+                traj_cubic_hermite(&spline.cubic[i], p1->pos[i], p2->pos[i],
+                                   spline.end_slope[i], m2, h);
+                spline.end_slope[i] = m2;
+            }
+            spline.cubic_valid = true;
+        }
+
+        if (now_us < p2->at_us) {
+            break;
+        }
+        spline.head = (spline.head + 1) % MOTION_SPLINE_LENGTH;
+        spline.count--;
+        spline.cubic_valid = false;
+    }
+
+    if (spline.count < 2) {
+        // Holding on the last waypoint
+        const motion_spline_point_t* last = motion_spline_at(0);
+        for (int i = 0; i < joint_count; i++) {
+            if (path.mask & MOTION_JOINT_BIT(i)) {
+                joints[i].position = last->pos[i];
+                joints[i].velocity = 0.0f;
+                joints[i].acceleration = 0.0f;
+                joints[i].dirty = true;
+            }
+            spline.end_slope[i] = 0.0f;
+        }
+        if (spline.ended) {
+            spline.playing = false;
+            *finished |= path.mask;
+            path.mask = 0;
+        }
+        return;
+    }
+
+    float tau = (float)(now_us - motion_spline_at(0)->at_us) / 1000000.0f;
+    for (int i = 0; i < joint_count; i++) {
+        if (path.mask & MOTION_JOINT_BIT(i)) {
+            traj_state_t s;
+            traj_cubic_sample(&spline.cubic[i], tau, &s);
+            joints[i].position = servo_clamp_angle((servo_id_t)i, s.pos);
+            joints[i].velocity = s.vel;
+            joints[i].acceleration = s.acc;
+            joints[i].dirty = true;
+        }
+    }
+}
+
+static motion_spline_point_t* motion_playout_at(int index) {
+    return &playout.points[(playout.head + index) % MOTION_PLAYOUT_LENGTH];
+}
+
+// Advance the setpoint stream by one tick (caller holds motion_lock)
+static void motion_playout_tick(int64_t period_us, uint32_t* finished) {
+    if (!playout.playing) {
+        return;
+    }
+
+    // Run a little fast while the delay is above target, a little slow below it
+    float skew = (playout.delay_est_us - (float)playout.delay_us) / MOTION_PLAYOUT_STEER_US;
+    skew = fminf(fmaxf(skew, -MOTION_PLAYOUT_MAX_SKEW), MOTION_PLAYOUT_MAX_SKEW);
+    playout.play_us += (int64_t)lroundf((float)period_us * (1.0f + skew));
+
+    int64_t newest_us = motion_playout_at(playout.count - 1)->at_us;
+    if (playout.play_us >= newest_us) {
+        playout.play_us = newest_us;
+        if (playout.ended) {
+            playout.playing = false;
+        } else if (!playout.starved) {
+            playout.starved = true;
+            playout.underruns++;
+        }
+    }
+    while (playout.count >= 2 && motion_playout_at(1)->at_us <= playout.play_us) {
+        playout.head = (playout.head + 1) % MOTION_PLAYOUT_LENGTH;
+        playout.count--;
+    }
+
+    const motion_spline_point_t* p1 = motion_playout_at(0);
+    const motion_spline_point_t* p2 = (playout.count >= 2) ? motion_playout_at(1) : NULL;
+    float h = p2 ? (float)(p2->at_us - p1->at_us) / 1000000.0f : 0.0f;
+    float u = p2 ? (float)(playout.play_us - p1->at_us) / 1000000.0f / h : 0.0f;
+    for (int i = 0; i < joint_count; i++) {
+        if (path.mask & MOTION_JOINT_BIT(i)) {
+            float delta = p2 ? p2->pos[i] - p1->pos[i] : 0.0f;
+            joints[i].position = p1->pos[i] + delta * u;
+            joints[i].velocity = p2 ? delta / h : 0.0f;
+            joints[i].acceleration = 0.0f;
+            joints[i].dirty = true;
+        }
+    }
+
+    if (!playout.playing) {
+        *finished |= path.mask;
+        path.mask = 0;
+    }
+}
+
+// Retarget a tracking joint to where it comes to rest (caller holds motion_lock)
+static void motion_jog_brake(servo_id_t servo_id) {
+    motion_joint_t* joint = &joints[servo_id];
+    traj_state_t state = {
+        .pos = joint->position,
+        .vel = joint->velocity,
+        .acc = joint->acceleration
+    };
+    joint->target = servo_clamp_angle(servo_id, traj_stop_position(&state, &joint->limits));
+    joint->deadman_us = 0;
+}
+
+// Retarget every joint of the batch (caller holds motion_lock). start_us is
+// the batch's time within the current tick, 0 to integrate the whole tick.
+static void motion_batch_apply(const motion_batch_t* batch, int64_t start_us) {
+    uint32_t mask = batch->mask & joint_mask;
+    int64_t deadman_us = (start_us != 0 ? start_us : motion_time_us()) + (int64_t)MOTION_JOG_TIMEOUT_MS * 1000;
+    traj_limits_t limits[SERVO_MAX_JOINTS];
+    float target[SERVO_MAX_JOINTS];
+    float dist[SERVO_MAX_JOINTS];
+    // Joints starting from rest share one normalised profile, limited by the
+    // joint that saturates first, the same way a path segment is planned
+    traj_limits_t unit = { .max_vel = INFINITY, .max_acc = INFINITY, .max_jerk = INFINITY };
+
+    for (int i = 0; i < joint_count; i++) {
+        if (!(mask & MOTION_JOINT_BIT(i))) {
+            continue;
+        }
+        const motion_joint_t* joint = &joints[i];
+        float value = batch->value[i];
+        servo_get_limits((servo_id_t)i, &limits[i]);
+        dist[i] = 0.0f;
+
+        if (batch->mode == MOTION_BATCH_VELOCITY) {
+            if (fabsf(value) < limits[i].max_vel) {
+                limits[i].max_vel = fabsf(value);
+            }
+            target[i] = servo_clamp_angle((servo_id_t)i, value > 0.0f ? SERVO_MAX_ANGLE : SERVO_MIN_ANGLE);
+            continue;
+        }
+
+        if (batch->max_speed > 0.0f && batch->max_speed < limits[i].max_vel) {
+            limits[i].max_vel = batch->max_speed;
+        }
+        target[i] = servo_clamp_angle((servo_id_t)i, value);
+        if (joint->velocity == 0.0f && joint->acceleration == 0.0f) {
+            dist[i] = fabsf(target[i] - joint->position);
+        }
+        if (dist[i] > 0.0f) {
+            unit.max_vel = fminf(unit.max_vel, limits[i].max_vel / dist[i]);
+            unit.max_acc = fminf(unit.max_acc, limits[i].max_acc / dist[i]);
+            unit.max_jerk = fminf(unit.max_jerk, limits[i].max_jerk / dist[i]);
+        }
+    }
+
+    for (int i = 0; i < joint_count; i++) {
+        if (!(mask & MOTION_JOINT_BIT(i))) {
+            continue;
+        }
+        motion_joint_t* joint = &joints[i];
+
+        if (dist[i] > 0.0f) {
+            limits[i].max_vel = unit.max_vel * dist[i];
+            limits[i].max_acc = unit.max_acc * dist[i];
+            limits[i].max_jerk = unit.max_jerk * dist[i];
+        }
+        joint->target = target[i];
+        joint->limits = limits[i];
+        joint->start_us = start_us;
+        joint->active = false;
+        joint->tracking = true;
+        joint->external = false;
+        joint->deadman_us = 0;
+        // Velocities are jogs: 0 brakes, anything else arms the deadman
+        if (batch->mode == MOTION_BATCH_VELOCITY) {
+            if (batch->value[i] == 0.0f) {
+                motion_jog_brake((servo_id_t)i);
+            } else {
+                joint->deadman_us = deadman_us;
+            }
+        }
+    }
+    path.mask &= ~mask;
+}
+
+// Apply the batches whose start time has come (caller holds motion_lock)
+static void motion_batch_tick(int64_t now_us) {
+    int due = 0;
+    while (due < batch_count && batches[due].at_us <= now_us) {
+        motion_batch_apply(&batches[due], batches[due].at_us);
+        due++;
+    }
+    if (due > 0) {
+        batch_count -= due;
+        memmove(batches, &batches[due], batch_count * sizeof(batches[0]));
+    }
+}
+
+// Take joints out of the waiting batches (caller holds motion_lock)
+static void motion_batch_drop(uint32_t mask) {
+    int kept = 0;
+    for (int k = 0; k < batch_count; k++) {
+        batches[k].mask &= ~mask;
+        if (batches[k].mask != 0) {
+            batches[kept++] = batches[k];
+        }
+    }
+    batch_count = kept;
+}
+
+static uint32_t motion_batch_pending(void) {
+    uint32_t mask = 0;
+    for (int k = 0; k < batch_count; k++) {
+        mask |= batches[k].mask;
+    }
+    return mask;
+}
@@ -0,0 +1,265 @@
+#ifndef MOTION_ENGINE_H
+#define MOTION_ENGINE_H
+
+#include "esp_err.h"
+#include "stdbool.h"
+#include "freertos/FreeRTOS.h"
+#include "servo_controller.h"
+#include "trajectory.h"
+#include "kinematics.h"
+
+// Control loop period. Every joint is advanced once per tick.
+#define MOTION_TICK_PERIOD_US   (5000)      // 200 Hz
+
+// Default joint speed used when a caller passes speed <= 0
+#define MOTION_DEFAULT_SPEED_DEG_S  (90.0f)
+
+// Deadman timeout of a jog that does not set its own: a camera loop that
+// sends on change plus a keepalive every ~100 ms never lets it expire
+#define MOTION_JOG_TIMEOUT_MS   (250)
+
+// Depth of the joint-space segment queue in front of the path executor, and
+// how far ahead a timed pose may be scheduled
+#define MOTION_QUEUE_LENGTH     (16)
+#define MOTION_POSE_MAX_LEAD_MS     (30000)
+
+// Waypoint stream: ring depth and the playout delay applied to the first
+// waypoint. The delay should cover one waypoint interval plus link latency so
+// the waypoint after the current segment is known before the segment starts.
+#define MOTION_SPLINE_LENGTH    (32)
+#define MOTION_SPLINE_LEAD_MS   (250)
+
+// Dense setpoint stream: ring depth and the playout delay, which adapts to
+// the arrival jitter between MIN and MAX. The playout clock runs up to
+// MAX_SKEW faster or slower than real time to move the delay to its target.
+#define MOTION_PLAYOUT_LENGTH       (96)
+#define MOTION_PLAYOUT_MIN_DELAY_MS     (10)
+#define MOTION_PLAYOUT_START_DELAY_MS   (50)
+#define MOTION_PLAYOUT_MAX_DELAY_MS     (150)
+#define MOTION_PLAYOUT_MAX_SKEW     (0.1f)
+
+// Batches waiting for their start time, and how far ahead one may be scheduled
+#define MOTION_BATCH_LENGTH     (8)
+#define MOTION_BATCH_MAX_LEAD_MS    (2000)
+
+// Cartesian move limits for the tool tip
+#define MOTION_LINEAR_SPEED_MM_S    (60.0f)
+#define MOTION_LINEAR_ACC_MM_S2     (400.0f)
+#define MOTION_LINEAR_JERK_MM_S3    (4000.0f)
+#define MOTION_LINEAR_PITCH_DEG_S   (90.0f)
+
+// Bit mask helpers for motion_wait_idle()
+#define MOTION_JOINT_BIT(id)    (1UL << (id))
+#define MOTION_ALL_JOINTS       ((1UL << SERVO_MAX_JOINTS) - 1)    // Joints outside the table are always idle
+
+// Engine lifecycle (called by servo_init / servo_deinit)
+esp_err_t motion_engine_init(void);
+void motion_engine_deinit(void);
+bool motion_engine_is_running(void);
+
+// Asynchronous commands - all of them return immediately
+esp_err_t motion_set_target(servo_id_t servo_id, float target_deg, float speed_deg_s);
+// Profiled move using the joint limits from servo_get_limits().
+// duration_s (optional) receives the planned move time.
+esp_err_t motion_move_profiled(servo_id_t servo_id, float target_deg,
+                               traj_profile_t profile, float* duration_s);
+// Streaming setpoint. The joint's online jerk-limited generator retargets
+// from its current position, velocity and acceleration; nothing is queued,
+// so a new setpoint every camera frame just replaces the previous one.
+//  max_speed_deg_s > 0 : cap the joint velocity below its limit
+esp_err_t motion_track(servo_id_t servo_id, float target_deg, float max_speed_deg_s);
+esp_err_t motion_nudge(servo_id_t servo_id, float delta_deg, float speed_deg_s);
+esp_err_t motion_jump(servo_id_t servo_id, float angle_deg);
+esp_err_t motion_stop(servo_id_t servo_id);
+// Velocity jog with a deadman. The joint runs towards its soft limit at
+// velocity_deg_s (signed, capped by its limit) until the next jog replaces
+// it; if none comes within timeout_ms it brakes to a stop within its limits.
+// Repeating the same jog is the keepalive. velocity_deg_s = 0 brakes at once.
+//  timeout_ms = 0 : MOTION_JOG_TIMEOUT_MS
+esp_err_t motion_jog(servo_id_t servo_id, float velocity_deg_s, uint32_t timeout_ms);
+
+// Coordinated joint-space moves. All joints start and arrive together and
+// their duties are latched in the same PWM frame.
+//  duration_s > 0      : stretch the move to this duration (never faster than the limits allow)
+//  max_speed_deg_s > 0 : additionally cap every joint's velocity
+//  planned_s           : optional, receives the actual move duration
+esp_err_t motion_move_joints(const float targets[SERVO_MAX_JOINTS], float duration_s,
+                             float max_speed_deg_s, float* planned_s);
+esp_err_t motion_jump_all(const float angles[SERVO_MAX_JOINTS]);
+
+// Queued joint-space pose. Consecutive poses with blend > 0 are joined
+// without stopping: the next segment starts once the current one is
+// decelerating and within blend degrees of its end. A timed pose is never
+// blended into: the arm holds the previous pose until start_us and the
+// segment is sampled from that exact microsecond, not from the tick that
+// happens to start it. If the previous segment runs past start_us, it
+// starts as soon as that one ends.
+typedef struct {
+    float target[SERVO_MAX_JOINTS];  // Joint targets (degrees)
+    float max_speed;            // Joint speed cap (deg/s), 0 = joint limits
+    float duration;             // Minimum segment time (s), 0 = as fast as allowed
+    float blend;                // Corner blend radius (degrees), 0 = exact stop
+    int64_t start_us;           // Device time (esp_timer) to start at, 0 = when reached
+} motion_pose_t;
+
+// Append a pose to the segment queue. ESP_ERR_NO_MEM when the queue is full,
+// ESP_ERR_INVALID_ARG for a start more than MOTION_POSE_MAX_LEAD_MS ahead.
+esp_err_t motion_queue_pose(const motion_pose_t* pose);
+int motion_queue_space(void);
+void motion_queue_flush(void);
+void motion_stop_all(void);
+
+// Timestamped waypoint for the spline stream. t_ms is the sender's stream
+// time and must increase from one waypoint to the next.
+typedef struct {
+    uint32_t t_ms;
+    float pos[SERVO_MAX_JOINTS];     // Joint positions (degrees)
+} motion_waypoint_t;
+
+// Sparse waypoints are interpolated on board with a Catmull-Rom spline at
+// the control rate. The first waypoint plays MOTION_SPLINE_LEAD_MS after it
+// arrives, starting from the current pose; later ones keep the sender's
+// spacing. When the stream runs dry the arm stops on the last waypoint and
+// the next one is re-anchored to its arrival time.
+esp_err_t motion_spline_push(const motion_waypoint_t* waypoint);
+// No more waypoints: stop on the last one and report idle
+void motion_spline_end(void);
+int motion_spline_space(void);
+
+// Dense setpoint stream (100-500 Hz) from a host-side planner, played out
+// like an audio jitter buffer: setpoints are interpolated at the control
+// rate a little behind the newest one. That delay covers the worst recent
+// arrival lateness, so it grows as soon as setpoints bunch up and shrinks
+// again a few seconds after the link calms down. When the buffer runs dry
+// the arm holds the last setpoint (an underrun) and plays on from there once
+// the next one arrives, so a late setpoint is never skipped, only delayed.
+// Takes over every joint like the spline stream, and glides from the
+// current pose to the first setpoint over MOTION_PLAYOUT_START_DELAY_MS.
+typedef struct {
+    uint32_t t_us;              // Sender stream time, increasing (wraps)
+    float pos[SERVO_MAX_JOINTS];     // Joint positions (degrees)
+} motion_setpoint_t;
+
+// ESP_ERR_NO_MEM when the buffer is full (an overrun), ESP_ERR_INVALID_ARG
+// for a setpoint that is not after the previous one.
+esp_err_t motion_playout_push(const motion_setpoint_t* setpoint);
+// No more setpoints: stop on the last one and report idle
+void motion_playout_end(void);
+int motion_playout_space(void);
+
+typedef struct {
+    int depth;                  // Setpoints buffered
+    uint32_t delay_us;          // Playout delay being steered to
+    uint32_t jitter_us;         // Worst recent arrival lateness
+    uint32_t underruns;         // Times the buffer ran dry
+    uint32_t overruns;          // Setpoints refused with the buffer full
+} motion_playout_stats_t;
+
+void motion_get_playout_stats(motion_playout_stats_t* stats);
+
+// Setpoints for any subset of joints, applied in a single control tick so
+// every joint in the batch reacts in the same PWM frame.
+//  MOTION_BATCH_TARGET   : value[] are targets (degrees). Each joint retargets
+//                          its online generator as with motion_track(); the
+//                          limits are scaled per joint so that joints starting
+//                          from rest arrive together.
+//  MOTION_BATCH_VELOCITY : value[] are velocities (deg/s) towards the soft
+//                          limit as with motion_jog() and its default
+//                          deadman; 0 brakes the joint within its limits.
+typedef enum {
+    MOTION_BATCH_TARGET = 0,
+    MOTION_BATCH_VELOCITY
+} motion_batch_mode_t;
+
+typedef struct {
+    motion_batch_mode_t mode;
+    uint32_t mask;              // Joints in the batch
+    float value[SERVO_MAX_JOINTS];   // Indexed by joint, ignored outside mask
+    float max_speed;            // Target speed cap (deg/s), 0 = joint limits
+    int64_t at_us;              // Device time (esp_timer) to apply at, <= now = next tick
+} motion_batch_t;
+
+// ESP_ERR_NO_MEM when MOTION_BATCH_LENGTH batches are already waiting,
+// ESP_ERR_INVALID_ARG for an empty mask or a start more than
+// MOTION_BATCH_MAX_LEAD_MS ahead. Batches due in the same tick are applied
+// in start time order, so a later one overrides an earlier one. A waiting
+// batch is integrated from at_us rather than from the previous tick, so the
+// joints move as if the control loop had ticked exactly at at_us.
+esp_err_t motion_batch(const motion_batch_t* batch);
+// Free slots for batches waiting on their start time
+int motion_batch_space(void);
+
+// Arm geometry used by the Cartesian functions
+esp_err_t motion_set_kinematics(const kin_config_t* cfg);
+void motion_get_kinematics(kin_config_t* cfg);
+// Tool pose for the current commanded joint positions
+void motion_get_pose(kin_pose_t* pose);
+
+// Straight-line tool move. IK is re-solved every tick so the tip follows the
+// line; ESP_ERR_INVALID_ARG if the target is out of reach. If the line leaves
+// the workspace part way, the arm stops at the last reachable point. Drives
+// the first SERVO_KIN_JOINTS joints only (ESP_ERR_NOT_SUPPORTED with fewer).
+//  speed_mm_s <= 0 : MOTION_LINEAR_SPEED_MM_S
+esp_err_t motion_move_linear(const kin_pose_t* target, float speed_mm_s, float* planned_s);
+
+// Hardware-timed moves (LEDC fade). The engine mirrors the expected position
+// for queries but never writes the output until the move is finished with
+// motion_external_done_from_isr() or another command takes the joint over.
+esp_err_t motion_external_begin(servo_id_t servo_id, float target_deg, float duration_s);
+// ISR safe, returns true if a higher priority task was woken
+bool motion_external_done_from_isr(servo_id_t servo_id);
+bool motion_is_external(servo_id_t servo_id);
+
+// State queries
+bool motion_is_busy(servo_id_t servo_id);
+float motion_get_position(servo_id_t servo_id);
+float motion_get_target(servo_id_t servo_id);
+float motion_get_remaining_time(servo_id_t servo_id);
+
+// Every joint as of the last control tick, read in one critical section.
+// Hobby servos give no position feedback, so position is what the outputs
+// were last driven to.
+typedef struct {
+    int64_t time_us;            // Time of the last control tick
+    float target[SERVO_MAX_JOINTS];     // Final position of the current move (degrees)
+    float position[SERVO_MAX_JOINTS];   // Output position (degrees)
+    float velocity[SERVO_MAX_JOINTS];   // Degrees/s
+    uint32_t busy_mask;
+    int queue_depth;            // Poses waiting in the segment queue
+    int spline_depth;           // Buffered spline waypoints
+} motion_snapshot_t;
+
+void motion_get_snapshot(motion_snapshot_t* snapshot);
+
+// Control loop timing, measured between consecutive ticks
+typedef struct {
+    uint32_t ticks;
+    uint32_t late_ticks;        // Period over 1.5 ticks, i.e. a tick was skipped
+    uint32_t last_jitter_us;    // |period - MOTION_TICK_PERIOD_US| of the last tick
+    uint32_t max_jitter_us;     // Worst since the last reset
+} motion_tick_stats_t;
+
+void motion_get_tick_stats(motion_tick_stats_t* stats);
+void motion_reset_tick_stats(void);
+
+// Called at the end of every control tick, once its outputs are committed.
+// tick is the tick's number (motion_tick_stats_t.ticks): a command that
+// returned while ticks was N is first on the outputs in tick N + 1. Runs in
+// the esp_timer task, so it must not block.
+typedef void (*motion_tick_hook_t)(uint32_t tick, int64_t commit_us, void* arg);
+void motion_set_tick_hook(motion_tick_hook_t hook, void* arg);
+
+// Block the calling task until every joint in joint_bits is idle
+esp_err_t motion_wait_idle(uint32_t joint_bits, TickType_t timeout);
+
+// Simulated clock for host tests, set before servo_init(). The engine then
+// starts no esp_timer: time stands still until motion_sim_advance() moves it
+// on, running every control tick that falls due on the way in the caller's
+// task. Ticks land exactly on the MOTION_TICK_PERIOD_US grid from 0, so a
+// test gets the same trace on every run.
+esp_err_t motion_set_sim_clock(bool enable);
+void motion_sim_advance(uint32_t duration_us);
+// Device time the engine works in: esp_timer_get_time(), or the simulated clock
+int64_t motion_time_us(void);
+
+#endif // MOTION_ENGINE_H
@@ -0,0 +1,280 @@
+// Generated by tools/protocol/gen_protocol.py from protocol_v2.json.
+// Do not edit; change the schema and regenerate.
+#ifndef PROTOCOL_V2_H
+#define PROTOCOL_V2_H
+
+#include <stdint.h>
+
+// Frame: sync, version, length, type, seq, payload[length], crc16 (LE).
+// The CRC is CRC-16/CCITT-FALSE over version..payload. Multi-byte
+// fields are little endian. Every host command is answered with an ack
+// carrying its seq, except a query or calibration, whose reply repeats
+// the command's seq (a refused one is still acked with its status).
+// Legacy gesture bytes (0x00-0x3F) may appear between frames until the
+// first good frame; after it the device drops them.
+// The link starts at 115200 baud. A link request is acked at the old
+// rate, then the device switches; the first good frame at the new rate
+// must arrive within 500 ms, otherwise the device returns to 115200.
+// Every host command starts with host_us, which its ack echoes.
+// Flow control is by credit: the host keeps at most info rx_window bytes
+// sent beyond the last acked frame, and sends queued motion only while
+// the newest ack's free counts, less what it sent since, allow.
+#define PROTO_SYNC          (0xA5)
+#define PROTO_VERSION       (2)
+#define PROTO_HEADER_SIZE   (5)
+#define PROTO_CRC_SIZE      (2)
+#define PROTO_MAX_PAYLOAD   (240)
+#define PROTO_MAX_FRAME     (PROTO_HEADER_SIZE + PROTO_MAX_PAYLOAD + PROTO_CRC_SIZE)
+
+// Ack status
+typedef enum {
+    PROTO_STATUS_OK = 0,
+    PROTO_STATUS_BAD_LENGTH = 1,      // Payload size does not match the type
+    PROTO_STATUS_UNKNOWN_TYPE = 2,
+    PROTO_STATUS_INVALID_ARG = 3,     // Joint or value out of range
+    PROTO_STATUS_BUSY = 4,            // Queue full, resend later
+    PROTO_STATUS_REJECTED = 5,        // Valid but refused in the current state
+} proto_status_t;
+
+// What a query asks for
+typedef enum {
+    PROTO_QUERY_INFO = 0,     // Answered with an info message
+    PROTO_QUERY_STATE = 1,    // Answered with a state message
+    PROTO_QUERY_CLOCK = 2,    // Answered with a clock message
+} proto_query_t;
+
+// Pose, segment, batch and setpoint flags
+typedef enum {
+    PROTO_FLAG_QUEUE = 1,       // pose: append to the segment queue instead of moving now
+    PROTO_FLAG_END = 2,         // segment, setpoint: last one of the stream
+    PROTO_FLAG_VELOCITY = 4,    // batch: values are velocities (mdeg/s) instead of targets
+    PROTO_FLAG_TIMED = 8,       // batch, pose: apply at exec_us instead of on receipt
+} proto_flag_t;
+
+// Calibration flags; with neither, the command only reads the joint's calibration
+typedef enum {
+    PROTO_CALIB_SET = 1,     // Apply the calibration fields to the joint
+    PROTO_CALIB_SAVE = 2,    // Persist every joint's calibration to NVS
+} proto_calib_t;
+
+typedef enum {
+    PROTO_MSG_JOINT_TARGET = 0x01,         // Absolute target for one joint
+    PROTO_MSG_JOG = 0x02,                  // Run one joint at a signed velocity until the deadman timeout, 0 brakes
+    PROTO_MSG_POSE = 0x03,                 // Coordinated move of the first count joints
+    PROTO_MSG_SEGMENT = 0x04,              // Timestamped spline waypoint
+    PROTO_MSG_STOP = 0x05,                 // Stop the joints in the mask and flush queued motion
+    PROTO_MSG_QUERY = 0x06,                // Request an info or state reply
+    PROTO_MSG_LINK = 0x08,                 // Switch the link to another baud rate
+    PROTO_MSG_TELEMETRY_RATE = 0x09,       // Start, retime or stop the telemetry stream
+    PROTO_MSG_BATCH = 0x07,                // Targets or velocities for the joints in the mask, applied in one control tick
+    PROTO_MSG_SETPOINT = 0x0A,             // Dense stream setpoint, played out through the jitter buffer
+    PROTO_MSG_CALIBRATION = 0x0B,          // Set, save or read one joint's calibration, answered with a calibration_reply
+    PROTO_MSG_ACK = 0x80,                  // Device reply to every command
+    PROTO_MSG_INFO = 0x81,                 // Device capabilities
+    PROTO_MSG_STATE = 0x82,                // Commanded joint positions
+    PROTO_MSG_TELEMETRY = 0x83,            // Periodic joint state, sent unprompted at the telemetry rate
+    PROTO_MSG_CLOCK = 0x84,                // Clock sync sample: host_us to rx_us and tx_us back is one NTP exchange
+    PROTO_MSG_CALIBRATION_REPLY = 0x85,    // Calibration of one joint as in effect after a calibration command
+} proto_msg_type_t;
+
+// Absolute target for one joint
+typedef struct __attribute__((packed)) {
+    uint32_t host_us;         // Host time (us, wrapping), echoed in the ack
+    uint8_t joint;
+    int32_t target_mdeg;
+    uint32_t speed_mdeg_s;    // 0 = default joint speed
+} proto_msg_joint_target_t;
+#define PROTO_JOINT_TARGET_SIZE (13)
+_Static_assert(sizeof(proto_msg_joint_target_t) == 13, "proto_msg_joint_target_t layout");
+
+// Run one joint at a signed velocity until the deadman timeout, 0 brakes
+typedef struct __attribute__((packed)) {
+    uint32_t host_us;           // Host time (us, wrapping), echoed in the ack
+    uint8_t joint;
+    int32_t velocity_mdeg_s;
+    uint16_t timeout_ms;        // Deadman timeout, 0 = device default
+} proto_msg_jog_t;
+#define PROTO_JOG_SIZE (11)
+_Static_assert(sizeof(proto_msg_jog_t) == 11, "proto_msg_jog_t layout");
+
+// Coordinated move of the first count joints
+typedef struct __attribute__((packed)) {
+    uint32_t host_us;            // Host time (us, wrapping), echoed in the ack
+    uint8_t flags;
+    uint16_t duration_ms;        // Minimum move time, 0 = as fast as allowed
+    uint16_t max_speed_deg_s;    // Joint speed cap, 0 = joint limits
+    uint16_t blend_mdeg;         // Corner blend for queued poses
+    uint32_t exec_us;            // Device time (low 32 bits) to start at, with the timed flag; implies queue
+    uint8_t count;               // Joints past count hold their target; queued and timed poses need every joint
+    int32_t target_mdeg[];
+} proto_msg_pose_t;
+#define PROTO_POSE_SIZE(count) (16 + 4 * (count))
+_Static_assert(sizeof(proto_msg_pose_t) == 16, "proto_msg_pose_t layout");
+
+// Timestamped spline waypoint
+typedef struct __attribute__((packed)) {
+    uint32_t host_us;      // Host time (us, wrapping), echoed in the ack
+    uint8_t flags;
+    uint32_t t_ms;         // Sender stream time, increasing
+    uint8_t count;         // Every joint
+    int32_t pos_mdeg[];
+} proto_msg_segment_t;
+#define PROTO_SEGMENT_SIZE(count) (10 + 4 * (count))
+_Static_assert(sizeof(proto_msg_segment_t) == 10, "proto_msg_segment_t layout");
+
+// Stop the joints in the mask and flush queued motion
+typedef struct __attribute__((packed)) {
+    uint32_t host_us;       // Host time (us, wrapping), echoed in the ack
+    uint16_t joint_mask;
+} proto_msg_stop_t;
+#define PROTO_STOP_SIZE (6)
+_Static_assert(sizeof(proto_msg_stop_t) == 6, "proto_msg_stop_t layout");
+
+// Request an info or state reply
+typedef struct __attribute__((packed)) {
+    uint32_t host_us;    // Host time (us, wrapping), echoed in the ack
+    uint8_t what;
+} proto_msg_query_t;
+#define PROTO_QUERY_SIZE (5)
+_Static_assert(sizeof(proto_msg_query_t) == 5, "proto_msg_query_t layout");
+
+// Switch the link to another baud rate
+typedef struct __attribute__((packed)) {
+    uint32_t host_us;    // Host time (us, wrapping), echoed in the ack
+    uint32_t baud;       // Base rate up to the info max_baud
+} proto_msg_link_t;
+#define PROTO_LINK_SIZE (8)
+_Static_assert(sizeof(proto_msg_link_t) == 8, "proto_msg_link_t layout");
+
+// Start, retime or stop the telemetry stream
+typedef struct __attribute__((packed)) {
+    uint32_t host_us;    // Host time (us, wrapping), echoed in the ack
+    uint16_t rate_hz;    // 0 stops the stream, up to the control rate (200)
+} proto_msg_telemetry_rate_t;
+#define PROTO_TELEMETRY_RATE_SIZE (6)
+_Static_assert(sizeof(proto_msg_telemetry_rate_t) == 6, "proto_msg_telemetry_rate_t layout");
+
+// Targets or velocities for the joints in the mask, applied in one control tick
+typedef struct __attribute__((packed)) {
+    uint32_t host_us;            // Host time (us, wrapping), echoed in the ack
+    uint8_t flags;
+    uint16_t joint_mask;
+    uint16_t max_speed_deg_s;    // Target speed cap, 0 = joint limits
+    uint32_t exec_us;            // Device time (low 32 bits) to apply at, with the timed flag
+    uint8_t count;               // Joints in the mask
+    int32_t value[];             // One per mask bit, lowest joint first
+} proto_msg_batch_t;
+#define PROTO_BATCH_SIZE(count) (14 + 4 * (count))
+_Static_assert(sizeof(proto_msg_batch_t) == 14, "proto_msg_batch_t layout");
+
+// Dense stream setpoint, played out through the jitter buffer
+typedef struct __attribute__((packed)) {
+    uint32_t host_us;      // Host time (us, wrapping), echoed in the ack
+    uint8_t flags;
+    uint32_t t_us;         // Sender stream time (wrapping), increasing
+    uint8_t count;         // Every joint
+    int32_t pos_mdeg[];
+} proto_msg_setpoint_t;
+#define PROTO_SETPOINT_SIZE(count) (10 + 4 * (count))
+_Static_assert(sizeof(proto_msg_setpoint_t) == 10, "proto_msg_setpoint_t layout");
+
+// Set, save or read one joint's calibration, answered with a calibration_reply
+typedef struct __attribute__((packed)) {
+    uint32_t host_us;         // Host time (us, wrapping), echoed in the ack
+    uint8_t flags;
+    uint8_t joint;
+    uint16_t min_pulse_us;    // Pulse width at 0 degrees
+    uint16_t max_pulse_us;    // Pulse width at the top of the range
+    int32_t offset_mdeg;      // Centre trim added to the commanded angle
+    uint8_t inverted;         // 1 = mirror the direction of rotation
+    int32_t soft_min_mdeg;    // Commands are clamped to the soft limits
+    int32_t soft_max_mdeg;
+} proto_msg_calibration_t;
+#define PROTO_CALIBRATION_SIZE (23)
+_Static_assert(sizeof(proto_msg_calibration_t) == 23, "proto_msg_calibration_t layout");
+
+// Device reply to every command
+typedef struct __attribute__((packed)) {
+    uint8_t cmd_seq;         // Sequence number of the command
+    uint8_t status;
+    uint32_t host_us;        // Stamp of the command
+    uint32_t rx_us;          // Device time the command reached the receive ring
+    uint32_t parse_us;       // Device time the command was parsed
+    uint32_t pwm_us;         // Device time of the first PWM update after it, 0 if none or queued, timed or buffered
+    uint8_t queue_free;      // Free slots once the command was handled: pose queue
+    uint8_t spline_free;     // Spline waypoints
+    uint8_t playout_free;    // Jitter buffer setpoints
+    uint8_t batch_free;      // Timed batches
+} proto_msg_ack_t;
+#define PROTO_ACK_SIZE (22)
+_Static_assert(sizeof(proto_msg_ack_t) == 22, "proto_msg_ack_t layout");
+
+// Device capabilities
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t joint_count;
+    uint8_t max_payload;
+    uint8_t queue_length;
+    uint8_t spline_length;
+    uint8_t playout_length;
+    uint8_t batch_length;      // Timed batches that may wait at once
+    uint16_t rx_window;        // Bytes the host may have in flight beyond its last acked frame
+    uint32_t max_baud;         // Highest rate a link request may ask for
+} proto_msg_info_t;
+#define PROTO_INFO_SIZE (13)
+_Static_assert(sizeof(proto_msg_info_t) == 13, "proto_msg_info_t layout");
+
+// Commanded joint positions
+typedef struct __attribute__((packed)) {
+    uint16_t busy_mask;
+    uint32_t time_us;           // Device time (low 32 bits), the clock of batch exec_us
+    uint8_t count;
+    int32_t position_mdeg[];
+} proto_msg_state_t;
+#define PROTO_STATE_SIZE(count) (7 + 4 * (count))
+_Static_assert(sizeof(proto_msg_state_t) == 7, "proto_msg_state_t layout");
+
+// Periodic joint state, sent unprompted at the telemetry rate
+typedef struct __attribute__((packed)) {
+    uint32_t time_us;            // Device time (low 32 bits) of the control tick sampled
+    uint16_t busy_mask;
+    uint8_t queue_depth;         // Poses waiting in the segment queue
+    uint8_t spline_depth;        // Buffered spline waypoints
+    uint16_t jitter_max_us;      // Worst control-tick jitter since the previous frame
+    uint16_t late_ticks;         // Skipped control ticks, wrapping count
+    uint16_t crc_errors;         // Link error counts, wrapping
+    uint16_t overflows;
+    uint16_t line_errors;
+    uint8_t playout_depth;       // Setpoints in the jitter buffer
+    uint8_t playout_delay_ms;    // Playout delay the buffer is steering to
+    uint16_t underruns;          // Jitter buffer ran dry, wrapping
+    uint16_t overruns;           // Setpoints refused by a full jitter buffer, wrapping
+    uint8_t count;               // Three values per joint
+    int32_t joint[];             // Per joint: target mdeg, output mdeg, velocity mdeg/s
+} proto_msg_telemetry_t;
+#define PROTO_TELEMETRY_SIZE(count) (25 + 4 * (count))
+_Static_assert(sizeof(proto_msg_telemetry_t) == 25, "proto_msg_telemetry_t layout");
+
+// Clock sync sample: host_us to rx_us and tx_us back is one NTP exchange
+typedef struct __attribute__((packed)) {
+    uint32_t host_us;    // Stamp of the query
+    uint32_t rx_us;      // Device time the query reached the receive ring
+    uint32_t tx_us;      // Device time just before this reply was written
+} proto_msg_clock_t;
+#define PROTO_CLOCK_SIZE (12)
+_Static_assert(sizeof(proto_msg_clock_t) == 12, "proto_msg_clock_t layout");
+
+// Calibration of one joint as in effect after a calibration command
+typedef struct __attribute__((packed)) {
+    uint8_t joint;
+    uint16_t min_pulse_us;
+    uint16_t max_pulse_us;
+    int32_t offset_mdeg;
+    uint8_t inverted;
+    int32_t soft_min_mdeg;
+    int32_t soft_max_mdeg;
+} proto_msg_calibration_reply_t;
+#define PROTO_CALIBRATION_REPLY_SIZE (18)
+_Static_assert(sizeof(proto_msg_calibration_reply_t) == 18, "proto_msg_calibration_reply_t layout");
+
+#endif // PROTOCOL_V2_H
@@ -0,0 +1,111 @@
+#ifndef SERVO_BACKEND_H
+#define SERVO_BACKEND_H
+
+#include "esp_err.h"
+#include "stdbool.h"
+#include "stdint.h"
+#include "stdio.h"
+
+// PWM output driver behind the servo API. The servo controller turns angles
+// into duty counts with the calibration map; a backend only moves counts to
+// pins. Outputs are numbered 0..count-1 in joint order.
+
+// One output as requested by the servo controller
+typedef struct {
+    int pin;                    // GPIO, or channel number on an expander
+    uint32_t frequency_hz;
+} servo_output_config_t;
+
+// Called by the backend when a hardware fade ends, possibly from an ISR.
+// Returns true if a higher priority task was woken.
+typedef bool (*servo_fade_done_t)(int output);
+
+typedef struct {
+    const char* name;
+
+    // Configure the outputs (duty 0, no pulse) and report in period_ticks[]
+    // the duty counts in one nominal frame (1 / frequency_hz) of each one
+    esp_err_t (*init)(const servo_output_config_t* outputs, int count,
+                      uint32_t* period_ticks, servo_fade_done_t fade_done);
+    void (*deinit)(void);
+
+    // Load a new pulse (start and width in counts); not visible until commit
+    esp_err_t (*stage)(int output, uint32_t duty, uint32_t hpoint);
+    // Latch every staged output in output_mask on the same PWM frame
+    esp_err_t (*commit)(uint32_t output_mask);
+
+    // Optional hardware linear ramp to duty, NULL when not supported
+    esp_err_t (*fade_start)(int output, uint32_t duty, uint32_t duration_ms);
+    esp_err_t (*fade_stop)(int output);
+} servo_backend_t;
+
+extern const servo_backend_t servo_backend_ledc;
+extern const servo_backend_t servo_backend_mcpwm;
+extern const servo_backend_t servo_backend_mock;
+extern const servo_backend_t servo_backend_pca9685;
+
+// PCA9685 backend: 16 channels on one I2C chip, all at the same frame rate.
+// Joint pins are channel numbers. Every commit is a single auto-increment
+// burst from the lowest to the highest changed channel, and the chip latches
+// all of them on the I2C STOP, so one transaction per control tick updates
+// every joint. Put the joints on adjacent channels to keep bursts short.
+#define SERVO_PCA9685_CHANNELS      (16)
+#define SERVO_PCA9685_MAX_BURST     (1 + 4 * SERVO_PCA9685_CHANNELS)   // Register + 4 bytes per channel
+#define SERVO_PCA9685_BUDGET_US     (2500)      // Half a control tick
+
+typedef struct {
+    int i2c_port;
+    int sda_pin;
+    int scl_pin;
+    uint8_t address;            // 7-bit, 0x40 with A0-A5 low
+    uint32_t bus_hz;
+    uint32_t osc_hz;            // Internal oscillator, trim per board for exact pulse widths
+} servo_pca9685_config_t;
+
+#define DEFAULT_SERVO_PCA9685_CONFIG() { \
+    .i2c_port = 0, \
+    .sda_pin = 21, \
+    .scl_pin = 22, \
+    .address = 0x40, \
+    .bus_hz = 400000, \
+    .osc_hz = 25000000 \
+}
+
+// I2C traffic counters, updated on every commit
+typedef struct {
+    uint32_t commits;           // Transactions sent
+    uint32_t bytes;             // Payload bytes sent, register pointer included
+    uint32_t max_burst;         // Largest single transaction (bytes)
+    int64_t last_us;            // Bus time of the last transaction
+    int64_t max_us;             // Worst bus time seen
+    uint32_t errors;
+} servo_pca9685_stats_t;
+
+// Set before servo_init() when the defaults do not match the board
+esp_err_t servo_pca9685_configure(const servo_pca9685_config_t* config);
+void servo_pca9685_get_stats(servo_pca9685_stats_t* stats);
+void servo_pca9685_reset_stats(void);
+
+// Mock backend: every committed output is recorded with its commit time
+#define SERVO_MOCK_LOG_LENGTH       (1024)
+#define SERVO_MOCK_PERIOD_TICKS     (1UL << 16)
+
+typedef struct {
+    int64_t time_us;
+    uint8_t output;
+    uint32_t duty;
+    uint32_t hpoint;
+} servo_mock_write_t;
+
+// Drain up to max recorded writes, oldest first. Returns the number copied.
+int servo_mock_read(servo_mock_write_t* writes, int max);
+// Writes lost because the log was full
+uint32_t servo_mock_dropped(void);
+// Time source for the records, NULL for esp_timer_get_time(). Host tests pass
+// motion_time_us so every write carries the simulated time of its tick.
+typedef int64_t (*servo_mock_clock_t)(void);
+void servo_mock_set_clock(servo_mock_clock_t clock);
+// Also append every write to file as "time_us,output,duty,hpoint" (NULL to stop)
+void servo_mock_set_trace(FILE* file);
+
+#endif // SERVO_BACKEND_H
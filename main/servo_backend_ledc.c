@@ -0,0 +1,300 @@
+#include "servo_backend.h"
+#include "driver/ledc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "soc/soc_caps.h"
+#include "freertos/FreeRTOS.h"
+
+static const char* TAG = "SERVO_LEDC";
+
+#define LEDC_BACKEND_MAX_OUTPUTS    (8)
+#define LEDC_BACKEND_CLK_HZ         (80000000)  // APB clock feeding the LEDC timers
+
+// Timer clock divider, fixed point with 8 fractional bits. The duty resolution
+// may be up to LEDC_BACKEND_EXACT_BITS_COST bits narrower than the widest one
+// if its divider gives a frame closer to 1/frequency_hz.
+#define LEDC_BACKEND_DIV_FRAC_BITS  (8)
+#define LEDC_BACKEND_DIV_MIN        (1UL << LEDC_BACKEND_DIV_FRAC_BITS)
+#define LEDC_BACKEND_DIV_MAX        ((1UL << 18) - 1)
+#define LEDC_BACKEND_EXACT_BITS_COST    (4)
+// Frame phase unit: one divider step of the timer clock, 1/20480 us
+#define LEDC_BACKEND_UNITS_PER_US   ((LEDC_BACKEND_CLK_HZ / 1000000) << LEDC_BACKEND_DIV_FRAC_BITS)
+
+// Outputs with the same frame rate share one timer so their frames line up.
+// Duty writes only latch on a timer overflow, so a commit is kept out of the
+// last LEDC_FRAME_GUARD_US of the frame; otherwise one output could land a
+// frame later than the others.
+#define LEDC_FRAME_GUARD_US         (200)
+
+// One LEDC timer per distinct frame rate
+typedef struct {
+    uint32_t frequency_hz;
+    ledc_timer_bit_t bits;      // Duty resolution
+    uint32_t divider;           // Clock divider programmed, 1/256 steps
+    int64_t t0_us;              // esp_timer time of the last counter reset
+} ledc_backend_timer_t;
+
+static ledc_backend_timer_t ledc_timers[LEDC_TIMER_MAX];
+static int ledc_timer_count = 0;
+static ledc_timer_t ledc_output_timer[LEDC_BACKEND_MAX_OUTPUTS];
+static int ledc_output_count = 0;
+static servo_fade_done_t ledc_fade_done = NULL;
+static bool ledc_fade_installed = false;
+static portMUX_TYPE ledc_commit_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Private function prototypes
+static esp_err_t ledc_backend_init(const servo_output_config_t* outputs, int count,
+                                   uint32_t* period_ticks, servo_fade_done_t fade_done);
+static void ledc_backend_deinit(void);
+static esp_err_t ledc_backend_stage(int output, uint32_t duty, uint32_t hpoint);
+static esp_err_t ledc_backend_commit(uint32_t output_mask);
+static esp_err_t ledc_backend_fade_start(int output, uint32_t duty, uint32_t duration_ms);
+static esp_err_t ledc_backend_fade_stop(int output);
+static esp_err_t ledc_backend_timer_for(uint32_t frequency_hz, ledc_timer_t* timer);
+static ledc_timer_bit_t ledc_backend_resolution(uint32_t frequency_hz, uint32_t* divider);
+static void ledc_backend_wait_frame_window(uint32_t output_mask);
+static bool ledc_backend_fade_isr(const ledc_cb_param_t* param, void* user_arg);
+
+const servo_backend_t servo_backend_ledc = {
+    .name = "ledc",
+    .init = ledc_backend_init,
+    .deinit = ledc_backend_deinit,
+    .stage = ledc_backend_stage,
+    .commit = ledc_backend_commit,
+    .fade_start = ledc_backend_fade_start,
+    .fade_stop = ledc_backend_fade_stop
+};
+
+// Private function implementations
+static esp_err_t ledc_backend_init(const servo_output_config_t* outputs, int count,
+                                   uint32_t* period_ticks, servo_fade_done_t fade_done) {
+    if (count > LEDC_BACKEND_MAX_OUTPUTS) {
+        ESP_LOGE(TAG, "%d outputs requested, %d LEDC channels available",
+                 count, LEDC_BACKEND_MAX_OUTPUTS);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    ledc_timer_count = 0;
+    ledc_output_count = 0;
+    ledc_fade_done = fade_done;
+
+    for (int i = 0; i < count; i++) {
+        esp_err_t ret = ledc_backend_timer_for(outputs[i].frequency_hz, &ledc_output_timer[i]);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        ledc_channel_config_t ledc_channel = {
+            .gpio_num       = outputs[i].pin,
+            .speed_mode     = LEDC_LOW_SPEED_MODE,
+            .channel        = i,
+            .timer_sel      = ledc_output_timer[i],
+            .duty           = 0,
+            .hpoint         = 0
+        };
+        ret = ledc_channel_config(&ledc_channel);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to configure LEDC channel %d: %s", i, esp_err_to_name(ret));
+            return ret;
+        }
+
+        period_ticks[i] = 1UL << ledc_timers[ledc_output_timer[i]].bits;
+        ledc_output_count++;
+    }
+
+    esp_err_t ret = ledc_fade_func_install(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install LEDC fade: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ledc_fade_installed = true;
+
+    ledc_cbs_t callbacks = {
+        .fade_cb = ledc_backend_fade_isr
+    };
+    for (int i = 0; i < count; i++) {
+        ret = ledc_cb_register(LEDC_LOW_SPEED_MODE, i, &callbacks, (void*)(intptr_t)i);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to register fade callback for channel %d: %s",
+                     i, esp_err_to_name(ret));
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+static void ledc_backend_deinit(void) {
+    for (int i = 0; i < ledc_output_count; i++) {
+        ledc_stop(LEDC_LOW_SPEED_MODE, i, 0);
+    }
+    if (ledc_fade_installed) {
+        ledc_fade_func_uninstall();
+        ledc_fade_installed = false;
+    }
+    ledc_output_count = 0;
+    ledc_timer_count = 0;
+}
+
+static esp_err_t ledc_backend_stage(int output, uint32_t duty, uint32_t hpoint) {
+    return ledc_set_duty_with_hpoint(LEDC_LOW_SPEED_MODE, output, duty, hpoint);
+}
+
+static esp_err_t ledc_backend_commit(uint32_t output_mask) {
+    esp_err_t result = ESP_OK;
+
+    // Every channel in the mask latches on the same timer overflow
+    ledc_backend_wait_frame_window(output_mask);
+    taskENTER_CRITICAL(&ledc_commit_lock);
+    for (int i = 0; i < ledc_output_count; i++) {
+        if (output_mask & (1UL << i)) {
+            esp_err_t ret = ledc_update_duty(LEDC_LOW_SPEED_MODE, i);
+            if (ret != ESP_OK) {
+                result = ret;
+            }
+        }
+    }
+    taskEXIT_CRITICAL(&ledc_commit_lock);
+    return result;
+}
+
+static esp_err_t ledc_backend_fade_start(int output, uint32_t duty, uint32_t duration_ms) {
+    esp_err_t ret = ledc_set_fade_with_time(LEDC_LOW_SPEED_MODE, output, duty, (int)duration_ms);
+    if (ret == ESP_OK) {
+        ret = ledc_fade_start(LEDC_LOW_SPEED_MODE, output, LEDC_FADE_NO_WAIT);
+    }
+    return ret;
+}
+
+static esp_err_t ledc_backend_fade_stop(int output) {
+    return ledc_fade_stop(LEDC_LOW_SPEED_MODE, output);
+}
+
+static esp_err_t ledc_backend_timer_for(uint32_t frequency_hz, ledc_timer_t* timer) {
+    for (int t = 0; t < ledc_timer_count; t++) {
+        if (ledc_timers[t].frequency_hz == frequency_hz) {
+            *timer = (ledc_timer_t)t;
+            return ESP_OK;
+        }
+    }
+
+    if (ledc_timer_count >= LEDC_TIMER_MAX) {
+        ESP_LOGE(TAG, "Too many distinct frame rates, %d LEDC timers available", LEDC_TIMER_MAX);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    int t = ledc_timer_count;
+    uint32_t divider;
+    ledc_timer_bit_t bits = ledc_backend_resolution(frequency_hz, &divider);
+    ledc_timer_config_t ledc_timer = {
+        .speed_mode       = LEDC_LOW_SPEED_MODE,
+        .timer_num        = (ledc_timer_t)t,
+        .duty_resolution  = bits,
+        .freq_hz          = frequency_hz,
+        .clk_cfg          = LEDC_USE_APB_CLK
+    };
+    esp_err_t ret = ledc_timer_config(&ledc_timer);
+    if (ret == ESP_OK) {
+        // The driver rounds its own divider; program the one the phase model uses
+        ret = ledc_timer_set(LEDC_LOW_SPEED_MODE, (ledc_timer_t)t, divider, bits, LEDC_APB_CLK);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure LEDC timer %d (%lu Hz): %s",
+                 t, (unsigned long)frequency_hz, esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Restart the counter so the frame phase is known from esp_timer. Both
+    // clocks come from the same crystal and the frame length is taken from
+    // the divider actually programmed, so the phase does not drift.
+    taskENTER_CRITICAL(&ledc_commit_lock);
+    ret = ledc_timer_rst(LEDC_LOW_SPEED_MODE, (ledc_timer_t)t);
+    ledc_timers[t].t0_us = esp_timer_get_time();
+    taskEXIT_CRITICAL(&ledc_commit_lock);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ledc_timers[t].frequency_hz = frequency_hz;
+    ledc_timers[t].bits = bits;
+    ledc_timers[t].divider = divider;
+    ledc_timer_count++;
+    ESP_LOGI(TAG, "LEDC timer %d: %lu Hz, %d-bit duty, frame %lu us", t, (unsigned long)frequency_hz,
+             (int)bits, (unsigned long)(((uint64_t)divider << bits) / LEDC_BACKEND_UNITS_PER_US));
+
+    *timer = (ledc_timer_t)t;
+    return ESP_OK;
+}
+
+// Widest duty counter the timer clock allows at this frame rate, or a few
+// bits narrower if that brings the frame closer to 1/frequency_hz. Most
+// servo rates have an exact divider; the rest (333 Hz) run a hair off
+// nominal, with the frame length still known from the divider.
+static ledc_timer_bit_t ledc_backend_resolution(uint32_t frequency_hz, uint32_t* divider) {
+    uint64_t clk = (uint64_t)LEDC_BACKEND_CLK_HZ << LEDC_BACKEND_DIV_FRAC_BITS;
+    int widest = 0;
+    int best = 0;
+    uint64_t best_error = UINT64_MAX;
+
+    for (int bits = SOC_LEDC_TIMER_BIT_WIDTH; bits > 0; bits--) {
+        uint64_t counts = (uint64_t)frequency_hz << bits;
+        uint64_t div = (clk + counts / 2) / counts;
+        if (div < LEDC_BACKEND_DIV_MIN || div > LEDC_BACKEND_DIV_MAX) {
+            continue;
+        }
+        if (widest == 0) {
+            widest = bits;
+        } else if (bits < widest - LEDC_BACKEND_EXACT_BITS_COST) {
+            break;
+        }
+        // Distance from the nominal frame, in timer clock units
+        uint64_t error = div * counts > clk ? div * counts - clk : clk - div * counts;
+        if (error < best_error) {
+            best = bits;
+            best_error = error;
+            *divider = (uint32_t)div;
+        }
+    }
+    return (ledc_timer_bit_t)best;
+}
+
+// Busy-wait until no timer driving a channel in output_mask is about to
+// overflow. Frames of different rates are independent, so re-check them all
+// after each wait; the loop is bounded by the number of timers.
+static void ledc_backend_wait_frame_window(uint32_t output_mask) {
+    uint32_t timer_mask = 0;
+    for (int i = 0; i < ledc_output_count; i++) {
+        if (output_mask & (1UL << i)) {
+            timer_mask |= 1UL << ledc_output_timer[i];
+        }
+    }
+
+    for (int attempt = 0; attempt <= ledc_timer_count; attempt++) {
+        bool waited = false;
+        int64_t now = esp_timer_get_time();
+        for (int t = 0; t < ledc_timer_count; t++) {
+            if (!(timer_mask & (1UL << t))) {
+                continue;
+            }
+            // In timer clock units the frame length is exact
+            int64_t period = (int64_t)ledc_timers[t].divider << ledc_timers[t].bits;
+            int64_t elapsed = (now - ledc_timers[t].t0_us) * LEDC_BACKEND_UNITS_PER_US;
+            int64_t to_boundary = (period - elapsed % period) / LEDC_BACKEND_UNITS_PER_US;
+            if (to_boundary < LEDC_FRAME_GUARD_US) {
+                esp_rom_delay_us((uint32_t)to_boundary + 10);
+                waited = true;
+                break;
+            }
+        }
+        if (!waited) {
+            return;
+        }
+    }
+}
+
+static bool ledc_backend_fade_isr(const ledc_cb_param_t* param, void* user_arg) {
+    if (param->event != LEDC_FADE_END_EVT || ledc_fade_done == NULL) {
+        return false;
+    }
+    return ledc_fade_done((int)(intptr_t)user_arg);
+}
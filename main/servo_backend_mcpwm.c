@@ -0,0 +1,217 @@
+#include "servo_backend.h"
+#include "driver/mcpwm_prelude.h"
+#include "esp_log.h"
+#include "soc/soc_caps.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+static const char* TAG = "SERVO_MCPWM";
+
+// Each output gets its own timer, operator and generator; the ESP32 has
+// SOC_MCPWM_GROUPS groups of SOC_MCPWM_TIMERS_PER_GROUP.
+#define MCPWM_BACKEND_MAX_OUTPUTS   (SOC_MCPWM_GROUPS * SOC_MCPWM_TIMERS_PER_GROUP)
+#define MCPWM_BACKEND_RESOLUTION_HZ (2000000)   // 0.5 us per count, 40000 counts at 50 Hz
+#define MCPWM_BACKEND_MAX_PERIOD    (65535)     // 16-bit counter
+
+// Pulse = high on compare A (hpoint), low on compare B (hpoint + duty).
+// Compare values are shadowed and load on the timer zero event, so the two
+// edges of a pulse always change on the same frame.
+typedef struct {
+    mcpwm_timer_handle_t timer;
+    mcpwm_oper_handle_t oper;
+    mcpwm_cmpr_handle_t start;
+    mcpwm_cmpr_handle_t end;
+    mcpwm_gen_handle_t gen;
+    uint32_t duty;              // Staged values, written to the comparators on commit
+    uint32_t hpoint;
+    bool forced_low;            // Output held low while duty is 0
+} mcpwm_backend_output_t;
+
+static mcpwm_backend_output_t mcpwm_outputs[MCPWM_BACKEND_MAX_OUTPUTS];
+static int mcpwm_output_count = 0;
+static portMUX_TYPE mcpwm_commit_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Private function prototypes
+static esp_err_t mcpwm_backend_init(const servo_output_config_t* outputs, int count,
+                                    uint32_t* period_ticks, servo_fade_done_t fade_done);
+static void mcpwm_backend_deinit(void);
+static esp_err_t mcpwm_backend_stage(int output, uint32_t duty, uint32_t hpoint);
+static esp_err_t mcpwm_backend_commit(uint32_t output_mask);
+static esp_err_t mcpwm_backend_new_output(int output, const servo_output_config_t* config,
+                                          uint32_t period_ticks);
+
+const servo_backend_t servo_backend_mcpwm = {
+    .name = "mcpwm",
+    .init = mcpwm_backend_init,
+    .deinit = mcpwm_backend_deinit,
+    .stage = mcpwm_backend_stage,
+    .commit = mcpwm_backend_commit,
+    .fade_start = NULL,         // No hardware ramp; the control tick interpolates
+    .fade_stop = NULL
+};
+
+// Private function implementations
+static esp_err_t mcpwm_backend_init(const servo_output_config_t* outputs, int count,
+                                    uint32_t* period_ticks, servo_fade_done_t fade_done) {
+    (void)fade_done;
+
+    if (count > MCPWM_BACKEND_MAX_OUTPUTS) {
+        ESP_LOGE(TAG, "%d outputs requested, %d MCPWM timers available",
+                 count, MCPWM_BACKEND_MAX_OUTPUTS);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    mcpwm_output_count = 0;
+    for (int i = 0; i < count; i++) {
+        uint32_t period = MCPWM_BACKEND_RESOLUTION_HZ / outputs[i].frequency_hz;
+        if (period > MCPWM_BACKEND_MAX_PERIOD) {
+            ESP_LOGE(TAG, "Frame rate %lu Hz too low for the MCPWM counter",
+                     (unsigned long)outputs[i].frequency_hz);
+            mcpwm_backend_deinit();
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+
+        esp_err_t ret = mcpwm_backend_new_output(i, &outputs[i], period);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to configure MCPWM output %d: %s", i, esp_err_to_name(ret));
+            mcpwm_backend_deinit();
+            return ret;
+        }
+        period_ticks[i] = period;
+    }
+
+    // Start the counters back to back so outputs sharing a frame rate stay in step
+    for (int i = 0; i < mcpwm_output_count; i++) {
+        esp_err_t ret = mcpwm_timer_start_stop(mcpwm_outputs[i].timer, MCPWM_TIMER_START_NO_STOP);
+        if (ret != ESP_OK) {
+            mcpwm_backend_deinit();
+            return ret;
+        }
+    }
+    ESP_LOGI(TAG, "%d MCPWM outputs at %lu Hz counter resolution",
+             mcpwm_output_count, (unsigned long)MCPWM_BACKEND_RESOLUTION_HZ);
+    return ESP_OK;
+}
+
+static void mcpwm_backend_deinit(void) {
+    for (int i = 0; i < mcpwm_output_count; i++) {
+        mcpwm_backend_output_t* out = &mcpwm_outputs[i];
+        mcpwm_timer_start_stop(out->timer, MCPWM_TIMER_STOP_EMPTY);
+        mcpwm_timer_disable(out->timer);
+        mcpwm_del_generator(out->gen);
+        mcpwm_del_comparator(out->end);
+        mcpwm_del_comparator(out->start);
+        mcpwm_del_operator(out->oper);
+        mcpwm_del_timer(out->timer);
+    }
+    mcpwm_output_count = 0;
+}
+
+static esp_err_t mcpwm_backend_stage(int output, uint32_t duty, uint32_t hpoint) {
+    if (output < 0 || output >= mcpwm_output_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    taskENTER_CRITICAL(&mcpwm_commit_lock);
+    mcpwm_outputs[output].duty = duty;
+    mcpwm_outputs[output].hpoint = hpoint;
+    taskEXIT_CRITICAL(&mcpwm_commit_lock);
+    return ESP_OK;
+}
+
+static esp_err_t mcpwm_backend_commit(uint32_t output_mask) {
+    esp_err_t result = ESP_OK;
+
+    taskENTER_CRITICAL(&mcpwm_commit_lock);
+    for (int i = 0; i < mcpwm_output_count; i++) {
+        if (!(output_mask & (1UL << i))) {
+            continue;
+        }
+        mcpwm_backend_output_t* out = &mcpwm_outputs[i];
+        if (out->duty == 0) {
+            // Both edges on one count would race, hold the pin low instead
+            if (!out->forced_low) {
+                mcpwm_generator_set_force_level(out->gen, 0, true);
+                out->forced_low = true;
+            }
+            continue;
+        }
+        esp_err_t ret = mcpwm_comparator_set_compare_value(out->start, out->hpoint);
+        if (ret == ESP_OK) {
+            ret = mcpwm_comparator_set_compare_value(out->end, out->hpoint + out->duty);
+        }
+        if (ret == ESP_OK && out->forced_low) {
+            ret = mcpwm_generator_set_force_level(out->gen, -1, true);
+            out->forced_low = false;
+        }
+        if (ret != ESP_OK) {
+            result = ret;
+        }
+    }
+    taskEXIT_CRITICAL(&mcpwm_commit_lock);
+    return result;
+}
+
+static esp_err_t mcpwm_backend_new_output(int output, const servo_output_config_t* config,
+                                          uint32_t period_ticks) {
+    mcpwm_backend_output_t* out = &mcpwm_outputs[output];
+    int group = output / SOC_MCPWM_TIMERS_PER_GROUP;
+    memset(out, 0, sizeof(*out));
+
+    mcpwm_timer_config_t timer_config = {
+        .group_id = group,
+        .clk_src = MCPWM_TIMER_CLK_SRC_DEFAULT,
+        .resolution_hz = MCPWM_BACKEND_RESOLUTION_HZ,
+        .period_ticks = period_ticks,
+        .count_mode = MCPWM_TIMER_COUNT_MODE_UP
+    };
+    esp_err_t ret = mcpwm_new_timer(&timer_config, &out->timer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    mcpwm_operator_config_t operator_config = {
+        .group_id = group
+    };
+    ret = mcpwm_new_operator(&operator_config, &out->oper);
+    if (ret == ESP_OK) {
+        ret = mcpwm_operator_connect_timer(out->oper, out->timer);
+    }
+
+    mcpwm_comparator_config_t comparator_config = {
+        .flags.update_cmp_on_tez = true
+    };
+    if (ret == ESP_OK) {
+        ret = mcpwm_new_comparator(out->oper, &comparator_config, &out->start);
+    }
+    if (ret == ESP_OK) {
+        ret = mcpwm_new_comparator(out->oper, &comparator_config, &out->end);
+    }
+
+    mcpwm_generator_config_t generator_config = {
+        .gen_gpio_num = config->pin
+    };
+    if (ret == ESP_OK) {
+        ret = mcpwm_new_generator(out->oper, &generator_config, &out->gen);
+    }
+    if (ret == ESP_OK) {
+        ret = mcpwm_generator_set_action_on_compare_event(out->gen,
+                MCPWM_GEN_COMPARE_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, out->start, MCPWM_GEN_ACTION_HIGH));
+    }
+    if (ret == ESP_OK) {
+        ret = mcpwm_generator_set_action_on_compare_event(out->gen,
+                MCPWM_GEN_COMPARE_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, out->end, MCPWM_GEN_ACTION_LOW));
+    }
+
+    // No pulse until the first commit
+    if (ret == ESP_OK) {
+        ret = mcpwm_generator_set_force_level(out->gen, 0, true);
+        out->forced_low = true;
+    }
+    if (ret == ESP_OK) {
+        ret = mcpwm_timer_enable(out->timer);
+    }
+
+    // Count the output even when half built so deinit releases what exists
+    mcpwm_output_count = output + 1;
+    return ret;
+}
@@ -0,0 +1,132 @@
+#include "servo_backend.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+// Host/test backend: no hardware, every committed output is appended to a
+// ring buffer (and optionally a CSV file) with the time of the commit, from
+// esp_timer or the clock a test installs. Builds for the ESP-IDF linux target.
+
+#define MOCK_MAX_OUTPUTS    (32)
+
+typedef struct {
+    uint32_t duty;
+    uint32_t hpoint;
+} mock_output_t;
+
+static mock_output_t mock_staged[MOCK_MAX_OUTPUTS];
+static int mock_output_count = 0;
+
+static servo_mock_write_t mock_log[SERVO_MOCK_LOG_LENGTH];
+static int mock_log_head = 0;          // Oldest entry
+static int mock_log_count = 0;
+static uint32_t mock_dropped = 0;
+static FILE* mock_trace = NULL;
+static servo_mock_clock_t mock_clock = esp_timer_get_time;
+static portMUX_TYPE mock_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Private function prototypes
+static esp_err_t mock_backend_init(const servo_output_config_t* outputs, int count,
+                                   uint32_t* period_ticks, servo_fade_done_t fade_done);
+static void mock_backend_deinit(void);
+static esp_err_t mock_backend_stage(int output, uint32_t duty, uint32_t hpoint);
+static esp_err_t mock_backend_commit(uint32_t output_mask);
+
+const servo_backend_t servo_backend_mock = {
+    .name = "mock",
+    .init = mock_backend_init,
+    .deinit = mock_backend_deinit,
+    .stage = mock_backend_stage,
+    .commit = mock_backend_commit,
+    .fade_start = NULL,
+    .fade_stop = NULL
+};
+
+int servo_mock_read(servo_mock_write_t* writes, int max) {
+    int copied = 0;
+
+    taskENTER_CRITICAL(&mock_lock);
+    while (copied < max && mock_log_count > 0) {
+        writes[copied++] = mock_log[mock_log_head];
+        mock_log_head = (mock_log_head + 1) % SERVO_MOCK_LOG_LENGTH;
+        mock_log_count--;
+    }
+    taskEXIT_CRITICAL(&mock_lock);
+    return copied;
+}
+
+uint32_t servo_mock_dropped(void) {
+    return mock_dropped;
+}
+
+void servo_mock_set_clock(servo_mock_clock_t clock) {
+    mock_clock = (clock != NULL) ? clock : esp_timer_get_time;
+}
+
+void servo_mock_set_trace(FILE* file) {
+    mock_trace = file;
+    if (file != NULL) {
+        fprintf(file, "time_us,output,duty,hpoint\n");
+    }
+}
+
+// Private function implementations
+static esp_err_t mock_backend_init(const servo_output_config_t* outputs, int count,
+                                   uint32_t* period_ticks, servo_fade_done_t fade_done) {
+    (void)outputs;
+    (void)fade_done;
+
+    if (count > MOCK_MAX_OUTPUTS) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    for (int i = 0; i < count; i++) {
+        mock_staged[i].duty = 0;
+        mock_staged[i].hpoint = 0;
+        period_ticks[i] = SERVO_MOCK_PERIOD_TICKS;
+    }
+    mock_output_count = count;
+    return ESP_OK;
+}
+
+static void mock_backend_deinit(void) {
+    mock_output_count = 0;
+}
+
+static esp_err_t mock_backend_stage(int output, uint32_t duty, uint32_t hpoint) {
+    if (output < 0 || output >= mock_output_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mock_staged[output].duty = duty;
+    mock_staged[output].hpoint = hpoint;
+    return ESP_OK;
+}
+
+static esp_err_t mock_backend_commit(uint32_t output_mask) {
+    int64_t now = mock_clock();
+
+    for (int i = 0; i < mock_output_count; i++) {
+        if (!(output_mask & (1UL << i))) {
+            continue;
+        }
+        servo_mock_write_t write = {
+            .time_us = now,
+            .output = (uint8_t)i,
+            .duty = mock_staged[i].duty,
+            .hpoint = mock_staged[i].hpoint
+        };
+
+        taskENTER_CRITICAL(&mock_lock);
+        if (mock_log_count < SERVO_MOCK_LOG_LENGTH) {
+            mock_log[(mock_log_head + mock_log_count) % SERVO_MOCK_LOG_LENGTH] = write;
+            mock_log_count++;
+        } else {
+            mock_dropped++;
+        }
+        taskEXIT_CRITICAL(&mock_lock);
+
+        if (mock_trace != NULL) {
+            fprintf(mock_trace, "%lld,%u,%lu,%lu\n", (long long)write.time_us, write.output,
+                    (unsigned long)write.duty, (unsigned long)write.hpoint);
+        }
+    }
+    return ESP_OK;
+}
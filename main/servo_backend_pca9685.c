@@ -0,0 +1,300 @@
+#include "servo_backend.h"
+#include "driver/i2c_master.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include <math.h>
+#include <string.h>
+
+static const char* TAG = "SERVO_PCA9685";
+
+// Registers
+#define PCA9685_MODE1               (0x00)
+#define PCA9685_MODE2               (0x01)
+#define PCA9685_LED0_ON_L           (0x06)
+#define PCA9685_ALL_LED_ON_L        (0xFA)
+#define PCA9685_PRE_SCALE           (0xFE)
+
+#define PCA9685_MODE1_AI            (0x20)  // Register auto-increment
+#define PCA9685_MODE1_SLEEP         (0x10)
+#define PCA9685_MODE2_OUTDRV        (0x04)  // Totem pole; OCH = 0 latches outputs on STOP
+#define PCA9685_FULL_OFF            (0x10)  // Bit 4 of LEDn_OFF_H
+
+#define PCA9685_COUNTS              (4096)
+#define PCA9685_PRESCALE_MIN        (3)
+#define PCA9685_PRESCALE_MAX        (255)
+#define PCA9685_OSC_START_US        (500)
+#define PCA9685_TIMEOUT_MS          (10)
+
+// LEDn_ON_L, LEDn_ON_H, LEDn_OFF_L, LEDn_OFF_H
+typedef uint8_t pca9685_regs_t[4];
+
+static servo_pca9685_config_t pca9685_config = DEFAULT_SERVO_PCA9685_CONFIG();
+static i2c_master_bus_handle_t pca9685_bus = NULL;
+static i2c_master_dev_handle_t pca9685_dev = NULL;
+static uint8_t pca9685_channel[SERVO_PCA9685_CHANNELS];    // Output -> channel
+static int pca9685_output_count = 0;
+
+// Staged and last committed register values per channel. Channels inside a
+// burst that are not being committed are re-sent with their live values.
+static pca9685_regs_t pca9685_staged[SERVO_PCA9685_CHANNELS];
+static pca9685_regs_t pca9685_live[SERVO_PCA9685_CHANNELS];
+static servo_pca9685_stats_t pca9685_stats;
+static portMUX_TYPE pca9685_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Private function prototypes
+static esp_err_t pca9685_backend_init(const servo_output_config_t* outputs, int count,
+                                      uint32_t* period_ticks, servo_fade_done_t fade_done);
+static void pca9685_backend_deinit(void);
+static esp_err_t pca9685_backend_stage(int output, uint32_t duty, uint32_t hpoint);
+static esp_err_t pca9685_backend_commit(uint32_t output_mask);
+static esp_err_t pca9685_write_reg(uint8_t reg, uint8_t value);
+static esp_err_t pca9685_configure_chip(uint32_t frequency_hz, uint32_t* prescale);
+
+const servo_backend_t servo_backend_pca9685 = {
+    .name = "pca9685",
+    .init = pca9685_backend_init,
+    .deinit = pca9685_backend_deinit,
+    .stage = pca9685_backend_stage,
+    .commit = pca9685_backend_commit,
+    .fade_start = NULL,
+    .fade_stop = NULL
+};
+
+esp_err_t servo_pca9685_configure(const servo_pca9685_config_t* config) {
+    if (config == NULL || config->bus_hz == 0 || config->osc_hz == 0 || config->address > 0x7F) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pca9685_dev != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pca9685_config = *config;
+    return ESP_OK;
+}
+
+void servo_pca9685_get_stats(servo_pca9685_stats_t* stats) {
+    taskENTER_CRITICAL(&pca9685_lock);
+    *stats = pca9685_stats;
+    taskEXIT_CRITICAL(&pca9685_lock);
+}
+
+void servo_pca9685_reset_stats(void) {
+    taskENTER_CRITICAL(&pca9685_lock);
+    memset(&pca9685_stats, 0, sizeof(pca9685_stats));
+    taskEXIT_CRITICAL(&pca9685_lock);
+}
+
+// Private function implementations
+static esp_err_t pca9685_backend_init(const servo_output_config_t* outputs, int count,
+                                      uint32_t* period_ticks, servo_fade_done_t fade_done) {
+    (void)fade_done;
+
+    if (count <= 0 || count > SERVO_PCA9685_CHANNELS) {
+        ESP_LOGE(TAG, "%d outputs requested, %d channels available", count, SERVO_PCA9685_CHANNELS);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // One prescaler drives every channel
+    uint16_t used = 0;
+    for (int i = 0; i < count; i++) {
+        if (outputs[i].pin < 0 || outputs[i].pin >= SERVO_PCA9685_CHANNELS ||
+            (used & (1U << outputs[i].pin))) {
+            ESP_LOGE(TAG, "Output %d: invalid or duplicate channel %d", i, outputs[i].pin);
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (outputs[i].frequency_hz != outputs[0].frequency_hz) {
+            ESP_LOGE(TAG, "All channels share one frame rate (%lu Hz requested, output %d wants %lu Hz)",
+                     (unsigned long)outputs[0].frequency_hz, i, (unsigned long)outputs[i].frequency_hz);
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        used |= 1U << outputs[i].pin;
+        pca9685_channel[i] = (uint8_t)outputs[i].pin;
+    }
+
+    i2c_master_bus_config_t bus_config = {
+        .i2c_port = pca9685_config.i2c_port,
+        .sda_io_num = pca9685_config.sda_pin,
+        .scl_io_num = pca9685_config.scl_pin,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true
+    };
+    esp_err_t ret = i2c_new_master_bus(&bus_config, &pca9685_bus);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create I2C bus: %s", esp_err_to_name(ret));
+        goto cleanup;
+    }
+
+    i2c_device_config_t dev_config = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = pca9685_config.address,
+        .scl_speed_hz = pca9685_config.bus_hz
+    };
+    ret = i2c_master_bus_add_device(pca9685_bus, &dev_config, &pca9685_dev);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add PCA9685 at 0x%02x: %s", pca9685_config.address, esp_err_to_name(ret));
+        goto cleanup;
+    }
+
+    uint32_t prescale = 0;
+    ret = pca9685_configure_chip(outputs[0].frequency_hz, &prescale);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "PCA9685 at 0x%02x not responding: %s", pca9685_config.address, esp_err_to_name(ret));
+        goto cleanup;
+    }
+
+    // The prescaler rounds the frame rate, so report the counts that fit in
+    // the nominal frame; the duty map then produces exact pulse widths
+    for (int i = 0; i < count; i++) {
+        period_ticks[i] = (uint32_t)lroundf((float)pca9685_config.osc_hz /
+                                            ((float)(prescale + 1) * outputs[i].frequency_hz));
+        memset(pca9685_staged[pca9685_channel[i]], 0, sizeof(pca9685_regs_t));
+        pca9685_staged[pca9685_channel[i]][3] = PCA9685_FULL_OFF;
+        memcpy(pca9685_live[pca9685_channel[i]], pca9685_staged[pca9685_channel[i]], sizeof(pca9685_regs_t));
+    }
+    pca9685_output_count = count;
+    servo_pca9685_reset_stats();
+
+    // Worst case: every channel in one burst, 9 clocks per byte plus the address
+    uint32_t worst_us = (uint32_t)((SERVO_PCA9685_MAX_BURST + 1) * 9 * 1000000ULL / pca9685_config.bus_hz);
+    if (worst_us > SERVO_PCA9685_BUDGET_US) {
+        ESP_LOGW(TAG, "Worst-case burst takes %lu us on the bus, above the %d us budget",
+                 (unsigned long)worst_us, SERVO_PCA9685_BUDGET_US);
+    }
+    ESP_LOGI(TAG, "PCA9685 at 0x%02x: %d channels, prescale %lu, worst-case burst %lu us",
+             pca9685_config.address, count, (unsigned long)prescale, (unsigned long)worst_us);
+    return ESP_OK;
+
+cleanup:
+    pca9685_backend_deinit();
+    return ret;
+}
+
+static void pca9685_backend_deinit(void) {
+    if (pca9685_dev != NULL) {
+        // Drop every pulse and put the oscillator to sleep
+        uint8_t all_off[5] = { PCA9685_ALL_LED_ON_L, 0, 0, 0, PCA9685_FULL_OFF };
+        i2c_master_transmit(pca9685_dev, all_off, sizeof(all_off), PCA9685_TIMEOUT_MS);
+        pca9685_write_reg(PCA9685_MODE1, PCA9685_MODE1_AI | PCA9685_MODE1_SLEEP);
+        i2c_master_bus_rm_device(pca9685_dev);
+        pca9685_dev = NULL;
+    }
+    if (pca9685_bus != NULL) {
+        i2c_del_master_bus(pca9685_bus);
+        pca9685_bus = NULL;
+    }
+    pca9685_output_count = 0;
+}
+
+static esp_err_t pca9685_backend_stage(int output, uint32_t duty, uint32_t hpoint) {
+    if (output < 0 || output >= pca9685_output_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Pulse from ON to OFF; OFF may wrap past the end of the frame
+    uint32_t on = hpoint % PCA9685_COUNTS;
+    uint32_t off = (hpoint + duty) % PCA9685_COUNTS;
+    pca9685_regs_t regs = {
+        (uint8_t)(on & 0xFF), (uint8_t)(on >> 8),
+        (uint8_t)(off & 0xFF), (uint8_t)((off >> 8) | (duty == 0 ? PCA9685_FULL_OFF : 0))
+    };
+
+    taskENTER_CRITICAL(&pca9685_lock);
+    memcpy(pca9685_staged[pca9685_channel[output]], regs, sizeof(regs));
+    taskEXIT_CRITICAL(&pca9685_lock);
+    return ESP_OK;
+}
+
+static esp_err_t pca9685_backend_commit(uint32_t output_mask) {
+    uint8_t burst[SERVO_PCA9685_MAX_BURST];
+    uint16_t commit_channels = 0;
+    int lo = SERVO_PCA9685_CHANNELS;
+    int hi = -1;
+
+    taskENTER_CRITICAL(&pca9685_lock);
+    for (int i = 0; i < pca9685_output_count; i++) {
+        int ch = pca9685_channel[i];
+        if ((output_mask & (1UL << i)) && memcmp(pca9685_staged[ch], pca9685_live[ch], sizeof(pca9685_regs_t)) != 0) {
+            commit_channels |= 1U << ch;
+            lo = (ch < lo) ? ch : lo;
+            hi = (ch > hi) ? ch : hi;
+        }
+    }
+    if (hi < 0) {
+        // Nothing changed, keep the bus idle
+        taskEXIT_CRITICAL(&pca9685_lock);
+        return ESP_OK;
+    }
+
+    // One contiguous burst from the lowest to the highest changed channel
+    int length = 1;
+    burst[0] = PCA9685_LED0_ON_L + 4 * lo;
+    for (int ch = lo; ch <= hi; ch++) {
+        const uint8_t* regs = (commit_channels & (1U << ch)) ? pca9685_staged[ch] : pca9685_live[ch];
+        memcpy(&burst[length], regs, sizeof(pca9685_regs_t));
+        length += sizeof(pca9685_regs_t);
+    }
+    taskEXIT_CRITICAL(&pca9685_lock);
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = i2c_master_transmit(pca9685_dev, burst, length, PCA9685_TIMEOUT_MS);
+    int64_t bus_us = esp_timer_get_time() - start_us;
+
+    taskENTER_CRITICAL(&pca9685_lock);
+    if (ret == ESP_OK) {
+        for (int ch = lo; ch <= hi; ch++) {
+            if (commit_channels & (1U << ch)) {
+                memcpy(pca9685_live[ch], &burst[1 + 4 * (ch - lo)], sizeof(pca9685_regs_t));
+            }
+        }
+        pca9685_stats.commits++;
+        pca9685_stats.bytes += length;
+        if ((uint32_t)length > pca9685_stats.max_burst) {
+            pca9685_stats.max_burst = length;
+        }
+        pca9685_stats.last_us = bus_us;
+        if (bus_us > pca9685_stats.max_us) {
+            pca9685_stats.max_us = bus_us;
+        }
+    } else {
+        pca9685_stats.errors++;
+    }
+    taskEXIT_CRITICAL(&pca9685_lock);
+    return ret;
+}
+
+static esp_err_t pca9685_write_reg(uint8_t reg, uint8_t value) {
+    uint8_t data[2] = { reg, value };
+    return i2c_master_transmit(pca9685_dev, data, sizeof(data), PCA9685_TIMEOUT_MS);
+}
+
+static esp_err_t pca9685_configure_chip(uint32_t frequency_hz, uint32_t* prescale) {
+    // prescale = osc / (4096 * f) - 1, only writable while asleep
+    long value = lroundf((float)pca9685_config.osc_hz / (PCA9685_COUNTS * (float)frequency_hz)) - 1;
+    if (value < PCA9685_PRESCALE_MIN || value > PCA9685_PRESCALE_MAX) {
+        ESP_LOGE(TAG, "Frame rate %lu Hz out of range", (unsigned long)frequency_hz);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = pca9685_write_reg(PCA9685_MODE1, PCA9685_MODE1_AI | PCA9685_MODE1_SLEEP);
+    if (ret == ESP_OK) {
+        ret = pca9685_write_reg(PCA9685_PRE_SCALE, (uint8_t)value);
+    }
+    if (ret == ESP_OK) {
+        ret = pca9685_write_reg(PCA9685_MODE2, PCA9685_MODE2_OUTDRV);
+    }
+
+    // Every channel off before the oscillator starts
+    if (ret == ESP_OK) {
+        uint8_t all_off[5] = { PCA9685_ALL_LED_ON_L, 0, 0, 0, PCA9685_FULL_OFF };
+        ret = i2c_master_transmit(pca9685_dev, all_off, sizeof(all_off), PCA9685_TIMEOUT_MS);
+    }
+    if (ret == ESP_OK) {
+        ret = pca9685_write_reg(PCA9685_MODE1, PCA9685_MODE1_AI);
+        esp_rom_delay_us(PCA9685_OSC_START_US);
+    }
+
+    *prescale = (uint32_t)value;
+    return ret;
+}
@@ -1,43 +1,96 @@
 #include "servo_controller.h"
-#include "driver/ledc.h"
+#include "motion_engine.h"
+#include "servo_backend.h"
 #include "esp_log.h"
+#include "nvs.h"
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <math.h>
 #include <string.h>
 
 static const char* TAG = "SERVO";
 
 // Servo configuration
 typedef struct {
-    int gpio_pin;
+    int pin;                    // GPIO, or channel on a PWM expander
     const char* name;
-    int current_angle;
+    servo_mdeg_t current_angle;  // Last angle written to the output
     bool initialized;
+    traj_limits_t limits;       // max velocity (deg/s), acceleration (deg/s^2), jerk (deg/s^3)
+    int32_t phase_us;           // Pulse start within the frame, or SERVO_PHASE_AUTO
+    uint16_t frequency_hz;      // PWM frame rate
 } servo_config_t;
 
-// GPIO pins and names for each servo
-static servo_config_t servo_configs[SERVO_COUNT] = {
-    {26, "Forearm", 0, false},  // Cẳng tay
-    {27, "Wrist", 0, false},    // Cổ tay  
-    {32, "Arm", 0, false},      // Cánh tay
-    {33, "Base", 0, false}      // Bụng
+// Default joint table: GPIO pins, names, motion limits, pulse phase and frame
+// rate for each servo. Joints carrying more of the arm get gentler
+// acceleration to avoid overshoot. servo_set_joints() replaces it.
+static servo_config_t servo_configs[SERVO_MAX_JOINTS] = {
+    {26, "Forearm", 0, false, {180.0f, 600.0f, 4000.0f}, SERVO_PHASE_AUTO, SERVO_FREQUENCY_HZ},  // Cẳng tay
+    {27, "Wrist", 0, false, {240.0f, 900.0f, 6000.0f}, SERVO_PHASE_AUTO, SERVO_FREQUENCY_HZ},    // Cổ tay  
+    {32, "Arm", 0, false, {120.0f, 300.0f, 2000.0f}, SERVO_PHASE_AUTO, SERVO_FREQUENCY_HZ},      // Cánh tay
+    {33, "Base", 0, false, {120.0f, 250.0f, 1500.0f}, SERVO_PHASE_AUTO, SERVO_FREQUENCY_HZ}      // Bụng
 };
+static int servo_joint_count = SERVO_KIN_JOINTS;
 
 // PWM configuration constants
-#define SERVO_MIN_PULSEWIDTH_US (500)   
-#define SERVO_MAX_PULSEWIDTH_US (2500)  
 #define SERVO_MAX_DEGREE        (180)   
-#define SERVO_FREQUENCY_HZ      (50)
-#define SERVO_PERIOD_US         (20000)  // 20ms period
-#define SERVO_DUTY_RESOLUTION   LEDC_TIMER_16_BIT
+
+// Output backend used when servo_set_backend() is not called
+#ifdef CONFIG_IDF_TARGET_LINUX
+#define SERVO_DEFAULT_BACKEND   servo_backend_mock
+#else
+#define SERVO_DEFAULT_BACKEND   servo_backend_ledc
+#endif
+
+// Calibration storage
+#define SERVO_CALIB_NVS_NAMESPACE   "servo"
+#define SERVO_CALIB_NVS_KEY         "calib"
+#define SERVO_CALIB_VERSION         2       // Bump whenever servo_calib_blob_t changes
+#define SERVO_DUTY_MAP_SHIFT        24
+
+typedef struct {
+    uint16_t version;
+    uint16_t count;
+    servo_calibration_t joints[SERVO_MAX_JOINTS];
+} servo_calib_blob_t;
+
+// Calibration and phase compiled to multiply-shift form:
+// duty = (base + angle_mdeg * slope) >> SERVO_DUTY_MAP_SHIFT
+typedef struct {
+    int64_t base;
+    int64_t slope;
+    servo_mdeg_t soft_min;
+    servo_mdeg_t soft_max;
+    uint32_t hpoint;            // Pulse start in timer counts
+} servo_duty_map_t;
+
+static servo_calibration_t servo_calibrations[SERVO_MAX_JOINTS];
+static servo_duty_map_t servo_duty_maps[SERVO_MAX_JOINTS];
+static portMUX_TYPE servo_map_lock = portMUX_INITIALIZER_UNLOCKED;
 
 static bool servo_system_initialized = false;
+static const servo_backend_t* servo_backend = &SERVO_DEFAULT_BACKEND;
+static uint32_t servo_period_ticks[SERVO_MAX_JOINTS];    // Duty counts per frame, from the backend
+
+// Hardware fades in flight, cleared by the fade-end interrupt
+static volatile bool servo_fading[SERVO_MAX_JOINTS];
+static servo_fade_cb_t servo_fade_cb = NULL;
+static void* servo_fade_cb_arg = NULL;
 
 // Private function prototypes
-static esp_err_t servo_configure_pwm(servo_id_t servo_id);
-static uint32_t servo_angle_to_duty(int angle);
+static esp_err_t servo_configure_outputs(void);
+static uint32_t servo_period_us(servo_id_t servo_id);
+static uint32_t servo_angle_to_duty(servo_id_t servo_id, servo_mdeg_t angle);
+static void servo_compile_duty_map(servo_id_t servo_id);
+static uint32_t servo_get_hpoint(servo_id_t servo_id);
+static bool servo_is_valid_calibration(const servo_calibration_t* calib);
+static void servo_load_calibration(void);
 static bool servo_is_valid_id(servo_id_t servo_id);
 static bool servo_is_valid_angle(int angle);
+static int servo_step_delay_to_speed(int step_delay_ms);
+static void servo_stop_fade(servo_id_t servo_id);
+static bool servo_fade_done(int output);
 
 esp_err_t servo_init(void) {
     if (servo_system_initialized) {
@@ -45,47 +98,64 @@ esp_err_t servo_init(void) {
         return ESP_OK;
     }
 
-    ESP_LOGI(TAG, "Initializing servo controller...");
+    ESP_LOGI(TAG, "Initializing servo controller (%s outputs)...", servo_backend->name);
 
-    // Initialize all servos
-    for (int i = 0; i < SERVO_COUNT; i++) {
-        esp_err_t ret = servo_configure_pwm((servo_id_t)i);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to configure servo %d (%s): %s", 
-                    i, servo_configs[i].name, esp_err_to_name(ret));
-            servo_deinit();
-            return ret;
-        }
+    esp_err_t ret = servo_configure_outputs();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // The duty maps depend on the counts per frame the backend reported
+    servo_load_calibration();
+
+    for (int i = 0; i < servo_joint_count; i++) {
+        servo_fading[i] = false;
         servo_configs[i].initialized = true;
         servo_configs[i].current_angle = 0;
     }
 
     // Set all servos to initial position (0 degrees)
-    for (int i = 0; i < SERVO_COUNT; i++) {
-        servo_set_angle((servo_id_t)i, 0);
+    for (int i = 0; i < servo_joint_count; i++) {
+        servo_output_write((servo_id_t)i, 0);
         vTaskDelay(pdMS_TO_TICKS(100)); // Small delay between servo movements
     }
 
+    // From here on the motion engine owns the PWM outputs
+    ret = motion_engine_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start motion engine: %s", esp_err_to_name(ret));
+        servo_deinit();
+        return ret;
+    }
+
     servo_system_initialized = true;
     ESP_LOGI(TAG, "Servo controller initialized successfully");
     return ESP_OK;
 }
 
 void servo_deinit(void) {
-    if (!servo_system_initialized) {
+    // Also reached from a failed servo_init() once the outputs exist
+    if (!servo_system_initialized && !servo_configs[0].initialized) {
         return;
     }
 
     ESP_LOGI(TAG, "Deinitializing servo controller...");
 
+    motion_engine_deinit();
+
+    for (int i = 0; i < servo_joint_count; i++) {
+        servo_stop_fade((servo_id_t)i);
+    }
+
     // Reset all servos to 0 position
-    for (int i = 0; i < SERVO_COUNT; i++) {
+    for (int i = 0; i < servo_joint_count; i++) {
         if (servo_configs[i].initialized) {
-            servo_set_angle((servo_id_t)i, 0);
+            servo_output_write((servo_id_t)i, 0);
             servo_configs[i].initialized = false;
             servo_configs[i].current_angle = 0;
         }
     }
+    servo_backend->deinit();
 
     servo_system_initialized = false;
     ESP_LOGI(TAG, "Servo controller deinitialized");
@@ -107,29 +177,25 @@ esp_err_t servo_set_angle(servo_id_t servo_id, int angle) {
         angle = (angle < SERVO_MIN_ANGLE) ? SERVO_MIN_ANGLE : SERVO_MAX_ANGLE;
     }
 
-    uint32_t duty = servo_angle_to_duty(angle);
-    
-    esp_err_t ret = ledc_set_duty(LEDC_LOW_SPEED_MODE, servo_id, duty);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set duty for servo %s: %s", 
-                servo_configs[servo_id].name, esp_err_to_name(ret));
-        return ret;
+    return servo_set_angle_mdeg(servo_id, SERVO_DEG_TO_MDEG(angle));
+}
+
+esp_err_t servo_set_angle_mdeg(servo_id_t servo_id, servo_mdeg_t angle) {
+    if (!servo_system_initialized) {
+        ESP_LOGE(TAG, "Servo system not initialized");
+        return ESP_ERR_INVALID_STATE;
     }
 
-    ret = ledc_update_duty(LEDC_LOW_SPEED_MODE, servo_id);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to update duty for servo %s: %s", 
-                servo_configs[servo_id].name, esp_err_to_name(ret));
-        return ret;
+    if (!servo_is_valid_id(servo_id)) {
+        ESP_LOGE(TAG, "Invalid servo ID: %d", servo_id);
+        return ESP_ERR_INVALID_ARG;
     }
 
-    servo_configs[servo_id].current_angle = angle;
-    
-    
-    return ESP_OK;
+    // Instant jump, written by the motion engine on its next tick
+    return motion_jump(servo_id, SERVO_MDEG_TO_DEG(angle));
 }
 
-esp_err_t servo_set_all_angles(int angles[SERVO_COUNT]) {
+esp_err_t servo_set_all_angles(int angles[SERVO_MAX_JOINTS]) {
     if (!servo_system_initialized) {
         ESP_LOGE(TAG, "Servo system not initialized");
         return ESP_ERR_INVALID_STATE;
@@ -141,24 +207,26 @@ esp_err_t servo_set_all_angles(int angles[SERVO_COUNT]) {
     }
 
     ESP_LOGI(TAG, "Setting all servo angles");
-    
-    for (int i = 0; i < SERVO_COUNT; i++) {
-        esp_err_t ret = servo_set_angle((servo_id_t)i, angles[i]);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to set angle for servo %d", i);
-            return ret;
-        }
-        vTaskDelay(pdMS_TO_TICKS(50)); // Small delay between movements
-    }
 
-    return ESP_OK;
+    // All joints jump on the same tick, no per-joint delay
+    float targets[SERVO_MAX_JOINTS];
+    for (int i = 0; i < servo_joint_count; i++) {
+        targets[i] = (float)angles[i];
+    }
+    return motion_jump_all(targets);
 }
 
 esp_err_t servo_reset_all(void) {
+    if (!servo_system_initialized) {
+        ESP_LOGE(TAG, "Servo system not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
     ESP_LOGI(TAG, "Resetting all servos to 0 degrees");
-    
-    int reset_angles[SERVO_COUNT] = {0, 0, 0, 0};
-    return servo_set_all_angles(reset_angles);
+
+    // Coordinated move home so the joints arrive together
+    const float reset_angles[SERVO_MAX_JOINTS] = {0};
+    return motion_move_joints(reset_angles, 0.0f, 0.0f, NULL);
 }
 
 esp_err_t servo_move_smooth(servo_id_t servo_id, int target_angle, int step_delay_ms) {
@@ -177,21 +245,169 @@ esp_err_t servo_move_smooth(servo_id_t servo_id, int target_angle, int step_dela
         return ESP_ERR_INVALID_ARG;
     }
 
-    int current_angle = servo_configs[servo_id].current_angle;
-    int step = (target_angle > current_angle) ? 1 : -1;
-    
-    // ESP_LOGI(TAG, "Smooth move servo %s from %d to %d degrees", 
-    //         servo_configs[servo_id].name, current_angle, target_angle);
+    // Blocking wrapper: the move runs in the motion engine, this task only waits
+    esp_err_t ret = servo_move_async(servo_id, target_angle, step_delay_ms);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    return motion_wait_idle(MOTION_JOINT_BIT(servo_id), portMAX_DELAY);
+}
+
+esp_err_t servo_move_async(servo_id_t servo_id, int target_angle, int step_delay_ms) {
+    if (!servo_system_initialized) {
+        ESP_LOGE(TAG, "Servo system not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!servo_is_valid_id(servo_id)) {
+        ESP_LOGE(TAG, "Invalid servo ID: %d", servo_id);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!servo_is_valid_angle(target_angle)) {
+        ESP_LOGE(TAG, "Invalid target angle: %d", target_angle);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Same speed as the old 1 degree per step_delay_ms ramp
+    return motion_set_target(servo_id, (float)target_angle,
+                             (float)servo_step_delay_to_speed(step_delay_ms));
+}
+
+esp_err_t servo_move_async_mdeg(servo_id_t servo_id, servo_mdeg_t target, servo_mdeg_t speed_per_s) {
+    if (!servo_system_initialized) {
+        ESP_LOGE(TAG, "Servo system not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!servo_is_valid_id(servo_id)) {
+        ESP_LOGE(TAG, "Invalid servo ID: %d", servo_id);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (target < SERVO_MIN_ANGLE_MDEG || target > SERVO_MAX_ANGLE_MDEG) {
+        ESP_LOGE(TAG, "Invalid target angle: %ld mdeg", (long)target);
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    while (current_angle != target_angle) {
-        current_angle += step;
-        esp_err_t ret = servo_set_angle(servo_id, current_angle);
-        if (ret != ESP_OK) {
-            return ret;
+    // Slow moves stay smooth: the engine interpolates below one degree per tick
+    return motion_set_target(servo_id, SERVO_MDEG_TO_DEG(target), SERVO_MDEG_TO_DEG(speed_per_s));
+}
+
+esp_err_t servo_move_fade(servo_id_t servo_id, servo_mdeg_t target, uint32_t duration_ms) {
+    if (!servo_system_initialized) {
+        ESP_LOGE(TAG, "Servo system not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!servo_is_valid_id(servo_id)) {
+        ESP_LOGE(TAG, "Invalid servo ID: %d", servo_id);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (target < SERVO_MIN_ANGLE_MDEG || target > SERVO_MAX_ANGLE_MDEG) {
+        ESP_LOGE(TAG, "Invalid target angle: %ld mdeg", (long)target);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (servo_backend->fade_start == NULL) {
+        ESP_LOGE(TAG, "The %s backend has no hardware fade", servo_backend->name);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (duration_ms == 0) {
+        // As fast as the joint's velocity limit allows
+        float travel = fabsf(SERVO_MDEG_TO_DEG(target) - motion_get_position(servo_id));
+        duration_ms = (uint32_t)ceilf(travel * 1000.0f / servo_configs[servo_id].limits.max_vel);
+        if (duration_ms == 0) {
+            duration_ms = 1;
         }
-        vTaskDelay(pdMS_TO_TICKS(step_delay_ms));
     }
 
+    servo_stop_fade(servo_id);
+
+    // Take the joint away from the control tick before the peripheral starts
+    esp_err_t ret = motion_external_begin(servo_id, SERVO_MDEG_TO_DEG(target), duration_ms / 1000.0f);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    uint32_t duty = servo_angle_to_duty(servo_id, target);
+    servo_fading[servo_id] = true;
+    ret = servo_backend->fade_start(servo_id, duty, duration_ms);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start fade for servo %s: %s",
+                servo_configs[servo_id].name, esp_err_to_name(ret));
+        servo_fading[servo_id] = false;
+        motion_stop(servo_id);
+        return ret;
+    }
+
+    servo_configs[servo_id].current_angle = target;
+    return ESP_OK;
+}
+
+esp_err_t servo_set_joints(const servo_joint_config_t* joints, int count) {
+    if (joints == NULL || count <= 0 || count > SERVO_MAX_JOINTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (servo_system_initialized) {
+        ESP_LOGE(TAG, "Joint table must be set before servo_init()");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const servo_joint_config_t* joint = &joints[i];
+        if (joint->name == NULL || joint->limits.max_vel <= 0.0f || joint->limits.max_acc <= 0.0f ||
+            joint->limits.max_jerk <= 0.0f || joint->frequency_hz < SERVO_MIN_FREQUENCY_HZ ||
+            joint->frequency_hz > SERVO_MAX_FREQUENCY_HZ) {
+            ESP_LOGE(TAG, "Invalid joint table entry %d", i);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        servo_configs[i] = (servo_config_t){
+            .pin = joints[i].pin,
+            .name = joints[i].name,
+            .current_angle = 0,
+            .initialized = false,
+            .limits = joints[i].limits,
+            .phase_us = joints[i].phase_us,
+            .frequency_hz = joints[i].frequency_hz
+        };
+    }
+    servo_joint_count = count;
+    ESP_LOGI(TAG, "Joint table: %d joints", count);
+    return ESP_OK;
+}
+
+int servo_get_count(void) {
+    return servo_joint_count;
+}
+
+esp_err_t servo_set_backend(const servo_backend_t* backend) {
+    if (backend == NULL || backend->init == NULL || backend->stage == NULL || backend->commit == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (servo_system_initialized) {
+        ESP_LOGE(TAG, "Output backend must be set before servo_init()");
+        return ESP_ERR_INVALID_STATE;
+    }
+    servo_backend = backend;
+    return ESP_OK;
+}
+
+esp_err_t servo_set_fade_callback(servo_fade_cb_t callback, void* arg) {
+    // Swapped with fades idle, the ISR reads both without a lock
+    for (int i = 0; i < servo_joint_count; i++) {
+        if (servo_fading[i]) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    servo_fade_cb_arg = arg;
+    servo_fade_cb = callback;
     return ESP_OK;
 }
 
@@ -205,7 +421,7 @@ if (!servo_system_initialized) {
         ESP_LOGE(TAG, "Invalid servo ID: %d", servo_id);
         return ESP_ERR_INVALID_ARG;
     }
-    int current_angle = servo_configs[servo_id].current_angle;
+    int current_angle = servo_get_current_angle(servo_id);
 
 
     if (!servo_is_valid_angle(current_angle)) {
@@ -213,19 +429,18 @@ if (!servo_system_initialized) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    int step = direct ? 1 : -1;
-
-    // ESP_LOGI(TAG, "Smooth move servo %s from %d to %d degrees", 
-    //         servo_configs[servo_id].name, current_angle, target_angle);
-        current_angle += step;
-        esp_err_t ret = servo_set_angle(servo_id, current_angle);
-        if (ret != ESP_OK) {
-            return ret;
-        }
-        vTaskDelay(pdMS_TO_TICKS(step_delay_ms));
-    
+    // A jog at the speed the step delay stood for. The host resends the byte
+    // while the gesture is held; once it stops, the deadman brakes the joint.
+    float speed = (float)servo_step_delay_to_speed(step_delay_ms);
+    return motion_jog(servo_id, direct ? speed : -speed, 0);
+}
 
-    return ESP_OK;
+esp_err_t servo_track_mdeg(servo_id_t servo_id, servo_mdeg_t setpoint) {
+    if (!servo_system_initialized) {
+        ESP_LOGE(TAG, "Servo system not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    return motion_track(servo_id, SERVO_MDEG_TO_DEG(setpoint), 0.0f);
 }
 
 
@@ -244,73 +459,388 @@ int servo_get_current_angle(servo_id_t servo_id) {
     if (!servo_is_valid_id(servo_id)) {
         return -1;
     }
+    // Integer-degree wrapper, rounded to nearest
+    return (servo_get_current_angle_mdeg(servo_id) + SERVO_MDEG_PER_DEG / 2) / SERVO_MDEG_PER_DEG;
+}
+
+servo_mdeg_t servo_get_current_angle_mdeg(servo_id_t servo_id) {
+    if (!servo_is_valid_id(servo_id)) {
+        return -1;
+    }
+    if (motion_engine_is_running()) {
+        return (servo_mdeg_t)lroundf(motion_get_position(servo_id) * SERVO_MDEG_PER_DEG);
+    }
     return servo_configs[servo_id].current_angle;
 }
 
-// Private function implementations
-static esp_err_t servo_configure_pwm(servo_id_t servo_id) {
+esp_err_t servo_set_calibration(servo_id_t servo_id, const servo_calibration_t* calib) {
+    if (!servo_is_valid_id(servo_id) || calib == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!servo_is_valid_calibration(calib)) {
+        ESP_LOGE(TAG, "Invalid calibration for servo %s", servo_configs[servo_id].name);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    servo_calibrations[servo_id] = *calib;
+    servo_compile_duty_map(servo_id);
+
+    ESP_LOGI(TAG, "Servo %s calibration: %u-%u us, offset %ld mdeg%s, limits [%ld, %ld]",
+             servo_configs[servo_id].name, calib->min_pulse_us, calib->max_pulse_us,
+             (long)calib->offset_mdeg, calib->inverted ? ", inverted" : "",
+             (long)calib->soft_min, (long)calib->soft_max);
+    return ESP_OK;
+}
+
+esp_err_t servo_set_phase(servo_id_t servo_id, int32_t phase_us) {
     if (!servo_is_valid_id(servo_id)) {
         return ESP_ERR_INVALID_ARG;
     }
+    if (phase_us != SERVO_PHASE_AUTO && (phase_us < 0 || phase_us >= (int32_t)servo_period_us(servo_id))) {
+        ESP_LOGE(TAG, "Invalid phase %ld us for servo %s", (long)phase_us, servo_configs[servo_id].name);
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    // Configure LEDC timer
-    ledc_timer_config_t ledc_timer = {
-        .speed_mode       = LEDC_LOW_SPEED_MODE,
-        .timer_num        = servo_id,
-        .duty_resolution  = SERVO_DUTY_RESOLUTION,
-        .freq_hz          = SERVO_FREQUENCY_HZ,
-        .clk_cfg          = LEDC_AUTO_CLK
+    servo_configs[servo_id].phase_us = phase_us;
+    servo_compile_duty_map(servo_id);
+    return ESP_OK;
+}
+
+int32_t servo_get_phase(servo_id_t servo_id) {
+    if (!servo_is_valid_id(servo_id)) {
+        return 0;
+    }
+    if (servo_period_ticks[servo_id] == 0) {
+        // Outputs not configured yet, nothing compiled
+        return servo_configs[servo_id].phase_us;
+    }
+    uint32_t hpoint = servo_get_hpoint(servo_id);
+    return (int32_t)((int64_t)hpoint * servo_period_us(servo_id) / servo_period_ticks[servo_id]);
+}
+
+esp_err_t servo_set_frequency(servo_id_t servo_id, uint32_t frequency_hz) {
+    if (!servo_is_valid_id(servo_id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (servo_system_initialized) {
+        // The backend sets up its counters for the frame rate at init
+        ESP_LOGE(TAG, "Frame rate must be set before servo_init()");
+        return ESP_ERR_INVALID_STATE;
+    }
+    // 333 Hz still leaves room for the longest valid calibrated pulse (3000 us)
+    if (frequency_hz < SERVO_MIN_FREQUENCY_HZ || frequency_hz > SERVO_MAX_FREQUENCY_HZ) {
+        ESP_LOGE(TAG, "Invalid frame rate %lu Hz for servo %s",
+                 (unsigned long)frequency_hz, servo_configs[servo_id].name);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // The duty map is compiled for the new period when servo_init() loads the calibration
+    servo_configs[servo_id].frequency_hz = (uint16_t)frequency_hz;
+    return ESP_OK;
+}
+
+uint32_t servo_get_frequency(servo_id_t servo_id) {
+    if (!servo_is_valid_id(servo_id)) {
+        return 0;
+    }
+    return servo_configs[servo_id].frequency_hz;
+}
+
+esp_err_t servo_get_calibration(servo_id_t servo_id, servo_calibration_t* calib) {
+    if (!servo_is_valid_id(servo_id) || calib == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *calib = servo_calibrations[servo_id];
+    return ESP_OK;
+}
+
+esp_err_t servo_save_calibration(void) {
+    servo_calib_blob_t blob = {
+        .version = SERVO_CALIB_VERSION,
+        .count = (uint16_t)servo_joint_count
     };
-    
-    esp_err_t ret = ledc_timer_config(&ledc_timer);
+    memcpy(blob.joints, servo_calibrations, sizeof(blob.joints));
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(SERVO_CALIB_NVS_NAMESPACE, NVS_READWRITE, &handle);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to configure LEDC timer for servo %d: %s", 
-                servo_id, esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    // Configure LEDC channel
-    ledc_channel_config_t ledc_channel = {
-        .gpio_num       = servo_configs[servo_id].gpio_pin,
-        .speed_mode     = LEDC_LOW_SPEED_MODE,
-        .channel        = servo_id,
-        .timer_sel      = servo_id,
-        .duty           = 0,
-        .hpoint         = 0
-    };
-    
-    ret = ledc_channel_config(&ledc_channel);
+    ret = nvs_set_blob(handle, SERVO_CALIB_NVS_KEY, &blob, sizeof(blob));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save calibration: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(TAG, "Calibration saved (v%d)", SERVO_CALIB_VERSION);
+    return ESP_OK;
+}
+
+float servo_clamp_angle(servo_id_t servo_id, float angle) {
+    if (!servo_is_valid_id(servo_id)) {
+        return angle;
+    }
+    float min = SERVO_MDEG_TO_DEG(servo_calibrations[servo_id].soft_min);
+    float max = SERVO_MDEG_TO_DEG(servo_calibrations[servo_id].soft_max);
+    if (angle < min) return min;
+    if (angle > max) return max;
+    return angle;
+}
+
+esp_err_t servo_set_limits(servo_id_t servo_id, const traj_limits_t* limits) {
+    if (!servo_is_valid_id(servo_id) || limits == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (limits->max_vel <= 0.0f || limits->max_acc <= 0.0f || limits->max_jerk <= 0.0f) {
+        ESP_LOGE(TAG, "Invalid limits for servo %s", servo_configs[servo_id].name);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Takes effect on the next planned move
+    servo_configs[servo_id].limits = *limits;
+    ESP_LOGI(TAG, "Servo %s limits: v=%.0f a=%.0f j=%.0f", servo_configs[servo_id].name,
+             limits->max_vel, limits->max_acc, limits->max_jerk);
+    return ESP_OK;
+}
+
+esp_err_t servo_get_limits(servo_id_t servo_id, traj_limits_t* limits) {
+    if (!servo_is_valid_id(servo_id) || limits == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *limits = servo_configs[servo_id].limits;
+    return ESP_OK;
+}
+
+esp_err_t servo_output_write(servo_id_t servo_id, float angle) {
+    esp_err_t ret = servo_output_stage(servo_id, angle);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to configure LEDC channel for servo %d: %s", 
-                servo_id, esp_err_to_name(ret));
         return ret;
     }
+    return servo_output_commit(1UL << servo_id);
+}
+
+esp_err_t servo_output_stage(servo_id_t servo_id, float angle) {
+    if (!servo_is_valid_id(servo_id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    // ESP_LOGD(TAG, "Configured servo %d (%s) on GPIO %d", 
-    //         servo_id, servo_configs[servo_id].name, servo_configs[servo_id].gpio_pin);
-    
+    if (servo_fading[servo_id]) {
+        // The fade owns the channel until it ends or a new command takes the joint
+        if (motion_is_external(servo_id)) {
+            return ESP_OK;
+        }
+        servo_stop_fade(servo_id);
+    }
+
+    servo_mdeg_t angle_mdeg = (servo_mdeg_t)lroundf(angle * SERVO_MDEG_PER_DEG);
+    uint32_t duty = servo_angle_to_duty(servo_id, angle_mdeg);
+
+    // Not visible on the pin until servo_output_commit()
+    esp_err_t ret = servo_backend->stage(servo_id, duty, servo_get_hpoint(servo_id));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set duty for servo %s: %s", 
+                servo_configs[servo_id].name, esp_err_to_name(ret));
+        return ret;
+    }
+
+    servo_configs[servo_id].current_angle = angle_mdeg;
     return ESP_OK;
 }
 
-static uint32_t servo_angle_to_duty(int angle) {
-    // Ensure angle is within valid range
-    if (angle < SERVO_MIN_ANGLE) angle = SERVO_MIN_ANGLE;
-    if (angle > SERVO_MAX_ANGLE) angle = SERVO_MAX_ANGLE;
+esp_err_t servo_output_commit(uint32_t servo_mask) {
+    // Every output in the mask changes on the same PWM frame
+    esp_err_t ret = servo_backend->commit(servo_mask & ((1UL << servo_joint_count) - 1));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to commit outputs 0x%lx: %s",
+                 (unsigned long)servo_mask, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+// Private function implementations
+static esp_err_t servo_configure_outputs(void) {
+    servo_output_config_t outputs[SERVO_MAX_JOINTS];
+    for (int i = 0; i < servo_joint_count; i++) {
+        outputs[i].pin = servo_configs[i].pin;
+        outputs[i].frequency_hz = servo_configs[i].frequency_hz;
+    }
+
+    esp_err_t ret = servo_backend->init(outputs, servo_joint_count, servo_period_ticks, servo_fade_done);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure %s outputs: %s", servo_backend->name, esp_err_to_name(ret));
+        servo_backend->deinit();
+        return ret;
+    }
+    return ESP_OK;
+}
+
+static uint32_t servo_angle_to_duty(servo_id_t servo_id, servo_mdeg_t angle) {
+    taskENTER_CRITICAL(&servo_map_lock);
+    servo_duty_map_t map = servo_duty_maps[servo_id];
+    taskEXIT_CRITICAL(&servo_map_lock);
 
-    // Calculate pulse width in microseconds
-    uint32_t pulse_width_us = SERVO_MIN_PULSEWIDTH_US + 
-                              (angle * (SERVO_MAX_PULSEWIDTH_US - SERVO_MIN_PULSEWIDTH_US)) / SERVO_MAX_DEGREE;
-    
-    // Convert to duty cycle value
-    uint32_t duty = (pulse_width_us * (1 << SERVO_DUTY_RESOLUTION)) / SERVO_PERIOD_US;
-    
-    return duty;
+    // Soft limits, then one multiply and shift - no division on the hot path
+    if (angle < map.soft_min) angle = map.soft_min;
+    if (angle > map.soft_max) angle = map.soft_max;
+
+    int64_t duty = (map.base + (int64_t)angle * map.slope) >> SERVO_DUTY_MAP_SHIFT;
+    return (duty > 0) ? (uint32_t)duty : 0;
+}
+
+static void servo_compile_duty_map(servo_id_t servo_id) {
+    const servo_calibration_t* calib = &servo_calibrations[servo_id];
+
+    // Duty counts per nanosecond of pulse and per millidegree of travel
+    uint32_t period_us = servo_period_us(servo_id);
+    double counts_per_ns = (double)servo_period_ticks[servo_id] / ((double)period_us * 1000.0);
+    double ns_per_mdeg = (double)(calib->max_pulse_us - calib->min_pulse_us) * 1000.0 /
+                         SERVO_DEG_TO_MDEG(SERVO_MAX_DEGREE);
+    double slope = ns_per_mdeg * counts_per_ns;
+
+    // Physical angle = offset + (inverted ? max - angle : angle)
+    double zero = calib->min_pulse_us * 1000.0 * counts_per_ns;
+    if (calib->inverted) {
+        zero += (SERVO_DEG_TO_MDEG(SERVO_MAX_DEGREE) + calib->offset_mdeg) * slope;
+        slope = -slope;
+    } else {
+        zero += calib->offset_mdeg * slope;
+    }
+
+    // Staggered pulse start, kept early enough that the longest pulse ends inside the frame
+    int32_t max_phase = (int32_t)period_us - calib->max_pulse_us;
+    if (max_phase < 0) {
+        max_phase = 0;
+    }
+    int32_t phase = servo_configs[servo_id].phase_us;
+    if (phase == SERVO_PHASE_AUTO) {
+        // Spread over [0, max_phase] among the joints sharing this frame rate,
+        // so short frames do not clamp several joints onto the same start
+        int slot = 0;
+        int group = 0;
+        for (int i = 0; i < servo_joint_count; i++) {
+            if (servo_configs[i].frequency_hz == servo_configs[servo_id].frequency_hz) {
+                slot += (i < servo_id);
+                group++;
+            }
+        }
+        phase = (group > 1) ? (int32_t)((int64_t)max_phase * slot / (group - 1)) : 0;
+    }
+    if (phase > max_phase) {
+        phase = max_phase;
+    }
+
+    const double scale = (double)(1LL << SERVO_DUTY_MAP_SHIFT);
+    servo_duty_map_t map = {
+        .base = (int64_t)llround((zero + 0.5) * scale),  // +0.5 rounds to the nearest count
+        .slope = (int64_t)llround(slope * scale),
+        .soft_min = calib->soft_min,
+        .soft_max = calib->soft_max,
+        .hpoint = (uint32_t)llround(phase * 1000.0 * counts_per_ns)
+    };
+
+    taskENTER_CRITICAL(&servo_map_lock);
+    servo_duty_maps[servo_id] = map;
+    taskEXIT_CRITICAL(&servo_map_lock);
+}
+
+static uint32_t servo_get_hpoint(servo_id_t servo_id) {
+    taskENTER_CRITICAL(&servo_map_lock);
+    uint32_t hpoint = servo_duty_maps[servo_id].hpoint;
+    taskEXIT_CRITICAL(&servo_map_lock);
+    return hpoint;
+}
+
+static bool servo_is_valid_calibration(const servo_calibration_t* calib) {
+    return calib->min_pulse_us >= 100 && calib->max_pulse_us <= 3000 &&
+           calib->min_pulse_us < calib->max_pulse_us &&
+           calib->soft_min >= SERVO_MIN_ANGLE_MDEG && calib->soft_max <= SERVO_MAX_ANGLE_MDEG &&
+           calib->soft_min < calib->soft_max;
+}
+
+static void servo_load_calibration(void) {
+    const servo_calibration_t defaults = DEFAULT_SERVO_CALIBRATION();
+    for (int i = 0; i < servo_joint_count; i++) {
+        servo_calibrations[i] = defaults;
+    }
+
+    servo_calib_blob_t blob;
+    size_t length = sizeof(blob);
+    nvs_handle_t handle;
+
+    esp_err_t ret = nvs_open(SERVO_CALIB_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (ret == ESP_OK) {
+        ret = nvs_get_blob(handle, SERVO_CALIB_NVS_KEY, &blob, &length);
+        nvs_close(handle);
+    }
+
+    if (ret != ESP_OK) {
+        ESP_LOGI(TAG, "No stored calibration, using defaults");
+    } else if (length != sizeof(blob) || blob.version != SERVO_CALIB_VERSION || blob.count != servo_joint_count) {
+        ESP_LOGW(TAG, "Stored calibration has wrong layout (v%d, %d joints), using defaults",
+                 blob.version, blob.count);
+    } else {
+        for (int i = 0; i < servo_joint_count; i++) {
+            if (servo_is_valid_calibration(&blob.joints[i])) {
+                servo_calibrations[i] = blob.joints[i];
+            } else {
+                ESP_LOGW(TAG, "Stored calibration for servo %s is invalid, using defaults",
+                         servo_configs[i].name);
+            }
+        }
+        ESP_LOGI(TAG, "Calibration loaded from NVS (v%d)", SERVO_CALIB_VERSION);
+    }
+
+    for (int i = 0; i < servo_joint_count; i++) {
+        servo_compile_duty_map((servo_id_t)i);
+    }
 }
 
 static bool servo_is_valid_id(servo_id_t servo_id) {
-    return (servo_id >= 0 && servo_id < SERVO_COUNT);
+    return (servo_id >= 0 && servo_id < servo_joint_count);
 }
 
 static bool servo_is_valid_angle(int angle) {
     return (angle >= SERVO_MIN_ANGLE && angle <= SERVO_MAX_ANGLE);
-}
\ No newline at end of file
+}
+
+static int servo_step_delay_to_speed(int step_delay_ms) {
+    // 0 ms per degree means "as fast as possible"
+    if (step_delay_ms <= 0) {
+        return SERVO_MAX_DEGREE * 1000;
+    }
+    return 1000 / step_delay_ms;
+}
+
+static void servo_stop_fade(servo_id_t servo_id) {
+    if (servo_fading[servo_id]) {
+        servo_backend->fade_stop(servo_id);
+        servo_fading[servo_id] = false;
+    }
+}
+
+// Fade end, possibly from an ISR: hand the joint back to the motion engine
+static bool servo_fade_done(int output) {
+    servo_id_t servo_id = (servo_id_t)output;
+    if (!servo_is_valid_id(servo_id) || !servo_fading[servo_id]) {
+        return false;
+    }
+
+    servo_fading[servo_id] = false;
+    bool woken = motion_external_done_from_isr(servo_id);
+    if (servo_fade_cb != NULL) {
+        servo_fade_cb(servo_id, servo_fade_cb_arg);
+    }
+    return woken;
+}
+
+static uint32_t servo_period_us(servo_id_t servo_id) {
+    return 1000000 / servo_configs[servo_id].frequency_hz;
+}
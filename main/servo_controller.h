@@ -3,16 +3,24 @@
 
 #include "esp_err.h"
 #include "stdbool.h"
+#include "stdint.h"
+#include "trajectory.h"
+#include "servo_backend.h"
 
-// Servo IDs with meaningful names
+// Servo IDs with meaningful names. These are the first entries of every
+// joint table; extra joints (gripper, 6-DOF wrist) follow as plain indices.
 typedef enum {
         SERVO_FOREARM = 0,    // Cẳng tay - GPIO 26
     SERVO_WRIST = 1,      // Cổ tay - GPIO 27  
     SERVO_ARM = 2,        // Cánh tay - GPIO 32
     SERVO_BASE = 3,       // Bụng - GPIO 33
-    SERVO_COUNT = 4
+    SERVO_KIN_JOINTS = 4  // Joints used by the arm kinematics
 } servo_id_t;
 
+// Capacity of the joint table: one PCA9685, and joint masks stay within
+// the 24 bits a FreeRTOS event group offers
+#define SERVO_MAX_JOINTS        (16)
+
 // Legacy defines for backward compatibility
 #define SERVO_1 SERVO_FOREARM
 #define SERVO_2 SERVO_WRIST
@@ -23,20 +31,119 @@ typedef enum {
 #define SERVO_MIN_ANGLE 0
 #define SERVO_MAX_ANGLE 180
 
+// Fixed-point angle in millidegrees. The 16-bit PWM gives ~36 duty counts
+// per degree, so whole degrees would throw most of that resolution away.
+typedef int32_t servo_mdeg_t;
+
+#define SERVO_MDEG_PER_DEG      1000
+#define SERVO_DEG_TO_MDEG(deg)  ((servo_mdeg_t)((deg) * SERVO_MDEG_PER_DEG))
+#define SERVO_MDEG_TO_DEG(mdeg) ((float)(mdeg) / SERVO_MDEG_PER_DEG)
+#define SERVO_MIN_ANGLE_MDEG    SERVO_DEG_TO_MDEG(SERVO_MIN_ANGLE)
+#define SERVO_MAX_ANGLE_MDEG    SERVO_DEG_TO_MDEG(SERVO_MAX_ANGLE)
+
+// Per-joint calibration, persisted in NVS and compiled into a duty map at load
+typedef struct {
+    uint16_t min_pulse_us;      // Pulse width at 0 degrees
+    uint16_t max_pulse_us;      // Pulse width at SERVO_MAX_ANGLE
+    int32_t offset_mdeg;        // Centre trim added to the commanded angle
+    uint8_t inverted;           // 1 = mirror the direction of rotation
+    servo_mdeg_t soft_min;      // Commands are clamped to [soft_min, soft_max]
+    servo_mdeg_t soft_max;
+} servo_calibration_t;
+
+// Default calibration (generic 500-2500 us hobby servo)
+#define DEFAULT_SERVO_CALIBRATION() { \
+    .min_pulse_us = 500, \
+    .max_pulse_us = 2500, \
+    .offset_mdeg = 0, \
+    .inverted = 0, \
+    .soft_min = SERVO_MIN_ANGLE_MDEG, \
+    .soft_max = SERVO_MAX_ANGLE_MDEG \
+}
+
+// PWM frame rate: 50 Hz for analog servos, up to 333 Hz for digital ones
+#define SERVO_FREQUENCY_HZ      (50)
+#define SERVO_MIN_FREQUENCY_HZ  (50)
+#define SERVO_MAX_FREQUENCY_HZ  (333)
+
+// Pulse phase: spread the channels evenly across the frame so their
+// start-of-pulse current draws do not coincide on the supply rail
+#define SERVO_PHASE_AUTO        (-1)
+
+// One row of the joint table
+typedef struct {
+    const char* name;
+    int pin;                    // GPIO, or channel number on a PWM expander
+    traj_limits_t limits;       // max velocity (deg/s), acceleration (deg/s^2), jerk (deg/s^3)
+    int32_t phase_us;           // Pulse start within the frame, or SERVO_PHASE_AUTO
+    uint16_t frequency_hz;      // PWM frame rate
+} servo_joint_config_t;
+
 // Function prototypes
 esp_err_t servo_init(void);
 esp_err_t servo_set_angle(servo_id_t servo_id, int angle);
-esp_err_t servo_set_all_angles(int angles[SERVO_COUNT]);
+esp_err_t servo_set_angle_mdeg(servo_id_t servo_id, servo_mdeg_t angle);
+esp_err_t servo_set_all_angles(int angles[SERVO_MAX_JOINTS]);
 esp_err_t servo_reset_all(void);
 esp_err_t servo_move_smooth(servo_id_t servo_id, int target_angle, int step_delay_ms);
+esp_err_t servo_move_async(servo_id_t servo_id, int target_angle, int step_delay_ms);
+esp_err_t servo_move_async_mdeg(servo_id_t servo_id, servo_mdeg_t target, servo_mdeg_t speed_per_s);
+// Hardware fade: the PWM peripheral ramps the duty linearly without CPU or
+// control-tick involvement. duration_ms = 0 uses the joint velocity limit.
+// Completion: motion_wait_idle() or the fade callback. ESP_ERR_NOT_SUPPORTED
+// when the output backend has no fade (only LEDC has one).
+esp_err_t servo_move_fade(servo_id_t servo_id, servo_mdeg_t target, uint32_t duration_ms);
+// Legacy gesture: jog the joint at 1 degree per step_delay_ms, towards the
+// upper limit if direct. Runs until the next gesture or MOTION_JOG_TIMEOUT_MS.
 // cần hàm hiệu chỉnh cho target angle cho hàm này
 esp_err_t servo_uart_controller(servo_id_t servo_id, int8_t step_delay_ms, int8_t direct);
+// Streaming setpoint, followed with the joint's jerk limits (never queues)
+esp_err_t servo_track_mdeg(servo_id_t servo_id, servo_mdeg_t setpoint);
 
 bool servo_is_initialized(void);
 void servo_deinit(void);
 
+// PWM output driver, set before servo_init(). Defaults to servo_backend_ledc,
+// or servo_backend_mock on the linux target.
+esp_err_t servo_set_backend(const servo_backend_t* backend);
+
+// Joint table, set before servo_init() (copied). Defaults to the four arm
+// joints. Arrays passed to the multi-joint calls hold servo_get_count() entries.
+esp_err_t servo_set_joints(const servo_joint_config_t* joints, int count);
+int servo_get_count(void);
+
+// Fade completion callback, runs in ISR context - keep it short
+typedef void (*servo_fade_cb_t)(servo_id_t servo_id, void* arg);
+esp_err_t servo_set_fade_callback(servo_fade_cb_t callback, void* arg);
+
+// Calibration: set() takes effect on the next output write, save() persists all joints
+esp_err_t servo_set_calibration(servo_id_t servo_id, const servo_calibration_t* calib);
+esp_err_t servo_get_calibration(servo_id_t servo_id, servo_calibration_t* calib);
+esp_err_t servo_save_calibration(void);
+float servo_clamp_angle(servo_id_t servo_id, float angle);
+
+// Pulse start offset within the PWM frame (us) or SERVO_PHASE_AUTO, applied on the next output write
+esp_err_t servo_set_phase(servo_id_t servo_id, int32_t phase_us);
+int32_t servo_get_phase(servo_id_t servo_id);
+
+// Per-joint frame rate, set before servo_init(). Joints with different rates
+// use separate PWM timers, each with the widest duty resolution it supports.
+esp_err_t servo_set_frequency(servo_id_t servo_id, uint32_t frequency_hz);
+uint32_t servo_get_frequency(servo_id_t servo_id);
+
+// Per-joint kinematic limits used by profiled moves
+esp_err_t servo_set_limits(servo_id_t servo_id, const traj_limits_t* limits);
+esp_err_t servo_get_limits(servo_id_t servo_id, traj_limits_t* limits);
+
 // Utility functions
 const char* servo_get_name(servo_id_t servo_id);
 int servo_get_current_angle(servo_id_t servo_id);
+servo_mdeg_t servo_get_current_angle_mdeg(servo_id_t servo_id);
+
+// Low-level output, only the motion engine should call these once it runs.
+// stage() loads a new duty, commit() latches all staged channels in servo_mask together.
+esp_err_t servo_output_write(servo_id_t servo_id, float angle);
+esp_err_t servo_output_stage(servo_id_t servo_id, float angle);
+esp_err_t servo_output_commit(uint32_t servo_mask);
 
 #endif // SERVO_CONTROLLER_H
\ No newline at end of file
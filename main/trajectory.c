@@ -0,0 +1,311 @@
+#include "trajectory.h"
+#include <math.h>
+#include <string.h>
+
+// Private function prototypes
+static void traj_accel_phase(const traj_segment_t* seg, float t, traj_state_t* out);
+static void traj_plan_trapezoid(traj_segment_t* seg, const traj_limits_t* limits);
+static void traj_plan_scurve(traj_segment_t* seg, const traj_limits_t* limits);
+static void traj_integrate(traj_state_t* s, float jerk, float t);
+static float traj_stop_distance(float vel, float acc, float max_acc, float max_jerk);
+static bool traj_otg_admissible(const traj_state_t* s, float error, float jerk,
+                                const traj_limits_t* limits, float dt);
+
+bool traj_plan(traj_segment_t* seg, float start, float end,
+               const traj_limits_t* limits, traj_profile_t profile) {
+    if (seg == NULL || limits == NULL || limits->max_vel <= 0.0f) {
+        return false;
+    }
+    if (profile != TRAJ_PROFILE_LINEAR && limits->max_acc <= 0.0f) {
+        return false;
+    }
+    if (profile == TRAJ_PROFILE_SCURVE && limits->max_jerk <= 0.0f) {
+        return false;
+    }
+
+    memset(seg, 0, sizeof(*seg));
+    seg->profile = profile;
+    seg->start = start;
+    seg->distance = fabsf(end - start);
+    seg->dir = (end >= start) ? 1.0f : -1.0f;
+    seg->time_scale = 1.0f;
+
+    if (seg->distance <= 0.0f) {
+        return true;
+    }
+
+    switch (profile) {
+        case TRAJ_PROFILE_LINEAR:
+            seg->vel = limits->max_vel;
+            seg->t_v = seg->distance / seg->vel;
+            break;
+
+        case TRAJ_PROFILE_TRAPEZOID:
+            traj_plan_trapezoid(seg, limits);
+            break;
+
+        case TRAJ_PROFILE_SCURVE:
+            traj_plan_scurve(seg, limits);
+            break;
+
+        default:
+            return false;
+    }
+
+    seg->duration = 2.0f * seg->t_a + seg->t_v;
+    return true;
+}
+
+bool traj_stretch(traj_segment_t* seg, float duration) {
+    if (seg == NULL || seg->duration <= 0.0f) {
+        return false;
+    }
+    float planned = seg->duration * seg->time_scale;
+    if (duration < planned) {
+        return false;
+    }
+    seg->time_scale = planned / duration;
+    seg->duration = duration;
+    return true;
+}
+
+void traj_sample(const traj_segment_t* seg, float t, traj_state_t* out) {
+    traj_state_t s = {0};
+    float k = seg->time_scale;
+
+    // Sample the profile on its own (unstretched) time base
+    float duration = seg->duration * k;
+    t *= k;
+
+    if (t <= 0.0f || duration <= 0.0f) {
+        s.pos = 0.0f;
+    } else if (t >= duration) {
+        s.pos = seg->distance;
+    } else if (t < seg->t_a) {
+        traj_accel_phase(seg, t, &s);
+    } else if (t < seg->t_a + seg->t_v) {
+        // The symmetric ramp covers vel * t_a / 2 for every profile shape
+        s.pos = 0.5f * seg->vel * seg->t_a + seg->vel * (t - seg->t_a);
+        s.vel = seg->vel;
+    } else {
+        // Deceleration mirrors the acceleration phase
+        traj_accel_phase(seg, duration - t, &s);
+        s.pos = seg->distance - s.pos;
+        s.acc = -s.acc;
+    }
+
+    out->pos = seg->start + seg->dir * s.pos;
+    out->vel = seg->dir * s.vel * k;
+    out->acc = seg->dir * s.acc * k * k;
+}
+
+void traj_cubic_hermite(traj_cubic_t* c, float p1, float p2, float m1, float m2, float h) {
+    float slope = (p2 - p1) / h;
+    c->c0 = p1;
+    c->c1 = m1;
+    c->c2 = (3.0f * slope - 2.0f * m1 - m2) / h;
+    c->c3 = (m1 + m2 - 2.0f * slope) / (h * h);
+}
+
+void traj_cubic_sample(const traj_cubic_t* c, float tau, traj_state_t* out) {
+    out->pos = c->c0 + tau * (c->c1 + tau * (c->c2 + tau * c->c3));
+    out->vel = c->c1 + tau * (2.0f * c->c2 + tau * 3.0f * c->c3);
+    out->acc = 2.0f * c->c2 + 6.0f * c->c3 * tau;
+}
+
+bool traj_otg_step(traj_state_t* state, float target, const traj_limits_t* limits, float dt) {
+    float j = limits->max_jerk;
+    float a = limits->max_acc;
+    float error = target - state->pos;
+
+    if (fabsf(error) < 1e-3f && fabsf(state->vel) < 1e-2f && fabsf(state->acc) <= j * dt) {
+        state->pos = target;
+        state->vel = 0.0f;
+        state->acc = 0.0f;
+        return true;
+    }
+
+    // Work in the frame where the target lies ahead
+    float dir = (error >= 0.0f) ? 1.0f : -1.0f;
+    traj_state_t s = { .pos = 0.0f, .vel = dir * state->vel, .acc = dir * state->acc };
+    error = fabsf(error);
+
+    // Jerk range that keeps the acceleration inside its limit
+    float lo = fmaxf(-j, (-a - s.acc) / dt);
+    float hi = fminf(j, (a - s.acc) / dt);
+    if (lo > hi) {
+        lo = hi;
+    }
+
+    // Admissibility is monotonic in the jerk, so bisect for the largest one
+    float jerk;
+    if (traj_otg_admissible(&s, error, hi, limits, dt)) {
+        jerk = hi;
+    } else if (!traj_otg_admissible(&s, error, lo, limits, dt)) {
+        jerk = lo;
+    } else {
+        for (int i = 0; i < TRAJ_OTG_ITERATIONS; i++) {
+            float mid = 0.5f * (lo + hi);
+            if (traj_otg_admissible(&s, error, mid, limits, dt)) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        jerk = lo;
+    }
+
+    traj_integrate(state, dir * jerk, dt);
+    return false;
+}
+
+float traj_stop_position(const traj_state_t* state, const traj_limits_t* limits) {
+    return state->pos + traj_stop_distance(state->vel, state->acc, limits->max_acc, limits->max_jerk);
+}
+
+float traj_end_position(const traj_segment_t* seg) {
+    return seg->start + seg->dir * seg->distance;
+}
+
+const char* traj_profile_name(traj_profile_t profile) {
+    switch (profile) {
+        case TRAJ_PROFILE_LINEAR: return "LINEAR";
+        case TRAJ_PROFILE_TRAPEZOID: return "TRAPEZOID";
+        case TRAJ_PROFILE_SCURVE: return "SCURVE";
+        default: return "UNKNOWN";
+    }
+}
+
+// Private function implementations
+static void traj_accel_phase(const traj_segment_t* seg, float t, traj_state_t* out) {
+    if (seg->profile != TRAJ_PROFILE_SCURVE) {
+        out->pos = 0.5f * seg->acc * t * t;
+        out->vel = seg->acc * t;
+        out->acc = seg->acc;
+        return;
+    }
+
+    float t_j = seg->t_j;
+    float t_a = seg->t_a;
+    float j = seg->jerk;
+
+    if (t < t_j) {
+        // Jerk ramp up
+        out->pos = j * t * t * t / 6.0f;
+        out->vel = 0.5f * j * t * t;
+        out->acc = j * t;
+    } else if (t < t_a - t_j) {
+        // Constant acceleration
+        out->pos = seg->acc / 6.0f * (3.0f * t * t - 3.0f * t_j * t + t_j * t_j);
+        out->vel = seg->acc * (t - 0.5f * t_j);
+        out->acc = seg->acc;
+    } else {
+        // Jerk ramp down into cruise
+        float r = t_a - t;
+        out->pos = 0.5f * seg->vel * t_a - seg->vel * r + j * r * r * r / 6.0f;
+        out->vel = seg->vel - 0.5f * j * r * r;
+        out->acc = j * r;
+    }
+}
+
+static void traj_plan_trapezoid(traj_segment_t* seg, const traj_limits_t* limits) {
+    float v = limits->max_vel;
+    float a = limits->max_acc;
+
+    seg->acc = a;
+    if (seg->distance >= v * v / a) {
+        seg->vel = v;
+        seg->t_a = v / a;
+        seg->t_v = (seg->distance - v * v / a) / v;
+    } else {
+        // Triangular profile, max_vel never reached
+        seg->t_a = sqrtf(seg->distance / a);
+        seg->vel = a * seg->t_a;
+        seg->t_v = 0.0f;
+    }
+}
+
+// Symmetric double-S profile (Biagiotti & Melchiorri, rest-to-rest case)
+static void traj_plan_scurve(traj_segment_t* seg, const traj_limits_t* limits) {
+    float v = limits->max_vel;
+    float a = limits->max_acc;
+    float j = limits->max_jerk;
+    float d = seg->distance;
+    float t_j, t_a, t_v;
+
+    if (v * j >= a * a) {
+        t_j = a / j;
+        t_a = t_j + v / a;
+    } else {
+        t_j = sqrtf(v / j);
+        t_a = 2.0f * t_j;
+    }
+
+    t_v = d / v - t_a;
+    if (t_v < 0.0f) {
+        // max_vel is not reached, shrink the acceleration phase
+        t_v = 0.0f;
+        if (d >= 2.0f * a * a * a / (j * j)) {
+            t_j = a / j;
+            t_a = 0.5f * t_j + sqrtf(0.25f * t_j * t_j + d / a);
+        } else {
+            t_j = cbrtf(0.5f * d / j);
+            t_a = 2.0f * t_j;
+        }
+    }
+
+    seg->jerk = j;
+    seg->t_j = t_j;
+    seg->t_a = t_a;
+    seg->t_v = t_v;
+    seg->acc = j * t_j;
+    seg->vel = seg->acc * (t_a - t_j);
+}
+
+// Apply a constant jerk for t seconds
+static void traj_integrate(traj_state_t* s, float jerk, float t) {
+    s->pos += t * (s->vel + t * (0.5f * s->acc + t * jerk / 6.0f));
+    s->vel += t * (s->acc + 0.5f * jerk * t);
+    s->acc += jerk * t;
+}
+
+// Travel needed to come to rest (vel = acc = 0) as fast as the limits allow
+static float traj_stop_distance(float vel, float acc, float max_acc, float max_jerk) {
+    // Brake against the velocity left once the current acceleration is ramped out
+    float dir = (vel + acc * fabsf(acc) / (2.0f * max_jerk) >= 0.0f) ? 1.0f : -1.0f;
+    vel *= dir;
+    acc *= dir;
+
+    float peak = sqrtf(fmaxf(max_jerk * vel + 0.5f * acc * acc, 0.0f));
+    float hold = 0.0f;
+    if (peak > max_acc) {
+        peak = max_acc;
+        hold = (vel + acc * acc / (2.0f * max_jerk) - max_acc * max_acc / max_jerk) / max_acc;
+    }
+
+    traj_state_t s = { .pos = 0.0f, .vel = vel, .acc = acc };
+    if (acc > -peak) {
+        traj_integrate(&s, -max_jerk, (acc + peak) / max_jerk);
+    } else {
+        traj_integrate(&s, max_jerk, (-peak - acc) / max_jerk);
+    }
+    if (hold > 0.0f) {
+        traj_integrate(&s, 0.0f, hold);
+    }
+    traj_integrate(&s, max_jerk, peak / max_jerk);
+    return dir * s.pos;
+}
+
+// Can the generator apply jerk for one tick and still stop on target within max_vel?
+static bool traj_otg_admissible(const traj_state_t* s, float error, float jerk,
+                                const traj_limits_t* limits, float dt) {
+    traj_state_t next = *s;
+    traj_integrate(&next, jerk, dt);
+
+    float peak_vel = next.vel + next.acc * fabsf(next.acc) / (2.0f * limits->max_jerk);
+    if (peak_vel > limits->max_vel) {
+        return false;
+    }
+    return next.pos + traj_stop_distance(next.vel, next.acc, limits->max_acc,
+                                         limits->max_jerk) <= error;
+}
@@ -0,0 +1,85 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "stdbool.h"
+
+// Velocity profile shapes
+typedef enum {
+    TRAJ_PROFILE_LINEAR = 0,    // Constant velocity, instant start/stop (legacy ramp)
+    TRAJ_PROFILE_TRAPEZOID,     // Acceleration limited
+    TRAJ_PROFILE_SCURVE         // Acceleration and jerk limited
+} traj_profile_t;
+
+// Kinematic limits of one joint (degrees, seconds)
+typedef struct {
+    float max_vel;      // deg/s
+    float max_acc;      // deg/s^2
+    float max_jerk;     // deg/s^3
+} traj_limits_t;
+
+// Sampled kinematic state
+typedef struct {
+    float pos;
+    float vel;
+    float acc;
+} traj_state_t;
+
+// Planned rest-to-rest move. Phases are symmetric: accelerate for t_a,
+// cruise for t_v, decelerate for t_a. t_j is the jerk ramp inside t_a.
+typedef struct {
+    traj_profile_t profile;
+    float start;        // Start position
+    float distance;     // Absolute travel
+    float dir;          // +1 or -1
+    float jerk;         // Jerk used during t_j
+    float acc;          // Peak acceleration reached
+    float vel;          // Peak velocity reached
+    float t_j;
+    float t_a;
+    float t_v;
+    float duration;     // Total move time (seconds)
+    float time_scale;   // < 1 slows the planned profile down (see traj_stretch)
+} traj_segment_t;
+
+// Cubic polynomial p(tau) = c0 + c1*tau + c2*tau^2 + c3*tau^3, tau in seconds
+typedef struct {
+    float c0;
+    float c1;
+    float c2;
+    float c3;
+} traj_cubic_t;
+
+// Plan a move from start to end within limits. Returns false if a limit the
+// chosen profile needs is not positive.
+bool traj_plan(traj_segment_t* seg, float start, float end,
+               const traj_limits_t* limits, traj_profile_t profile);
+
+// Sample position/velocity/acceleration at time t (clamped to [0, duration])
+void traj_sample(const traj_segment_t* seg, float t, traj_state_t* out);
+
+// Slow the segment down so it lasts exactly duration seconds. Returns false
+// for an empty segment, or a duration shorter than planned (it would break
+// the limits).
+bool traj_stretch(traj_segment_t* seg, float duration);
+
+// Cubic Hermite segment from p1 (slope m1) to p2 (slope m2) over h seconds.
+// With Catmull-Rom tangents, m = (p_next - p_prev) / (t_next - t_prev).
+void traj_cubic_hermite(traj_cubic_t* c, float p1, float p2, float m1, float m2, float h);
+void traj_cubic_sample(const traj_cubic_t* c, float tau, traj_state_t* out);
+
+// Online jerk-limited generator: advance state by dt towards target using
+// the largest jerk that still lets it stop on target within limits. target
+// may change between calls. Fixed cost per call (TRAJ_OTG_ITERATIONS
+// bisection steps). Returns true once the state has settled on target.
+#define TRAJ_OTG_ITERATIONS     (12)
+bool traj_otg_step(traj_state_t* state, float target, const traj_limits_t* limits, float dt);
+// Where state comes to rest braking as hard as limits allow. As a target for
+// traj_otg_step() it makes the generator brake without overshoot.
+float traj_stop_position(const traj_state_t* state, const traj_limits_t* limits);
+
+// Final position of the segment
+float traj_end_position(const traj_segment_t* seg);
+
+const char* traj_profile_name(traj_profile_t profile);
+
+#endif // TRAJECTORY_H
@@ -0,0 +1,203 @@
+#include "uart_parser.h"
+#include <string.h>
+
+// CRC-16/CCITT (poly 0x1021) one nibble at a time: a 32-byte table instead
+// of 512, still well below a microsecond per frame.
+static const uint16_t uart_crc16_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+// Private function prototypes
+static void uart_parser_restart(uart_parser_t* parser);
+static inline uint16_t uart_crc16_byte(uint16_t crc, uint8_t byte);
+
+void uart_parser_init(uart_parser_t* parser, uart_frame_handler_t handler, void* arg) {
+    memset(parser, 0, sizeof(*parser));
+    parser->handler = handler;
+    parser->arg = arg;
+    parser->state = UART_PARSER_HUNT;
+    parser->legacy_mode = UART_LEGACY_AUTO;
+    parser->legacy_enabled = true;
+}
+
+void uart_parser_reset(uart_parser_t* parser) {
+    if (parser->state != UART_PARSER_HUNT) {
+        uart_parser_restart(parser);
+    }
+    parser->resyncs++;
+}
+
+void uart_parser_set_legacy(uart_parser_t* parser, uart_legacy_mode_t mode) {
+    parser->legacy_mode = mode;
+    parser->legacy_enabled = mode != UART_LEGACY_OFF;
+}
+
+int uart_parser_feed(uart_parser_t* parser, const uint8_t* data, size_t length) {
+    int delivered = 0;
+    size_t i = 0;
+
+    while (i < length) {
+        uint8_t byte = data[i];
+
+        switch (parser->state) {
+            case UART_PARSER_HUNT:
+                i++;
+                if (byte == PROTO_SYNC) {
+                    parser->crc = UART_CRC16_INIT;
+                    parser->state = UART_PARSER_VERSION;
+                } else if (byte <= UART_LEGACY_MAX_BYTE && parser->legacy_enabled) {
+                    // A legacy command is complete in one byte: hand it over in place
+                    uart_frame_t frame = {
+                        .type = UART_FRAME_LEGACY,
+                        .seq = 0,
+                        .payload = &data[i - 1],
+                        .length = 1
+                    };
+                    parser->handler(&frame, parser->arg);
+                    parser->legacy++;
+                    delivered++;
+                } else {
+                    parser->dropped++;
+                }
+                break;
+
+            case UART_PARSER_VERSION:
+            case UART_PARSER_LENGTH:
+                // Not a frame after all. Look at this byte again from HUNT,
+                // it may be the real sync.
+                if ((parser->state == UART_PARSER_VERSION && byte != PROTO_VERSION) ||
+                    (parser->state == UART_PARSER_LENGTH && byte > PROTO_MAX_PAYLOAD)) {
+                    uart_parser_restart(parser);
+                    break;
+                }
+                i++;
+                parser->crc = uart_crc16_byte(parser->crc, byte);
+                if (parser->state == UART_PARSER_VERSION) {
+                    parser->state = UART_PARSER_LENGTH;
+                } else {
+                    parser->length = byte;
+                    parser->state = UART_PARSER_TYPE;
+                }
+                break;
+
+            case UART_PARSER_TYPE:
+                i++;
+                parser->crc = uart_crc16_byte(parser->crc, byte);
+                parser->type = byte;
+                parser->state = UART_PARSER_SEQ;
+                break;
+
+            case UART_PARSER_SEQ:
+                i++;
+                parser->crc = uart_crc16_byte(parser->crc, byte);
+                parser->seq = byte;
+                parser->filled = 0;
+                parser->payload = parser->scratch;
+                parser->state = parser->length > 0 ? UART_PARSER_PAYLOAD : UART_PARSER_CRC_LO;
+                break;
+
+            case UART_PARSER_PAYLOAD: {
+                size_t take = parser->length - parser->filled;
+                if (take > length - i) {
+                    take = length - i;
+                }
+                if (parser->filled == 0 && take == parser->length) {
+                    parser->payload = &data[i];     // Whole payload in this span
+                } else {
+                    memcpy(&parser->scratch[parser->filled], &data[i], take);
+                }
+                parser->crc = uart_crc16(parser->crc, &data[i], take);
+                parser->filled += (uint8_t)take;
+                i += take;
+                if (parser->filled == parser->length) {
+                    parser->state = UART_PARSER_CRC_LO;
+                }
+                break;
+            }
+
+            case UART_PARSER_CRC_LO:
+                i++;
+                parser->received_crc = byte;
+                parser->state = UART_PARSER_CRC_HI;
+                break;
+
+            case UART_PARSER_CRC_HI:
+                i++;
+                parser->received_crc |= (uint16_t)byte << 8;
+                if (parser->received_crc == parser->crc) {
+                    uart_frame_t frame = {
+                        .type = parser->type,
+                        .seq = parser->seq,
+                        .payload = parser->payload,
+                        .length = parser->length
+                    };
+                    // The host speaks v2: low bytes from here on are damage, not gestures
+                    if (parser->legacy_mode == UART_LEGACY_AUTO) {
+                        parser->legacy_enabled = false;
+                    }
+                    parser->handler(&frame, parser->arg);
+                    parser->frames++;
+                    delivered++;
+                } else {
+                    // The bytes inside a bad frame are not rescanned; the next
+                    // sync after it starts over
+                    parser->crc_errors++;
+                }
+                parser->state = UART_PARSER_HUNT;
+                break;
+        }
+    }
+
+    // The CRC is still to come but data goes away after this call
+    if ((parser->state == UART_PARSER_CRC_LO || parser->state == UART_PARSER_CRC_HI) &&
+        parser->payload != parser->scratch) {
+        memcpy(parser->scratch, parser->payload, parser->length);
+        parser->payload = parser->scratch;
+    }
+    return delivered;
+}
+
+uint16_t uart_crc16(uint16_t crc, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        crc = uart_crc16_byte(crc, data[i]);
+    }
+    return crc;
+}
+
+size_t uart_frame_encode(uint8_t* out, uint8_t type, uint8_t seq,
+                         const void* payload, size_t length) {
+    if (length > PROTO_MAX_PAYLOAD) {
+        return 0;
+    }
+    out[0] = PROTO_SYNC;
+    out[1] = PROTO_VERSION;
+    out[2] = (uint8_t)length;
+    out[3] = type;
+    out[4] = seq;
+    if (length > 0) {
+        memcpy(&out[PROTO_HEADER_SIZE], payload, length);
+    }
+    uint16_t crc = uart_crc16(UART_CRC16_INIT, &out[1], PROTO_HEADER_SIZE - 1 + length);
+    out[PROTO_HEADER_SIZE + length] = (uint8_t)(crc & 0xFF);
+    out[PROTO_HEADER_SIZE + length + 1] = (uint8_t)(crc >> 8);
+    return PROTO_HEADER_SIZE + length + PROTO_CRC_SIZE;
+}
+
+// Private function implementations
+static void uart_parser_restart(uart_parser_t* parser) {
+    // Every byte accepted into the abandoned frame: the state number counts
+    // the header bytes up to the payload
+    uint32_t accepted = (uint32_t)parser->state;
+    if (parser->state >= UART_PARSER_PAYLOAD) {
+        accepted = PROTO_HEADER_SIZE + parser->filled + (parser->state == UART_PARSER_CRC_HI);
+    }
+    parser->dropped += accepted;
+    parser->state = UART_PARSER_HUNT;
+}
+
+static inline uint16_t uart_crc16_byte(uint16_t crc, uint8_t byte) {
+    crc = (uint16_t)(crc << 4) ^ uart_crc16_nibble[(crc >> 12) ^ (byte >> 4)];
+    crc = (uint16_t)(crc << 4) ^ uart_crc16_nibble[(crc >> 12) ^ (byte & 0x0F)];
+    return crc;
+}
@@ -0,0 +1,98 @@
+#ifndef UART_PARSER_H
+#define UART_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "protocol_v2.h"
+
+// Incremental command-link parser. Bytes are fed in whatever chunks the
+// transport delivers (a frame may be split across any number of calls) and
+// each complete frame is handed to the handler as soon as its last byte is
+// seen. No ESP-IDF dependencies so it also builds on the host.
+//
+// Two kinds of frame share the link:
+//  - v2 frames (protocol_v2.h), starting with PROTO_SYNC and checked by CRC
+//  - legacy gesture bytes between frames, one byte per command: 00JJ LLLD
+//      JJ  joint (bits 5-4)
+//      LLL intensity 0-7 (bits 3-1)
+//      D   direction, 1 = increase (bit 0)
+// A gesture byte has no check of its own, so the header and payload bytes
+// of a frame whose sync was lost would each decode as one. By default the
+// parser stops decoding them at the first good v2 frame: from then on the
+// host is known to speak v2 and a stray low byte is line damage.
+
+#define UART_LEGACY_MAX_BYTE    (0x3F)
+#define UART_FRAME_LEGACY       (0x00)      // Frame type of a legacy byte, never a v2 type
+
+#define UART_CRC16_INIT         (0xFFFF)
+
+typedef enum {
+    UART_LEGACY_AUTO = 0,       // Gesture bytes until the first good v2 frame
+    UART_LEGACY_ON,             // Always, for a gesture-only host
+    UART_LEGACY_OFF             // Never
+} uart_legacy_mode_t;
+
+typedef enum {
+    UART_PARSER_HUNT = 0,       // Between frames
+    UART_PARSER_VERSION,
+    UART_PARSER_LENGTH,
+    UART_PARSER_TYPE,
+    UART_PARSER_SEQ,
+    UART_PARSER_PAYLOAD,
+    UART_PARSER_CRC_LO,
+    UART_PARSER_CRC_HI,
+} uart_parser_state_t;
+
+// Payload points into the buffer passed to uart_parser_feed() when the whole
+// frame arrived in one call, otherwise into the parser's scratch buffer.
+// Either way it is only valid for the duration of the handler call.
+typedef struct {
+    uint8_t type;               // proto_msg_type_t or UART_FRAME_LEGACY
+    uint8_t seq;
+    const uint8_t* payload;
+    size_t length;
+} uart_frame_t;
+
+typedef void (*uart_frame_handler_t)(const uart_frame_t* frame, void* arg);
+
+typedef struct {
+    uart_frame_handler_t handler;
+    void* arg;
+    uart_legacy_mode_t legacy_mode;
+    bool legacy_enabled;        // Gesture bytes are delivered, not dropped
+
+    // Frame in progress
+    uart_parser_state_t state;
+    uint8_t type;
+    uint8_t seq;
+    uint8_t length;
+    uint8_t filled;             // Payload bytes received
+    uint16_t crc;               // Running CRC over version..payload
+    uint16_t received_crc;
+    const uint8_t* payload;
+    uint8_t scratch[PROTO_MAX_PAYLOAD];
+
+    uint32_t frames;            // v2 frames delivered
+    uint32_t legacy;            // Legacy bytes delivered
+    uint32_t dropped;           // Bytes discarded outside a valid frame
+    uint32_t crc_errors;
+    uint32_t resyncs;           // uart_parser_reset() calls
+} uart_parser_t;
+
+void uart_parser_init(uart_parser_t* parser, uart_frame_handler_t handler, void* arg);
+// Drop any partial frame, e.g. after the transport lost bytes
+void uart_parser_reset(uart_parser_t* parser);
+// Select how gesture bytes are treated; UART_LEGACY_AUTO after init
+void uart_parser_set_legacy(uart_parser_t* parser, uart_legacy_mode_t mode);
+// Consume all of data; returns the number of frames delivered
+int uart_parser_feed(uart_parser_t* parser, const uint8_t* data, size_t length);
+
+// CRC-16/CCITT-FALSE, start with UART_CRC16_INIT
+uint16_t uart_crc16(uint16_t crc, const uint8_t* data, size_t length);
+// Build a v2 frame in out (PROTO_HEADER_SIZE + length + PROTO_CRC_SIZE bytes).
+// Returns the frame size, 0 if length exceeds PROTO_MAX_PAYLOAD.
+size_t uart_frame_encode(uint8_t* out, uint8_t type, uint8_t seq,
+                         const void* payload, size_t length);
+
+#endif // UART_PARSER_H
@@ -0,0 +1,83 @@
+// Host microbenchmark for kin_inverse() and kin_forward().
+//
+//   gcc -O2 -I main tools/bench/ik_bench.c main/kinematics.c -lm -o ik_bench
+//   ./ik_bench
+//
+// Also checks the IK/FK round trip over the workspace. Budget on target is
+// 20 us per IK solve; the ESP32 FPU runs single-precision libm roughly
+// 20-40x slower than a desktop core, so keep the host figure under ~0.5 us.
+
+#include "kinematics.h"
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_POSES     4096
+#define BENCH_ROUNDS    200
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void) {
+    const kin_config_t cfg = DEFAULT_KIN_CONFIG();
+    static kin_pose_t poses[BENCH_POSES];
+    int reachable = 0;
+    float max_err = 0.0f;
+
+    // Sample poses by forward kinematics over the joint ranges
+    unsigned seed = 1;
+    for (int i = 0; i < BENCH_POSES; i++) {
+        kin_joints_t j;
+        float* q = &j.base;
+        for (int k = 0; k < 4; k++) {
+            seed = seed * 1103515245u + 12345u;
+            q[k] = 20.0f + 140.0f * (float)((seed >> 8) & 0xFFFF) / 65535.0f;
+        }
+        kin_forward(&cfg, &j, &poses[i]);
+    }
+
+    // Round trip accuracy
+    for (int i = 0; i < BENCH_POSES; i++) {
+        kin_joints_t j;
+        kin_pose_t back;
+        if (!kin_inverse(&cfg, &poses[i], 0.0f, 180.0f, &j)) {
+            continue;
+        }
+        reachable++;
+        kin_forward(&cfg, &j, &back);
+        float err = fabsf(back.x - poses[i].x) + fabsf(back.y - poses[i].y) +
+                    fabsf(back.z - poses[i].z);
+        if (err > max_err) {
+            max_err = err;
+        }
+    }
+
+    volatile float sink = 0.0f;
+    double t0 = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int i = 0; i < BENCH_POSES; i++) {
+            kin_joints_t j = {0};
+            kin_inverse(&cfg, &poses[i], 0.0f, 180.0f, &j);
+            sink += j.shoulder;
+        }
+    }
+    double ik_ns = (now_ns() - t0) / ((double)BENCH_ROUNDS * BENCH_POSES);
+
+    t0 = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int i = 0; i < BENCH_POSES; i++) {
+            kin_joints_t j = { 90.0f, 90.0f, (float)(i & 127), 90.0f };
+            kin_pose_t p;
+            kin_forward(&cfg, &j, &p);
+            sink += p.z;
+        }
+    }
+    double fk_ns = (now_ns() - t0) / ((double)BENCH_ROUNDS * BENCH_POSES);
+
+    printf("reachable %d/%d, max round-trip error %.4f mm\n", reachable, BENCH_POSES, max_err);
+    printf("kin_inverse %.1f ns/solve, kin_forward %.1f ns/solve\n", ik_ns, fk_ns);
+    return 0;
+}
@@ -0,0 +1,214 @@
+// Host microbenchmark for the command-link parser.
+//
+//   gcc -O2 -I main tools/bench/parser_bench.c main/uart_parser.c -o parser_bench
+//   ./parser_bench
+//
+// Feeds a mixed stream (v2 pose and joint frames, legacy gesture bytes, line
+// noise and frames with a flipped bit) in the chunk sizes the RX path
+// produces: single bytes from the idle timeout, FIFO-threshold bursts, and
+// ring spans. Also checks that every good frame is delivered exactly once and
+// every corrupted one rejected, however the stream is split, and that a pose
+// frame with a damaged sync or version byte after v2 traffic never comes out
+// as legacy gesture bytes. The link tops
+// out at baud/10 bytes/s (92160 at 921600), so the parser needs only a tiny
+// fraction of a core; the host figure mainly guards against regressions.
+
+#include "uart_parser.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_STREAM_BYTES  (1 << 20)
+#define BENCH_ROUNDS        20
+
+typedef struct {
+    uint32_t frames;
+    uint32_t checksum;
+} bench_sink_t;
+
+static uint8_t stream[BENCH_STREAM_BYTES];
+static size_t stream_length = 0;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t frame_checksum(uint32_t sum, uint8_t type, uint8_t seq,
+                               const uint8_t* payload, size_t length) {
+    sum = sum * 31u + type;
+    sum = sum * 31u + seq;
+    for (size_t i = 0; i < length; i++) {
+        sum = sum * 31u + payload[i];
+    }
+    return sum;
+}
+
+static void bench_handler(const uart_frame_t* frame, void* arg) {
+    bench_sink_t* sink = (bench_sink_t*)arg;
+    sink->frames++;
+    sink->checksum = frame_checksum(sink->checksum, frame->type, frame->seq,
+                                    frame->payload, frame->length);
+}
+
+// Returns the number of good frames in the stream
+static uint32_t build_stream(uint32_t* checksum, uint32_t* corrupted) {
+    unsigned seed = 1;
+    uint32_t frames = 0;
+    uint8_t seq = 0;
+
+    *checksum = 0;
+    *corrupted = 0;
+    while (1) {
+        seed = seed * 1103515245u + 12345u;
+        unsigned pick = (seed >> 16) % 100;
+        uint8_t payload[PROTO_POSE_SIZE(4)];
+        size_t payload_length;
+        uint8_t type;
+
+        if (pick < 40) {
+            // Four-joint pose, the common streaming case
+            proto_msg_pose_t* pose = (proto_msg_pose_t*)payload;
+            memset(pose, 0, sizeof(*pose));
+            pose->count = 4;
+            for (int j = 0; j < 4; j++) {
+                pose->target_mdeg[j] = (int32_t)((seed >> 4) % 180000) + j;
+            }
+            type = PROTO_MSG_POSE;
+            payload_length = PROTO_POSE_SIZE(4);
+        } else if (pick < 70) {
+            proto_msg_joint_target_t* target = (proto_msg_joint_target_t*)payload;
+            target->joint = (uint8_t)(seed & 3);
+            target->target_mdeg = (int32_t)((seed >> 4) % 180000);
+            target->speed_mdeg_s = 0;
+            type = PROTO_MSG_JOINT_TARGET;
+            payload_length = PROTO_JOINT_TARGET_SIZE;
+        } else if (pick < 95) {
+            if (stream_length + 1 > BENCH_STREAM_BYTES) {
+                break;
+            }
+            uint8_t byte = (uint8_t)((seed >> 8) & UART_LEGACY_MAX_BYTE);
+            stream[stream_length++] = byte;
+            *checksum = frame_checksum(*checksum, UART_FRAME_LEGACY, 0, &byte, 1);
+            frames++;
+            continue;
+        } else if (pick < 98) {
+            if (stream_length + 1 > BENCH_STREAM_BYTES) {
+                break;
+            }
+            stream[stream_length++] = (uint8_t)(0x40 | (seed >> 8));  // Noise, never a sync
+            if (stream[stream_length - 1] == PROTO_SYNC) {
+                stream[stream_length - 1] = 0x40;
+            }
+            continue;
+        } else {
+            // Frame with one flipped payload bit: the CRC must catch it
+            uint8_t frame[PROTO_MAX_FRAME];
+            memset(payload, 0x55, PROTO_JOG_SIZE);
+            size_t size = uart_frame_encode(frame, PROTO_MSG_JOG, seq++, payload, PROTO_JOG_SIZE);
+            if (stream_length + size > BENCH_STREAM_BYTES) {
+                break;
+            }
+            frame[PROTO_HEADER_SIZE + 2] ^= 0x10;
+            memcpy(&stream[stream_length], frame, size);
+            stream_length += size;
+            (*corrupted)++;
+            continue;
+        }
+
+        if (stream_length + PROTO_HEADER_SIZE + payload_length + PROTO_CRC_SIZE > BENCH_STREAM_BYTES) {
+            break;
+        }
+        stream_length += uart_frame_encode(&stream[stream_length], type, seq, payload, payload_length);
+        *checksum = frame_checksum(*checksum, type, seq, payload, payload_length);
+        seq++;
+        frames++;
+    }
+    return frames;
+}
+
+static int run(size_t chunk, uint32_t expect_frames, uint32_t expect_checksum, uint32_t expect_crc) {
+    bench_sink_t sink = {0};
+    uart_parser_t parser;
+    uint32_t crc_errors = 0;
+
+    double t0 = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uart_parser_init(&parser, bench_handler, &sink);
+        uart_parser_set_legacy(&parser, UART_LEGACY_ON);    // The mix interleaves both kinds
+        sink.frames = 0;
+        sink.checksum = 0;
+        for (size_t off = 0; off < stream_length; off += chunk) {
+            size_t len = stream_length - off < chunk ? stream_length - off : chunk;
+            uart_parser_feed(&parser, &stream[off], len);
+        }
+        crc_errors = parser.crc_errors;
+    }
+    double s = (now_ns() - t0) * 1e-9;
+
+    int ok = sink.frames == expect_frames && sink.checksum == expect_checksum &&
+             crc_errors == expect_crc;
+    printf("chunk %4zu: %6.1f Mframes/s %7.1f MB/s %s\n", chunk,
+           (double)expect_frames * BENCH_ROUNDS / s * 1e-6,
+           (double)stream_length * BENCH_ROUNDS / s * 1e-6,
+           ok ? "" : "MISMATCH");
+    return ok;
+}
+
+static void count_handler(const uart_frame_t* frame, void* arg) {
+    uint32_t* counts = (uint32_t*)arg;
+    counts[frame->type == UART_FRAME_LEGACY ? 0 : 1]++;
+}
+
+// A good pose, then the same pose with one bit flipped in the sync or the
+// version byte, then the good pose again: two v2 frames and no gestures
+static int check_lost_sync(size_t chunk) {
+    uint8_t payload[PROTO_POSE_SIZE(4)];
+    proto_msg_pose_t* pose = (proto_msg_pose_t*)payload;
+    memset(payload, 0, sizeof(payload));
+    pose->count = 4;
+    for (int j = 0; j < 4; j++) {
+        pose->target_mdeg[j] = 90000 + j;
+    }
+    uint8_t good[PROTO_MAX_FRAME];
+    size_t size = uart_frame_encode(good, PROTO_MSG_POSE, 1, payload, sizeof(payload));
+
+    for (int byte = 0; byte < 2; byte++) {
+        for (int bit = 0; bit < 8; bit++) {
+            uint8_t line[3 * PROTO_MAX_FRAME];
+            memcpy(line, good, size);
+            memcpy(&line[size], good, size);
+            line[size + byte] ^= (uint8_t)(1u << bit);
+            memcpy(&line[2 * size], good, size);
+
+            uint32_t counts[2] = {0, 0};
+            uart_parser_t parser;
+            uart_parser_init(&parser, count_handler, counts);
+            for (size_t off = 0; off < 3 * size; off += chunk) {
+                size_t len = 3 * size - off < chunk ? 3 * size - off : chunk;
+                uart_parser_feed(&parser, &line[off], len);
+            }
+            if (counts[0] != 0 || counts[1] != 2) {
+                printf("chunk %4zu: %s bit %d flipped: %u gestures, %u frames MISMATCH\n", chunk,
+                       byte == 0 ? "sync" : "version", bit, counts[0], counts[1]);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int main(void) {
+    uint32_t checksum, corrupted;
+    uint32_t frames = build_stream(&checksum, &corrupted);
+    const size_t chunks[] = {1, 16, 64, 1024};
+    int ok = 1;
+
+    printf("%u frames, %u corrupted, in %zu bytes\n", frames, corrupted, stream_length);
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        ok &= run(chunks[i], frames, checksum, corrupted);
+        ok &= check_lost_sync(chunks[i]);
+    }
+    return ok ? 0 : 1;
+}
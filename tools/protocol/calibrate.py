@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""Read, trim and save the servo calibration over the command link.
+
+    python3 tools/protocol/calibrate.py /dev/ttyUSB0                 # every joint
+    python3 tools/protocol/calibrate.py /dev/ttyUSB0 --joint 2 --min-us 520 --max-us 2480
+    python3 tools/protocol/calibrate.py /dev/ttyUSB0 --joint 0 --offset 1.5 --save
+
+A change takes effect on the joint's next output write. --save persists the
+calibration of every joint to NVS, where it is loaded at boot.
+"""
+
+import argparse
+import sys
+
+import protocol_v2 as proto
+from link import Link
+
+
+def show(fields):
+    print('joint %d: %4d-%4d us  offset %+8.3f deg%s  limits [%.3f, %.3f] deg'
+          % (fields['joint'], fields['min_pulse_us'], fields['max_pulse_us'],
+             fields['offset_mdeg'] / 1000.0, '  inverted' if fields['inverted'] else '',
+             fields['soft_min_mdeg'] / 1000.0, fields['soft_max_mdeg'] / 1000.0))
+
+
+def calibration(link, flags, joint, fields):
+    reply = link.request(proto.encode_calibration, flags, joint, fields['min_pulse_us'],
+                         fields['max_pulse_us'], fields['offset_mdeg'], fields['inverted'],
+                         fields['soft_min_mdeg'], fields['soft_max_mdeg'])
+    if reply is None:
+        sys.exit('no reply for joint %d' % joint)
+    if reply[0] != proto.MSG_CALIBRATION_REPLY:
+        sys.exit('joint %d: refused with status %d' % (joint, reply[1]['status']))
+    return reply[1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('port')
+    parser.add_argument('--joint', type=int, help='joint to change, all joints are listed without it')
+    parser.add_argument('--min-us', type=int, help='pulse width at 0 degrees')
+    parser.add_argument('--max-us', type=int, help='pulse width at the top of the range')
+    parser.add_argument('--offset', type=float, help='centre trim, degrees')
+    parser.add_argument('--inverted', type=int, choices=(0, 1))
+    parser.add_argument('--soft-min', type=float, help='degrees')
+    parser.add_argument('--soft-max', type=float, help='degrees')
+    parser.add_argument('--save', action='store_true', help='persist every joint to NVS')
+    args = parser.parse_args()
+
+    link = Link(args.port)
+    empty = dict.fromkeys(('min_pulse_us', 'max_pulse_us', 'offset_mdeg', 'inverted',
+                           'soft_min_mdeg', 'soft_max_mdeg'), 0)
+    if args.joint is None:
+        info = link.request(proto.encode_query, proto.QUERY_INFO)
+        if info is None or info[0] != proto.MSG_INFO:
+            sys.exit('no info reply')
+        for joint in range(info[1]['joint_count']):
+            show(calibration(link, 0, joint, empty))
+        if args.save:
+            calibration(link, proto.CALIB_SAVE, 0, empty)
+            print('saved')
+        link.close()
+        return
+
+    # Start from what the joint has, so only the given values change
+    fields = calibration(link, 0, args.joint, empty)
+    changes = {'min_pulse_us': args.min_us, 'max_pulse_us': args.max_us, 'inverted': args.inverted,
+               'offset_mdeg': None if args.offset is None else int(round(args.offset * 1000)),
+               'soft_min_mdeg': None if args.soft_min is None else int(round(args.soft_min * 1000)),
+               'soft_max_mdeg': None if args.soft_max is None else int(round(args.soft_max * 1000))}
+    changes = {key: value for key, value in changes.items() if value is not None}
+    fields.update(changes)
+    flags = (proto.CALIB_SET if changes else 0) | (proto.CALIB_SAVE if args.save else 0)
+    show(calibration(link, flags, args.joint, fields))
+    if args.save:
+        print('saved')
+    link.close()
+
+
+if __name__ == '__main__':
+    main()
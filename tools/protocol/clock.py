@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""Host estimate of the device clock, for scheduling timed commands.
+
+    from clock import Clock
+    clock = Clock(link).sync()
+    at = clock.device_us(delay_s=0.1)       # 100 ms from now on the device
+    link.send(protocol_v2.encode_batch, protocol_v2.FLAG_TIMED, 0b11, 0, at, [90000, 45000])
+
+    python3 tools/protocol/clock.py /dev/ttyUSB0 --seconds 60
+
+Each exchange is a clock query: the host's send time t0 rides in the stamp,
+the device returns when the query reached its receive ring (t1) and when it
+wrote the reply (t2), and the host notes t3 on arrival. As in NTP,
+
+    offset = ((t1 - t0) + (t2 - t3)) / 2      delay = (t3 - t0) - (t2 - t1)
+
+A slow exchange spent its extra time in a queue on one side or the other, so
+only the fastest exchanges of the window are used. A straight line through
+their offsets against host time gives the offset now and the drift between
+the two crystals (typically tens of ppm), so the estimate stays good between
+syncs. All device times are the low 32 bits of esp_timer, as in exec_us.
+"""
+
+import argparse
+import collections
+import time
+
+import protocol_v2 as proto
+from link import Link
+
+MASK = 0xFFFFFFFF
+WINDOW = 64             # Exchanges kept for the fit
+FASTEST = 0.5           # Fraction of them, by delay, that the fit uses
+
+
+def signed32(value):
+    value &= MASK
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def host_now_us():
+    """Host clock, not wrapped; proto.host_time_us() is its low 32 bits"""
+    return time.monotonic_ns() // 1000
+
+
+class Clock:
+    def __init__(self, link, window=WINDOW):
+        self.link = link
+        self.samples = collections.deque(maxlen=window)    # (host_us, offset_us, delay_us)
+        self.base = None        # First offset; the others are kept relative to it
+        self.ref_us = 0         # Host time the fit is centred on
+        self.offset = 0.0       # Device minus host at ref_us, relative to base
+        self.drift = 0.0        # Device us gained per host us
+
+    def exchange(self, timeout=0.2):
+        """One clock query: (offset_us, delay_us), or None if unanswered.
+        Reads byte-wise so t3 is not skewed by the serial read timeout."""
+        serial = self.link.serial
+        t0 = host_now_us()
+        seq = self.link.send(proto.encode_query, proto.QUERY_CLOCK, t0 & MASK)
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            frames = self.link.read(serial.in_waiting or 1)
+            t3 = host_now_us()
+            for msg_type, frame_seq, fields in frames:
+                if msg_type != proto.MSG_CLOCK or frame_seq != seq or fields is None:
+                    self.link.unsolicited.append((msg_type, frame_seq, fields))
+                    continue
+                t1, t2 = fields['rx_us'], fields['tx_us']
+                delay = (t3 - t0) - signed32(t2 - t1)
+                offset = signed32(t1 - t0) - delay / 2.0
+                self.add(t0 + (t3 - t0) // 2, offset, delay)
+                return offset, delay
+        return None
+
+    def add(self, host_us, offset, delay):
+        if self.base is None:
+            self.base = offset
+        # Relative to the first offset, so the raw offset crossing the wrap does not matter
+        self.samples.append((host_us, signed32(int(round(offset - self.base))), delay))
+        self.fit()
+
+    def fit(self):
+        ranked = sorted(self.samples, key=lambda s: s[2])
+        best = ranked[:max(1, int(len(ranked) * FASTEST))]
+        n = len(best)
+        self.ref_us = sum(s[0] for s in best) // n
+        mean = sum(s[1] for s in best) / n
+        xx = sum((s[0] - self.ref_us) ** 2 for s in best)
+        # A line needs samples spread over time, otherwise keep the last drift
+        if n >= 4 and xx > n * 1e12:
+            self.drift = sum((s[0] - self.ref_us) * (s[1] - mean) for s in best) / xx
+        self.offset = mean - self.drift * (sum(s[0] for s in best) / n - self.ref_us)
+
+    def sync(self, count=16, interval=0.02):
+        """A burst of exchanges, enough for a first offset; drift needs time"""
+        for _ in range(count):
+            self.exchange()
+            time.sleep(interval)
+        if self.base is None:
+            raise IOError('no clock replies')
+        return self
+
+    @property
+    def delay_us(self):
+        """Round trip of the fastest exchange in the window"""
+        return min(s[2] for s in self.samples)
+
+    def offset_us(self, host_us=None):
+        """Device minus host clock at host_us (default now), modulo 2^32"""
+        if host_us is None:
+            host_us = host_now_us()
+        return signed32(int(round(self.base + self.offset + self.drift * (host_us - self.ref_us))))
+
+    def device_us(self, delay_s=0.0, host_us=None):
+        """Device time (low 32 bits) at host time host_us (default now) plus delay_s"""
+        if host_us is None:
+            host_us = host_now_us()
+        host_us += int(delay_s * 1e6)
+        return (host_us + self.offset_us(host_us)) & MASK
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('port')
+    parser.add_argument('--seconds', type=float, default=30.0)
+    parser.add_argument('--interval', type=float, default=0.5, help='seconds between exchanges')
+    parser.add_argument('--baud', action='store_true', help='negotiate the fastest link rate first')
+    args = parser.parse_args()
+
+    link = Link(args.port)
+    if args.baud:
+        print('link at %d baud' % link.negotiate())
+    clock = Clock(link).sync()
+    print('offset %d us, fastest round trip %d us' % (clock.offset_us(), clock.delay_us))
+
+    end = time.monotonic() + args.seconds
+    while time.monotonic() < end:
+        time.sleep(args.interval)
+        # How far the estimate so far is from what this exchange measures
+        predicted = clock.offset_us()
+        sample = clock.exchange()
+        if sample is None:
+            print('no reply')
+            continue
+        offset, delay = sample
+        print('delay %6d us  error %+6d us  drift %+7.2f ppm'
+              % (delay, signed32(int(round(offset)) - predicted), clock.drift * 1e6))
+    link.close()
+
+
+if __name__ == '__main__':
+    main()
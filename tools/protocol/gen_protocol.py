@@ -0,0 +1,325 @@
+#!/usr/bin/env python3
+"""Generate the command-link wire layout from protocol_v2.json.
+
+    python3 tools/protocol/gen_protocol.py          # rewrite both outputs
+    python3 tools/protocol/gen_protocol.py --check  # fail if they are stale
+
+Outputs:
+    main/protocol_v2.h            packed C structs and constants (firmware)
+    tools/protocol/protocol_v2.py frame encoder/decoder (host)
+
+The schema is the only place a message layout is written down. A field type
+is u8/i8/u16/i16/u32/i32, or "<type>[<count field>]" for a trailing array
+whose length is given by an earlier field. The "stamp" field is prepended to
+every host command (id below 0x80); the Python encoders fill it from the
+host clock unless the caller passes one.
+"""
+
+import json
+import os
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(os.path.dirname(HERE))
+SCHEMA = os.path.join(HERE, "protocol_v2.json")
+C_OUT = os.path.join(ROOT, "main", "protocol_v2.h")
+PY_OUT = os.path.join(HERE, "protocol_v2.py")
+
+TYPES = {
+    "u8": ("uint8_t", "B", 1),
+    "i8": ("int8_t", "b", 1),
+    "u16": ("uint16_t", "H", 2),
+    "i16": ("int16_t", "h", 2),
+    "u32": ("uint32_t", "I", 4),
+    "i32": ("int32_t", "i", 4),
+}
+
+HEADER_SIZE = 5     # sync, version, length, type, seq
+CRC_SIZE = 2
+COMMAND_ID_LIMIT = 0x80     # Ids from here up are device messages
+
+
+def parse_field(field):
+    name, ftype = field[0], field[1]
+    doc = field[2] if len(field) > 2 else None
+    count = None
+    if "[" in ftype:
+        ftype, count = ftype[:-1].split("[")
+    if ftype not in TYPES:
+        sys.exit("unknown field type %r in %s" % (ftype, name))
+    return {"name": name, "type": ftype, "count": count, "doc": doc}
+
+
+def load_schema():
+    with open(SCHEMA) as f:
+        schema = json.load(f)
+    ids = set()
+    stamp = parse_field(schema["stamp"]) if "stamp" in schema else None
+    for msg in schema["messages"]:
+        msg["fields"] = [parse_field(f) for f in msg["fields"]]
+        msg["stamp"] = stamp if stamp and msg["id"] < COMMAND_ID_LIMIT else None
+        if msg["stamp"]:
+            msg["fields"].insert(0, dict(stamp))
+        if msg["id"] in ids or not 0 < msg["id"] < 256:
+            sys.exit("bad or duplicate id for %s" % msg["name"])
+        ids.add(msg["id"])
+        names = [f["name"] for f in msg["fields"]]
+        for i, field in enumerate(msg["fields"]):
+            if field["count"] is None:
+                continue
+            if i != len(msg["fields"]) - 1 or field["count"] not in names[:i]:
+                sys.exit("%s.%s: arrays must be last and counted by an earlier field"
+                         % (msg["name"], field["name"]))
+        msg["fixed"] = [f for f in msg["fields"] if f["count"] is None]
+        msg["array"] = next((f for f in msg["fields"] if f["count"] is not None), None)
+        msg["size"] = sum(TYPES[f["type"]][2] for f in msg["fixed"])
+        if msg["size"] > schema["max_payload"]:
+            sys.exit("%s does not fit max_payload" % msg["name"])
+    return schema
+
+
+def aligned(lines):
+    """(code, doc) pairs with the trailing comments in one column"""
+    width = max(len(code) for code, _ in lines)
+    return [("%-*s    // %s" % (width, code, doc)).rstrip() if doc else code
+            for code, doc in lines]
+
+
+def gen_c(schema):
+    out = []
+    w = out.append
+    w("// Generated by tools/protocol/gen_protocol.py from protocol_v2.json.")
+    w("// Do not edit; change the schema and regenerate.")
+    w("#ifndef PROTOCOL_V2_H")
+    w("#define PROTOCOL_V2_H")
+    w("")
+    w("#include <stdint.h>")
+    w("")
+    for line in schema["doc"]:
+        w("// " + line)
+    w("#define PROTO_SYNC          (0x%02X)" % schema["sync"])
+    w("#define PROTO_VERSION       (%d)" % schema["version"])
+    w("#define PROTO_HEADER_SIZE   (%d)" % HEADER_SIZE)
+    w("#define PROTO_CRC_SIZE      (%d)" % CRC_SIZE)
+    w("#define PROTO_MAX_PAYLOAD   (%d)" % schema["max_payload"])
+    w("#define PROTO_MAX_FRAME     (PROTO_HEADER_SIZE + PROTO_MAX_PAYLOAD + PROTO_CRC_SIZE)")
+    w("")
+
+    for enum in schema["enums"]:
+        prefix = "PROTO_%s_" % enum["name"].upper()
+        w("// " + enum["doc"])
+        w("typedef enum {")
+        out.extend(aligned([("    %s%s = %d," % (prefix, value[0].upper(), value[1]),
+                             value[2] if len(value) > 2 else None)
+                            for value in enum["values"]]))
+        w("} proto_%s_t;" % enum["name"])
+        w("")
+
+    w("typedef enum {")
+    out.extend(aligned([("    PROTO_MSG_%s = 0x%02X," % (msg["name"].upper(), msg["id"]), msg["doc"])
+                        for msg in schema["messages"]]))
+    w("} proto_msg_type_t;")
+    w("")
+
+    for msg in schema["messages"]:
+        name = msg["name"]
+        w("// " + msg["doc"])
+        w("typedef struct __attribute__((packed)) {")
+        out.extend(aligned([("    %s %s%s;" % (TYPES[field["type"]][0], field["name"],
+                                                "[]" if field["count"] else ""), field["doc"])
+                            for field in msg["fields"]]))
+        w("} proto_msg_%s_t;" % name)
+        if msg["array"]:
+            w("#define PROTO_%s_SIZE(count) (%d + %d * (count))"
+              % (name.upper(), msg["size"], TYPES[msg["array"]["type"]][2]))
+        else:
+            w("#define PROTO_%s_SIZE (%d)" % (name.upper(), msg["size"]))
+        w("_Static_assert(sizeof(proto_msg_%s_t) == %d, \"proto_msg_%s_t layout\");"
+          % (name, msg["size"], name))
+        w("")
+
+    w("#endif // PROTOCOL_V2_H")
+    return "\n".join(out) + "\n"
+
+
+def gen_py(schema):
+    out = []
+    w = out.append
+    w('"""Command-link protocol v2 host encoder/decoder.')
+    w("")
+    w("Generated by tools/protocol/gen_protocol.py from protocol_v2.json.")
+    w("Do not edit; change the schema and regenerate.")
+    w("")
+    for line in schema["doc"]:
+        w(line)
+    w('"""')
+    w("")
+    w("import struct")
+    w("import time")
+    w("")
+    w("SYNC = 0x%02X" % schema["sync"])
+    w("VERSION = %d" % schema["version"])
+    w("HEADER_SIZE = %d" % HEADER_SIZE)
+    w("CRC_SIZE = %d" % CRC_SIZE)
+    w("MAX_PAYLOAD = %d" % schema["max_payload"])
+    w("")
+    for enum in schema["enums"]:
+        for value in enum["values"]:
+            w("%s_%s = %d" % (enum["name"].upper(), value[0].upper(), value[1]))
+        w("")
+    for msg in schema["messages"]:
+        w("MSG_%s = 0x%02X" % (msg["name"].upper(), msg["id"]))
+    w("")
+    w("")
+    w("def crc16(data, crc=0xFFFF):")
+    w('    """CRC-16/CCITT-FALSE"""')
+    w("    for byte in data:")
+    w("        crc ^= byte << 8")
+    w("        for _ in range(8):")
+    w("            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)")
+    w("            crc &= 0xFFFF")
+    w("    return crc")
+    w("")
+    w("")
+    w("def encode_frame(msg_type, seq, payload):")
+    w("    if len(payload) > MAX_PAYLOAD:")
+    w('        raise ValueError("payload of %d bytes exceeds %d" % (len(payload), MAX_PAYLOAD))')
+    w("    body = bytes([VERSION, len(payload), msg_type, seq & 0xFF]) + bytes(payload)")
+    w("    return bytes([SYNC]) + body + struct.pack('<H', crc16(body))")
+    w("")
+    w("")
+    w("def host_time_us():")
+    w('    """Host clock for command stamps, wrapping like the device\'s 32-bit times"""')
+    w("    return (time.monotonic_ns() // 1000) & 0xFFFFFFFF")
+    w("")
+
+    for msg in schema["messages"]:
+        fixed_fmt = "<" + "".join(TYPES[f["type"]][1] for f in msg["fixed"])
+        counts = {msg["array"]["count"]} if msg["array"] else set()
+        stamp = msg["stamp"]["name"] if msg["stamp"] else None
+        args = [f["name"] for f in msg["fixed"] if f["name"] not in counts and f["name"] != stamp]
+        if msg["array"]:
+            args.append(msg["array"]["name"])
+        if stamp:
+            args.append("%s=None" % stamp)
+        w("")
+        w("def encode_%s(seq, %s):" % (msg["name"], ", ".join(args)))
+        w('    """%s"""' % msg["doc"])
+        if stamp:
+            w("    if %s is None:" % stamp)
+            w("        %s = host_time_us()" % stamp)
+        if msg["array"]:
+            arr = msg["array"]
+            w("    %s = len(%s)" % (arr["count"], arr["name"]))
+            w("    payload = struct.pack('%s', %s)" % (fixed_fmt, ", ".join(f["name"] for f in msg["fixed"])))
+            w("    payload += struct.pack('<%%d%s' %% %s, *%s)"
+              % (TYPES[arr["type"]][1], arr["count"], arr["name"]))
+        else:
+            w("    payload = struct.pack('%s', %s)" % (fixed_fmt, ", ".join(f["name"] for f in msg["fixed"])))
+        w("    return encode_frame(MSG_%s, seq, payload)" % msg["name"].upper())
+        w("")
+
+    w("")
+    w("# type -> (name, fixed format, fixed field names, array field, array item format)")
+    w("LAYOUTS = {")
+    for msg in schema["messages"]:
+        fixed_fmt = "<" + "".join(TYPES[f["type"]][1] for f in msg["fixed"])
+        names = ", ".join("'%s'" % f["name"] for f in msg["fixed"])
+        arr = msg["array"]
+        w("    MSG_%s: ('%s', '%s', (%s,), %s, %s)," % (
+            msg["name"].upper(), msg["name"], fixed_fmt, names,
+            "'%s'" % arr["name"] if arr else "None",
+            "'<%s'" % TYPES[arr["type"]][1] if arr else "None"))
+    w("}")
+    w("")
+    w("")
+    w("def decode_payload(msg_type, payload):")
+    w('    """Fields of a message as a dict (with "name"), None if malformed"""')
+    w("    layout = LAYOUTS.get(msg_type)")
+    w("    if layout is None:")
+    w("        return None")
+    w("    name, fmt, names, array, item = layout")
+    w("    size = struct.calcsize(fmt)")
+    w("    if len(payload) < size:")
+    w("        return None")
+    w("    fields = dict(zip(names, struct.unpack_from(fmt, payload)))")
+    w("    rest = payload[size:]")
+    w("    if array is None:")
+    w("        if rest:")
+    w("            return None")
+    w("    else:")
+    w("        step = struct.calcsize(item)")
+    w("        if len(rest) % step:")
+    w("            return None")
+    w("        fields[array] = [v[0] for v in struct.iter_unpack(item, rest)]")
+    w("    fields['name'] = name")
+    w("    return fields")
+    w("")
+    w("")
+    w("class FrameDecoder:")
+    w('    """Incremental stream decoder. feed() returns (type, seq, fields) tuples;')
+    w('    fields is None for an unknown type or a payload of the wrong size."""')
+    w("")
+    w("    def __init__(self):")
+    w("        self.buf = bytearray()")
+    w("        self.crc_errors = 0")
+    w("        self.dropped = 0")
+    w("")
+    w("    def feed(self, data):")
+    w("        self.buf += data")
+    w("        frames = []")
+    w("        while True:")
+    w("            start = self.buf.find(SYNC)")
+    w("            if start < 0:")
+    w("                self.dropped += len(self.buf)")
+    w("                self.buf.clear()")
+    w("                return frames")
+    w("            self.dropped += start")
+    w("            del self.buf[:start]")
+    w("            if len(self.buf) < HEADER_SIZE:")
+    w("                return frames")
+    w("            length = self.buf[2]")
+    w("            if self.buf[1] != VERSION or length > MAX_PAYLOAD:")
+    w("                self.dropped += 1")
+    w("                del self.buf[:1]")
+    w("                continue")
+    w("            end = HEADER_SIZE + length + CRC_SIZE")
+    w("            if len(self.buf) < end:")
+    w("                return frames")
+    w("            body = bytes(self.buf[1:HEADER_SIZE + length])")
+    w("            crc = struct.unpack_from('<H', self.buf, HEADER_SIZE + length)[0]")
+    w("            if crc16(body) != crc:")
+    w("                self.crc_errors += 1")
+    w("                del self.buf[:1]")
+    w("                continue")
+    w("            msg_type, seq = body[2], body[3]")
+    w("            frames.append((msg_type, seq, decode_payload(msg_type, body[4:])))")
+    w("            del self.buf[:end]")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    schema = load_schema()
+    outputs = {C_OUT: gen_c(schema), PY_OUT: gen_py(schema)}
+    check = "--check" in sys.argv[1:]
+    stale = []
+    for path, text in outputs.items():
+        try:
+            with open(path) as f:
+                current = f.read()
+        except FileNotFoundError:
+            current = None
+        if current == text:
+            continue
+        if check:
+            stale.append(path)
+        else:
+            with open(path, "w") as f:
+                f.write(text)
+            print("wrote %s" % os.path.relpath(path, ROOT))
+    if stale:
+        sys.exit("stale: %s (run gen_protocol.py)" % ", ".join(stale))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Command-to-PWM latency breakdown.
+
+    python3 tools/protocol/latency.py /dev/ttyUSB0 --count 500 --rate 50
+    python3 tools/protocol/latency.py /dev/ttyUSB0 --baud --rtscts
+
+Streams stop commands with an empty mask (they move nothing, but take the
+motion path and are acked once a control tick has committed after them) and
+splits each round trip with the ack's timestamps:
+
+    rtt        host send -> ack back on the host
+    queue      byte in the receive ring -> frame parsed and handled
+    tick       parsed -> first PWM commit after it (up to one 5 ms tick)
+    device     receive ring -> PWM commit
+    link       rtt minus the time the device held the command
+
+Host and device clocks are never compared directly, so no clock sync is
+needed. The link figure includes both wire times and the host's serial
+latency (USB adapters often add a millisecond or more each way).
+"""
+
+import argparse
+import sys
+import time
+
+import protocol_v2 as proto
+from link import Link
+
+WRAP = 1 << 32
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(round(p / 100.0 * (len(ordered) - 1))))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('port')
+    parser.add_argument('--count', type=int, default=200)
+    parser.add_argument('--rate', type=float, default=20.0, help='commands per second')
+    parser.add_argument('--baud', action='store_true', help='negotiate the fastest link rate first')
+    parser.add_argument('--rtscts', action='store_true')
+    args = parser.parse_args()
+
+    link = Link(args.port, rtscts=args.rtscts)
+    if args.baud:
+        print('link at %d baud' % link.negotiate(), file=sys.stderr)
+
+    sent = {}           # host_us -> seq, awaiting an ack
+    samples = {'rtt': [], 'queue': [], 'tick': [], 'device': [], 'link': []}
+    issued = 0
+    no_pwm = 0
+    period = 1.0 / args.rate
+    next_send = time.monotonic()
+
+    # Wait up to a second after the last command for the stragglers
+    while issued < args.count or (sent and time.monotonic() < next_send + 1.0):
+        if issued < args.count and time.monotonic() >= next_send:
+            host_us = proto.host_time_us()
+            sent[host_us] = link.send(proto.encode_stop, 0, host_us)
+            issued += 1
+            next_send += period
+
+        frames = link.read(link.serial.in_waiting or 1)
+        arrived_us = proto.host_time_us()
+        for msg_type, _, fields in frames:
+            if msg_type != proto.MSG_ACK or fields is None or fields['host_us'] not in sent:
+                continue
+            del sent[fields['host_us']]
+            if fields['status'] != proto.STATUS_OK:
+                continue
+            rtt = (arrived_us - fields['host_us']) % WRAP
+            samples['rtt'].append(rtt)
+            samples['queue'].append((fields['parse_us'] - fields['rx_us']) % WRAP)
+            if fields['pwm_us'] == 0:
+                no_pwm += 1
+                continue
+            held = (fields['pwm_us'] - fields['rx_us']) % WRAP
+            samples['tick'].append((fields['pwm_us'] - fields['parse_us']) % WRAP)
+            samples['device'].append(held)
+            samples['link'].append(rtt - held)
+
+    link.close()
+    if not samples['rtt']:
+        sys.exit('no acks received')
+    print('%d acks at %d baud, %d lost, %d without a PWM time'
+          % (len(samples['rtt']), link.baud, len(sent), no_pwm))
+    print('%-8s %9s %9s %9s %9s   (us)' % ('', 'p50', 'p90', 'p99', 'max'))
+    for name in ('rtt', 'queue', 'tick', 'device', 'link'):
+        values = samples[name]
+        if values:
+            print('%-8s %9d %9d %9d %9d' % (name, percentile(values, 50), percentile(values, 90),
+                                            percentile(values, 99), max(values)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,188 @@
+"""Host end of the v2 command link over a serial port.
+
+    from link import Link
+    link = Link('/dev/ttyUSB0', rtscts=True)
+    link.negotiate()                        # fastest rate both ends manage
+    link.request(protocol_v2.encode_query, protocol_v2.QUERY_INFO)
+    link.enable_credits()                   # send() now waits for room on the device
+
+The device always starts at BASE_BAUD. negotiate() asks for each candidate
+rate in turn: the device acks at the old rate and switches, the host
+follows and confirms with a second link request at the new rate. If that
+goes unanswered both ends end up back at BASE_BAUD (the device on its own
+after CONFIRM_S) and the next, slower candidate is tried.
+
+With credits enabled, send() keeps the bytes sent past the newest acked
+frame within the device's rx_window, and sends a command that takes a slot
+in a motion queue (queued or timed pose, segment, setpoint, timed batch)
+only while the newest ack's free count for that queue, less the commands of
+that kind sent since, is above zero. The device handles frames in order, so
+an ack also covers every frame sent before it. Queues drain without any
+traffic, so when a send waits with nothing in flight an empty stop (a no-op)
+is sent to fetch fresh counts.
+"""
+
+import collections
+import time
+
+import serial
+
+import protocol_v2 as proto
+
+BASE_BAUD = 115200
+CONFIRM_S = 0.5                 # UART_LINK_CONFIRM_MS
+RATES = (3000000, 2000000, 1500000, 921600)
+PROBE_S = 0.02                  # Between credit probes while a send waits
+UNSOLICITED = 256               # Frames kept that nobody was waiting for
+
+# Replies that stand in for the ack of the query with their seq
+REPLIES = (proto.MSG_INFO, proto.MSG_STATE, proto.MSG_CLOCK, proto.MSG_CALIBRATION_REPLY)
+
+
+def credit_kind(frame):
+    """Motion queue a command frame takes a slot in, or None"""
+    msg_type = frame[3]
+    flags = frame[proto.HEADER_SIZE + 4] if len(frame) > proto.HEADER_SIZE + 4 else 0
+    if msg_type == proto.MSG_POSE and flags & (proto.FLAG_QUEUE | proto.FLAG_TIMED):
+        return 'queue'
+    if msg_type == proto.MSG_SEGMENT:
+        return 'spline'
+    if msg_type == proto.MSG_SETPOINT:
+        return 'playout'
+    if msg_type == proto.MSG_BATCH and flags & proto.FLAG_TIMED:
+        return 'batch'
+    return None
+
+
+class Link:
+    def __init__(self, port, rtscts=False, timeout=0.2):
+        self.serial = serial.Serial(port, BASE_BAUD, timeout=0.01, rtscts=rtscts)
+        self.decoder = proto.FrameDecoder()
+        self.timeout = timeout
+        self.seq = 0
+        self.unsolicited = collections.deque(maxlen=UNSOLICITED)   # Frames that were not the awaited reply
+        self.sent_bytes = 0
+        self.acked_bytes = 0    # Stream offset of the end of the newest acked frame
+        self.inflight = collections.OrderedDict()   # seq -> (end offset, credit kind)
+        self.window = None      # Device rx_window, None while credits are off
+        self.free = {}          # Credit kind -> free slots as of the newest ack
+
+    @property
+    def baud(self):
+        return self.serial.baudrate
+
+    def send(self, encode, *args):
+        """Encode and write one command, returns its seq. Waits for credit if enabled."""
+        seq = self.seq
+        frame = encode(seq, *args)
+        kind = credit_kind(frame)
+        if self.window is not None:
+            self.wait_credit(len(frame), kind)
+        self.seq = (self.seq + 1) & 0xFF
+        self.serial.write(frame)
+        self.sent_bytes += len(frame)
+        self.inflight.pop(seq, None)
+        self.inflight[seq] = (self.sent_bytes, kind)
+        return seq
+
+    def request(self, encode, *args, timeout=None):
+        """Send a command and wait for its ack or reply: (type, fields) or None"""
+        seq = self.send(encode, *args)
+        deadline = time.monotonic() + (timeout or self.timeout)
+        while time.monotonic() < deadline:
+            for msg_type, frame_seq, fields in self.read(256):
+                if msg_type == proto.MSG_ACK and fields and fields['cmd_seq'] == seq:
+                    return msg_type, fields
+                if msg_type != proto.MSG_ACK and frame_seq == seq:
+                    return msg_type, fields
+                self.unsolicited.append((msg_type, frame_seq, fields))
+        return None
+
+    def read(self, size):
+        """Frames from one serial read, with their acks already counted"""
+        frames = self.decoder.feed(self.serial.read(size))
+        for msg_type, frame_seq, fields in frames:
+            if msg_type == proto.MSG_ACK and fields:
+                self.acked(fields['cmd_seq'], fields)
+            elif msg_type in REPLIES:
+                self.acked(frame_seq, None)
+        return frames
+
+    def acked(self, seq, fields):
+        """Retire seq and every frame sent before it"""
+        if seq not in self.inflight:
+            return      # Already covered by a later ack
+        while self.inflight:
+            done, (end, kind) = self.inflight.popitem(last=False)
+            # Without fresh counts, what the retired command took is now in the old ones
+            if fields is None and kind in self.free:
+                self.free[kind] -= 1
+            if done == seq:
+                self.acked_bytes = end
+                break
+        if fields is not None:
+            self.free = {kind: fields[kind + '_free'] for kind in ('queue', 'spline', 'playout', 'batch')}
+
+    def credit(self, kind):
+        """Slots the host may still fill in one motion queue"""
+        return self.free.get(kind, 0) - sum(1 for _, k in self.inflight.values() if k == kind)
+
+    def enable_credits(self):
+        """Read the device's window and queue room; send() honours them from now on"""
+        reply = self.request(proto.encode_query, proto.QUERY_INFO)
+        if reply is None or reply[0] != proto.MSG_INFO:
+            raise IOError("no info reply at %d baud" % self.baud)
+        self.request(proto.encode_stop, 0)
+        self.window = reply[1]['rx_window']
+
+    def wait_credit(self, size, kind, timeout=2.0):
+        deadline = time.monotonic() + timeout
+        probed = 0.0
+        while True:
+            room = self.window - (self.sent_bytes - self.acked_bytes) >= size
+            if room and (kind is None or self.credit(kind) > 0):
+                return
+            if time.monotonic() > deadline:
+                raise TimeoutError('no %s credit from the device' % (kind or 'rx_window'))
+            if not self.inflight and time.monotonic() - probed > PROBE_S:
+                probed = time.monotonic()
+                window, self.window = self.window, None     # The probe itself never waits
+                self.send(proto.encode_stop, 0)
+                self.window = window
+            self.unsolicited.extend(self.read(self.serial.in_waiting or 1))
+
+    def switch(self, baud):
+        """Move both ends to baud. Returns False, at BASE_BAUD, if the link fails."""
+        reply = self.request(proto.encode_link, baud)
+        if reply is None or reply[1]['status'] != proto.STATUS_OK:
+            return False
+        self.serial.flush()
+        self.serial.baudrate = baud
+        self.serial.reset_input_buffer()
+        self.decoder = proto.FrameDecoder()
+
+        # The first good frame at the new rate confirms it on the device
+        reply = self.request(proto.encode_link, baud)
+        if reply is not None and reply[1]['status'] == proto.STATUS_OK:
+            return True
+        self.serial.baudrate = BASE_BAUD
+        time.sleep(CONFIRM_S)
+        self.serial.reset_input_buffer()
+        self.decoder = proto.FrameDecoder()
+        # Whatever was in flight is lost with the rate
+        self.inflight.clear()
+        self.acked_bytes = self.sent_bytes
+        return baud == BASE_BAUD
+
+    def negotiate(self, rates=RATES):
+        """Try rates fastest first up to the device's max_baud, returns the rate in use"""
+        reply = self.request(proto.encode_query, proto.QUERY_INFO)
+        if reply is None or reply[0] != proto.MSG_INFO:
+            raise IOError("no info reply at %d baud" % self.baud)
+        for baud in sorted(rates, reverse=True):
+            if baud <= reply[1]['max_baud'] and self.switch(baud):
+                return baud
+        return self.baud
+
+    def close(self):
+        self.serial.close()
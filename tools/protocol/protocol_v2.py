@@ -0,0 +1,310 @@
+"""Command-link protocol v2 host encoder/decoder.
+
+Generated by tools/protocol/gen_protocol.py from protocol_v2.json.
+Do not edit; change the schema and regenerate.
+
+Frame: sync, version, length, type, seq, payload[length], crc16 (LE).
+The CRC is CRC-16/CCITT-FALSE over version..payload. Multi-byte
+fields are little endian. Every host command is answered with an ack
+carrying its seq, except a query or calibration, whose reply repeats
+the command's seq (a refused one is still acked with its status).
+Legacy gesture bytes (0x00-0x3F) may appear between frames until the
+first good frame; after it the device drops them.
+The link starts at 115200 baud. A link request is acked at the old
+rate, then the device switches; the first good frame at the new rate
+must arrive within 500 ms, otherwise the device returns to 115200.
+Every host command starts with host_us, which its ack echoes.
+Flow control is by credit: the host keeps at most info rx_window bytes
+sent beyond the last acked frame, and sends queued motion only while
+the newest ack's free counts, less what it sent since, allow.
+"""
+
+import struct
+import time
+
+SYNC = 0xA5
+VERSION = 2
+HEADER_SIZE = 5
+CRC_SIZE = 2
+MAX_PAYLOAD = 240
+
+STATUS_OK = 0
+STATUS_BAD_LENGTH = 1
+STATUS_UNKNOWN_TYPE = 2
+STATUS_INVALID_ARG = 3
+STATUS_BUSY = 4
+STATUS_REJECTED = 5
+
+QUERY_INFO = 0
+QUERY_STATE = 1
+QUERY_CLOCK = 2
+
+FLAG_QUEUE = 1
+FLAG_END = 2
+FLAG_VELOCITY = 4
+FLAG_TIMED = 8
+
+CALIB_SET = 1
+CALIB_SAVE = 2
+
+MSG_JOINT_TARGET = 0x01
+MSG_JOG = 0x02
+MSG_POSE = 0x03
+MSG_SEGMENT = 0x04
+MSG_STOP = 0x05
+MSG_QUERY = 0x06
+MSG_LINK = 0x08
+MSG_TELEMETRY_RATE = 0x09
+MSG_BATCH = 0x07
+MSG_SETPOINT = 0x0A
+MSG_CALIBRATION = 0x0B
+MSG_ACK = 0x80
+MSG_INFO = 0x81
+MSG_STATE = 0x82
+MSG_TELEMETRY = 0x83
+MSG_CLOCK = 0x84
+MSG_CALIBRATION_REPLY = 0x85
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE"""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def encode_frame(msg_type, seq, payload):
+    if len(payload) > MAX_PAYLOAD:
+        raise ValueError("payload of %d bytes exceeds %d" % (len(payload), MAX_PAYLOAD))
+    body = bytes([VERSION, len(payload), msg_type, seq & 0xFF]) + bytes(payload)
+    return bytes([SYNC]) + body + struct.pack('<H', crc16(body))
+
+
+def host_time_us():
+    """Host clock for command stamps, wrapping like the device's 32-bit times"""
+    return (time.monotonic_ns() // 1000) & 0xFFFFFFFF
+
+
+def encode_joint_target(seq, joint, target_mdeg, speed_mdeg_s, host_us=None):
+    """Absolute target for one joint"""
+    if host_us is None:
+        host_us = host_time_us()
+    payload = struct.pack('<IBiI', host_us, joint, target_mdeg, speed_mdeg_s)
+    return encode_frame(MSG_JOINT_TARGET, seq, payload)
+
+
+def encode_jog(seq, joint, velocity_mdeg_s, timeout_ms, host_us=None):
+    """Run one joint at a signed velocity until the deadman timeout, 0 brakes"""
+    if host_us is None:
+        host_us = host_time_us()
+    payload = struct.pack('<IBiH', host_us, joint, velocity_mdeg_s, timeout_ms)
+    return encode_frame(MSG_JOG, seq, payload)
+
+
+def encode_pose(seq, flags, duration_ms, max_speed_deg_s, blend_mdeg, exec_us, target_mdeg, host_us=None):
+    """Coordinated move of the first count joints"""
+    if host_us is None:
+        host_us = host_time_us()
+    count = len(target_mdeg)
+    payload = struct.pack('<IBHHHIB', host_us, flags, duration_ms, max_speed_deg_s, blend_mdeg, exec_us, count)
+    payload += struct.pack('<%di' % count, *target_mdeg)
+    return encode_frame(MSG_POSE, seq, payload)
+
+
+def encode_segment(seq, flags, t_ms, pos_mdeg, host_us=None):
+    """Timestamped spline waypoint"""
+    if host_us is None:
+        host_us = host_time_us()
+    count = len(pos_mdeg)
+    payload = struct.pack('<IBIB', host_us, flags, t_ms, count)
+    payload += struct.pack('<%di' % count, *pos_mdeg)
+    return encode_frame(MSG_SEGMENT, seq, payload)
+
+
+def encode_stop(seq, joint_mask, host_us=None):
+    """Stop the joints in the mask and flush queued motion"""
+    if host_us is None:
+        host_us = host_time_us()
+    payload = struct.pack('<IH', host_us, joint_mask)
+    return encode_frame(MSG_STOP, seq, payload)
+
+
+def encode_query(seq, what, host_us=None):
+    """Request an info or state reply"""
+    if host_us is None:
+        host_us = host_time_us()
+    payload = struct.pack('<IB', host_us, what)
+    return encode_frame(MSG_QUERY, seq, payload)
+
+
+def encode_link(seq, baud, host_us=None):
+    """Switch the link to another baud rate"""
+    if host_us is None:
+        host_us = host_time_us()
+    payload = struct.pack('<II', host_us, baud)
+    return encode_frame(MSG_LINK, seq, payload)
+
+
+def encode_telemetry_rate(seq, rate_hz, host_us=None):
+    """Start, retime or stop the telemetry stream"""
+    if host_us is None:
+        host_us = host_time_us()
+    payload = struct.pack('<IH', host_us, rate_hz)
+    return encode_frame(MSG_TELEMETRY_RATE, seq, payload)
+
+
+def encode_batch(seq, flags, joint_mask, max_speed_deg_s, exec_us, value, host_us=None):
+    """Targets or velocities for the joints in the mask, applied in one control tick"""
+    if host_us is None:
+        host_us = host_time_us()
+    count = len(value)
+    payload = struct.pack('<IBHHIB', host_us, flags, joint_mask, max_speed_deg_s, exec_us, count)
+    payload += struct.pack('<%di' % count, *value)
+    return encode_frame(MSG_BATCH, seq, payload)
+
+
+def encode_setpoint(seq, flags, t_us, pos_mdeg, host_us=None):
+    """Dense stream setpoint, played out through the jitter buffer"""
+    if host_us is None:
+        host_us = host_time_us()
+    count = len(pos_mdeg)
+    payload = struct.pack('<IBIB', host_us, flags, t_us, count)
+    payload += struct.pack('<%di' % count, *pos_mdeg)
+    return encode_frame(MSG_SETPOINT, seq, payload)
+
+
+def encode_calibration(seq, flags, joint, min_pulse_us, max_pulse_us, offset_mdeg, inverted, soft_min_mdeg, soft_max_mdeg, host_us=None):
+    """Set, save or read one joint's calibration, answered with a calibration_reply"""
+    if host_us is None:
+        host_us = host_time_us()
+    payload = struct.pack('<IBBHHiBii', host_us, flags, joint, min_pulse_us, max_pulse_us, offset_mdeg, inverted, soft_min_mdeg, soft_max_mdeg)
+    return encode_frame(MSG_CALIBRATION, seq, payload)
+
+
+def encode_ack(seq, cmd_seq, status, host_us, rx_us, parse_us, pwm_us, queue_free, spline_free, playout_free, batch_free):
+    """Device reply to every command"""
+    payload = struct.pack('<BBIIIIBBBB', cmd_seq, status, host_us, rx_us, parse_us, pwm_us, queue_free, spline_free, playout_free, batch_free)
+    return encode_frame(MSG_ACK, seq, payload)
+
+
+def encode_info(seq, version, joint_count, max_payload, queue_length, spline_length, playout_length, batch_length, rx_window, max_baud):
+    """Device capabilities"""
+    payload = struct.pack('<BBBBBBBHI', version, joint_count, max_payload, queue_length, spline_length, playout_length, batch_length, rx_window, max_baud)
+    return encode_frame(MSG_INFO, seq, payload)
+
+
+def encode_state(seq, busy_mask, time_us, position_mdeg):
+    """Commanded joint positions"""
+    count = len(position_mdeg)
+    payload = struct.pack('<HIB', busy_mask, time_us, count)
+    payload += struct.pack('<%di' % count, *position_mdeg)
+    return encode_frame(MSG_STATE, seq, payload)
+
+
+def encode_telemetry(seq, time_us, busy_mask, queue_depth, spline_depth, jitter_max_us, late_ticks, crc_errors, overflows, line_errors, playout_depth, playout_delay_ms, underruns, overruns, joint):
+    """Periodic joint state, sent unprompted at the telemetry rate"""
+    count = len(joint)
+    payload = struct.pack('<IHBBHHHHHBBHHB', time_us, busy_mask, queue_depth, spline_depth, jitter_max_us, late_ticks, crc_errors, overflows, line_errors, playout_depth, playout_delay_ms, underruns, overruns, count)
+    payload += struct.pack('<%di' % count, *joint)
+    return encode_frame(MSG_TELEMETRY, seq, payload)
+
+
+def encode_clock(seq, host_us, rx_us, tx_us):
+    """Clock sync sample: host_us to rx_us and tx_us back is one NTP exchange"""
+    payload = struct.pack('<III', host_us, rx_us, tx_us)
+    return encode_frame(MSG_CLOCK, seq, payload)
+
+
+def encode_calibration_reply(seq, joint, min_pulse_us, max_pulse_us, offset_mdeg, inverted, soft_min_mdeg, soft_max_mdeg):
+    """Calibration of one joint as in effect after a calibration command"""
+    payload = struct.pack('<BHHiBii', joint, min_pulse_us, max_pulse_us, offset_mdeg, inverted, soft_min_mdeg, soft_max_mdeg)
+    return encode_frame(MSG_CALIBRATION_REPLY, seq, payload)
+
+
+# type -> (name, fixed format, fixed field names, array field, array item format)
+LAYOUTS = {
+    MSG_JOINT_TARGET: ('joint_target', '<IBiI', ('host_us', 'joint', 'target_mdeg', 'speed_mdeg_s',), None, None),
+    MSG_JOG: ('jog', '<IBiH', ('host_us', 'joint', 'velocity_mdeg_s', 'timeout_ms',), None, None),
+    MSG_POSE: ('pose', '<IBHHHIB', ('host_us', 'flags', 'duration_ms', 'max_speed_deg_s', 'blend_mdeg', 'exec_us', 'count',), 'target_mdeg', '<i'),
+    MSG_SEGMENT: ('segment', '<IBIB', ('host_us', 'flags', 't_ms', 'count',), 'pos_mdeg', '<i'),
+    MSG_STOP: ('stop', '<IH', ('host_us', 'joint_mask',), None, None),
+    MSG_QUERY: ('query', '<IB', ('host_us', 'what',), None, None),
+    MSG_LINK: ('link', '<II', ('host_us', 'baud',), None, None),
+    MSG_TELEMETRY_RATE: ('telemetry_rate', '<IH', ('host_us', 'rate_hz',), None, None),
+    MSG_BATCH: ('batch', '<IBHHIB', ('host_us', 'flags', 'joint_mask', 'max_speed_deg_s', 'exec_us', 'count',), 'value', '<i'),
+    MSG_SETPOINT: ('setpoint', '<IBIB', ('host_us', 'flags', 't_us', 'count',), 'pos_mdeg', '<i'),
+    MSG_CALIBRATION: ('calibration', '<IBBHHiBii', ('host_us', 'flags', 'joint', 'min_pulse_us', 'max_pulse_us', 'offset_mdeg', 'inverted', 'soft_min_mdeg', 'soft_max_mdeg',), None, None),
+    MSG_ACK: ('ack', '<BBIIIIBBBB', ('cmd_seq', 'status', 'host_us', 'rx_us', 'parse_us', 'pwm_us', 'queue_free', 'spline_free', 'playout_free', 'batch_free',), None, None),
+    MSG_INFO: ('info', '<BBBBBBBHI', ('version', 'joint_count', 'max_payload', 'queue_length', 'spline_length', 'playout_length', 'batch_length', 'rx_window', 'max_baud',), None, None),
+    MSG_STATE: ('state', '<HIB', ('busy_mask', 'time_us', 'count',), 'position_mdeg', '<i'),
+    MSG_TELEMETRY: ('telemetry', '<IHBBHHHHHBBHHB', ('time_us', 'busy_mask', 'queue_depth', 'spline_depth', 'jitter_max_us', 'late_ticks', 'crc_errors', 'overflows', 'line_errors', 'playout_depth', 'playout_delay_ms', 'underruns', 'overruns', 'count',), 'joint', '<i'),
+    MSG_CLOCK: ('clock', '<III', ('host_us', 'rx_us', 'tx_us',), None, None),
+    MSG_CALIBRATION_REPLY: ('calibration_reply', '<BHHiBii', ('joint', 'min_pulse_us', 'max_pulse_us', 'offset_mdeg', 'inverted', 'soft_min_mdeg', 'soft_max_mdeg',), None, None),
+}
+
+
+def decode_payload(msg_type, payload):
+    """Fields of a message as a dict (with "name"), None if malformed"""
+    layout = LAYOUTS.get(msg_type)
+    if layout is None:
+        return None
+    name, fmt, names, array, item = layout
+    size = struct.calcsize(fmt)
+    if len(payload) < size:
+        return None
+    fields = dict(zip(names, struct.unpack_from(fmt, payload)))
+    rest = payload[size:]
+    if array is None:
+        if rest:
+            return None
+    else:
+        step = struct.calcsize(item)
+        if len(rest) % step:
+            return None
+        fields[array] = [v[0] for v in struct.iter_unpack(item, rest)]
+    fields['name'] = name
+    return fields
+
+
+class FrameDecoder:
+    """Incremental stream decoder. feed() returns (type, seq, fields) tuples;
+    fields is None for an unknown type or a payload of the wrong size."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.crc_errors = 0
+        self.dropped = 0
+
+    def feed(self, data):
+        self.buf += data
+        frames = []
+        while True:
+            start = self.buf.find(SYNC)
+            if start < 0:
+                self.dropped += len(self.buf)
+                self.buf.clear()
+                return frames
+            self.dropped += start
+            del self.buf[:start]
+            if len(self.buf) < HEADER_SIZE:
+                return frames
+            length = self.buf[2]
+            if self.buf[1] != VERSION or length > MAX_PAYLOAD:
+                self.dropped += 1
+                del self.buf[:1]
+                continue
+            end = HEADER_SIZE + length + CRC_SIZE
+            if len(self.buf) < end:
+                return frames
+            body = bytes(self.buf[1:HEADER_SIZE + length])
+            crc = struct.unpack_from('<H', self.buf, HEADER_SIZE + length)[0]
+            if crc16(body) != crc:
+                self.crc_errors += 1
+                del self.buf[:1]
+                continue
+            msg_type, seq = body[2], body[3]
+            frames.append((msg_type, seq, decode_payload(msg_type, body[4:])))
+            del self.buf[:end]
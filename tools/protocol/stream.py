@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Stream a dense trajectory through the device's jitter buffer.
+
+    python3 tools/protocol/stream.py /dev/ttyUSB0 --rate 250 --seconds 10
+    python3 tools/protocol/stream.py /dev/ttyUSB0 --rate 250 --burst-ms 30 --baud
+
+Sends setpoints of a slow sine on the first --joints joints around --centre
+degrees, the other joints held at --centre, stamped with the host's stream
+time, and asks for telemetry at 20 Hz to follow the buffer: depth, the delay
+it steers to, underruns and overruns. Setpoints go out within the device's
+credit window, so a host that runs ahead of the stream waits instead of
+overflowing the buffer. --burst-ms holds setpoints back and writes them in
+bunches, the way a loaded USB-serial adapter delivers them, to see the delay
+adapt; bunches bypass the credits.
+"""
+
+import argparse
+import math
+import sys
+import time
+
+import protocol_v2 as proto
+from link import Link
+
+TELEMETRY_HZ = 20
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('port')
+    parser.add_argument('--rate', type=float, default=250.0, help='setpoints per second')
+    parser.add_argument('--seconds', type=float, default=10.0)
+    parser.add_argument('--joints', type=int, default=3)
+    parser.add_argument('--centre', type=float, default=90.0, help='degrees')
+    parser.add_argument('--amplitude', type=float, default=20.0, help='degrees')
+    parser.add_argument('--period', type=float, default=2.0, help='sine period, seconds')
+    parser.add_argument('--burst-ms', type=float, default=0.0, help='write setpoints in bunches this far apart')
+    parser.add_argument('--baud', action='store_true', help='negotiate the fastest link rate first')
+    args = parser.parse_args()
+
+    link = Link(args.port)
+    if args.baud:
+        print('link at %d baud' % link.negotiate(), file=sys.stderr)
+    # Setpoints carry every joint
+    info = link.request(proto.encode_query, proto.QUERY_INFO)
+    if info is None or info[0] != proto.MSG_INFO:
+        sys.exit('no info reply')
+    joint_count = info[1]['joint_count']
+    link.request(proto.encode_telemetry_rate, TELEMETRY_HZ)
+    if not args.burst_ms:
+        link.enable_credits()
+
+    period = 1.0 / args.rate
+    total = int(args.seconds * args.rate)
+    start = time.monotonic()
+    pending = b''
+    last_write = start
+    refused = 0
+    frames = []
+
+    for n in range(total + 1):
+        t = n * period
+        while time.monotonic() < start + t:
+            # Frames read while a send waited for credit are in unsolicited
+            received = list(link.unsolicited) + link.read(link.serial.in_waiting)
+            link.unsolicited.clear()
+            for msg_type, _, fields in received:
+                if msg_type == proto.MSG_ACK and fields and fields['status'] != proto.STATUS_OK:
+                    refused += 1
+                elif msg_type == proto.MSG_TELEMETRY and fields:
+                    frames.append(fields)
+            time.sleep(0.0005)
+
+        phase = 2.0 * math.pi * t / args.period
+        pos = [int(1000 * (args.centre + (args.amplitude * math.sin(phase + j) if j < args.joints else 0.0)))
+               for j in range(joint_count)]
+        flags = proto.FLAG_END if n == total else 0
+        if not args.burst_ms:
+            link.send(proto.encode_setpoint, flags, int(t * 1e6) & 0xFFFFFFFF, pos)
+        else:
+            pending += proto.encode_setpoint(link.seq, flags, int(t * 1e6) & 0xFFFFFFFF, pos)
+            link.seq = (link.seq + 1) & 0xFF
+
+        now = time.monotonic()
+        if pending and (n == total or now - last_write >= args.burst_ms / 1000.0):
+            link.serial.write(pending)
+            pending = b''
+            last_write = now
+
+        if frames and n % int(max(1, args.rate / 2)) == 0:
+            f = frames[-1]
+            print('%6.2f s  depth %3d  delay %3d ms  underruns %d  overruns %d'
+                  % (t, f['playout_depth'], f['playout_delay_ms'], f['underruns'], f['overruns']))
+
+    time.sleep(0.5)
+    link.send(proto.encode_telemetry_rate, 0)
+    link.close()
+    print('%d setpoints sent, %d refused' % (total + 1, refused))
+
+
+if __name__ == '__main__':
+    main()
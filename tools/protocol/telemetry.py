@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Telemetry stream decoder.
+
+    python3 tools/protocol/telemetry.py /dev/ttyUSB0 --rate 100
+    python3 tools/protocol/telemetry.py /dev/ttyUSB0 --rate 100 --csv > run.csv
+
+Starts the stream with a telemetry_rate request and prints one line per
+frame until interrupted, then stops the stream again. decode() turns the
+generic decoder's fields into per-joint tuples for programmatic use.
+"""
+
+import argparse
+import collections
+import sys
+
+import protocol_v2 as proto
+from link import Link
+
+Joint = collections.namedtuple('Joint', 'target position velocity')     # Degrees, deg/s
+COUNTERS = ('busy_mask', 'queue_depth', 'spline_depth', 'jitter_max_us', 'late_ticks',
+            'crc_errors', 'overflows', 'line_errors', 'playout_depth', 'playout_delay_ms',
+            'underruns', 'overruns')
+
+
+def decode(fields):
+    """Telemetry fields with 'joints' as a list of Joint, in degrees"""
+    values = fields['joint']
+    frame = {k: v for k, v in fields.items() if k not in ('joint', 'count')}
+    frame['joints'] = [Joint(*(v / 1000.0 for v in values[i:i + 3]))
+                       for i in range(0, len(values) - 2, 3)]
+    return frame
+
+
+class Telemetry:
+    """Tracks device time across the 32-bit wrap and counts missing frames"""
+
+    def __init__(self, rate_hz):
+        self.period_us = 1000000 // rate_hz
+        self.last_us = None
+        self.wraps = 0
+        self.missed = 0
+
+    def time_us(self, frame):
+        t = frame['time_us']
+        if self.last_us is not None:
+            if t < self.last_us:
+                self.wraps += 1
+            # Frames sample the control tick, so allow one tick of slack
+            gap = (t - self.last_us) % (1 << 32)
+            self.missed += max(0, round(gap / self.period_us) - 1)
+        self.last_us = t
+        return t + (self.wraps << 32)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('port')
+    parser.add_argument('--rate', type=int, default=100, help='frames per second (max 200)')
+    parser.add_argument('--baud', action='store_true', help='negotiate the fastest link rate first')
+    parser.add_argument('--csv', action='store_true')
+    args = parser.parse_args()
+
+    link = Link(args.port)
+    if args.baud:
+        print('link at %d baud' % link.negotiate(), file=sys.stderr)
+    reply = link.request(proto.encode_telemetry_rate, args.rate)
+    if reply is None or reply[1]['status'] != proto.STATUS_OK:
+        sys.exit('device refused telemetry at %d Hz' % args.rate)
+
+    stream = Telemetry(args.rate)
+    header = False
+    try:
+        while True:
+            for msg_type, _, fields in link.decoder.feed(link.serial.read(512)):
+                if msg_type != proto.MSG_TELEMETRY or fields is None:
+                    continue
+                frame = decode(fields)
+                t = stream.time_us(frame)
+                if args.csv:
+                    if not header:
+                        cols = ['time_us'] + list(COUNTERS)
+                        for i in range(len(frame['joints'])):
+                            cols += ['j%d_target' % i, 'j%d_position' % i, 'j%d_velocity' % i]
+                        print(','.join(cols))
+                        header = True
+                    row = [t] + [frame[k] for k in COUNTERS]
+                    for joint in frame['joints']:
+                        row += ['%.3f' % v for v in joint]
+                    print(','.join(str(v) for v in row))
+                else:
+                    joints = '  '.join('%7.2f>%7.2f %7.1f/s' % (j.position, j.target, j.velocity)
+                                       for j in frame['joints'])
+                    print('%12.3f ms  q%-2d s%-2d p%-2d/%3d ms  jit %4d us  %s' % (
+                        t / 1000.0, frame['queue_depth'], frame['spline_depth'],
+                        frame['playout_depth'], frame['playout_delay_ms'],
+                        frame['jitter_max_us'], joints))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        link.send(proto.encode_telemetry_rate, 0)
+        print('missed %d frames, %d CRC errors on the host side'
+              % (stream.missed, link.decoder.crc_errors), file=sys.stderr)
+        link.close()
+
+
+if __name__ == '__main__':
+    main()